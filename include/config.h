@@ -3,6 +3,7 @@
 
 // MCP Server Configuration
 #define MCP_SERVER_PORT 8080
+#define MCP_METRICS_PORT 9100            // Prometheus text at /metrics; 0 disables
 #define MCP_SERVER_VERSION "1.0.0"
 #define MCP_SERVER_NAME "ESP32-HID-Controller"
 
@@ -24,13 +25,71 @@
 #define HOSTNAME_PREFIX "psai-ducky"
 
 // HID Configuration
+// Default layout for keyboard_type: KEYBOARD_LAYOUT_US, _UK, _DE, _FR, _NORDIC
+// (see keyboard_layouts.h); requests may override it with "layout"
 #define KEYBOARD_LAYOUT KEYBOARD_LAYOUT_US
 #define MOUSE_SENSITIVITY 1.0
+#define SCREEN_WIDTH 1920                // Target resolution for absolute mouse_move
+#define SCREEN_HEIGHT 1080
+#define MOUSE_PATH_MAX_POINTS 64         // Waypoints accepted by one mouse_path request
+#define MOUSE_REPORT_INTERVAL_MS 8       // Spacing of calibrated moves; keeps host acceleration repeatable
 #define MAX_KEY_SEQUENCE_LENGTH 256
 
+// HID Scheduler Configuration
+#define HID_EVENT_QUEUE_SIZE 256         // Pending press/release/move events
+#define HID_TEXT_BUFFER_SIZE 4096        // Bytes of queued keyboard_type text
+#define HID_PATH_BUFFER_SIZE 256         // Waypoints of queued mouse_path requests
+#define HID_EVENTS_PER_LOOP 8            // Max events emitted per loop() pass
+#define HID_TYPE_DELAY_MS 10             // Delay between compiled keyboard_type reports
+#define HID_KEY_HOLD_MS 50               // Key/button hold time for strokes and clicks
+
+// Dual-core HID output: the scheduler runs in its own task on the core the
+// Arduino loop (network, JSON) does not use, fed through lock-free rings.
+// platformio.ini enables it for the S3; the single-core S2 drains the
+// scheduler from loop().
+#ifndef HID_DUAL_CORE
+#define HID_DUAL_CORE 0
+#endif
+#define HID_TASK_CORE (1 - ARDUINO_RUNNING_CORE)
+#define HID_TASK_PRIORITY 19             // Above lwIP (18), below the WiFi driver (23)
+#define HID_TASK_STACK_SIZE 4096
+
+// Event-driven main loop (event_loop.h): loop() sleeps until a socket is
+// readable, the HID task makes progress, USB or WiFi state changes, or a
+// timer runs out
+#define NETWORK_POLL_MS 20               // Accept, heartbeat and HTTP servers are still polled
+#define NETWORK_WATCH_PRIORITY 2         // Just above the Arduino loop task
+#define NETWORK_WATCH_STACK_SIZE 2048
+#define MAIN_LOOP_FEED_MS 1              // Pass interval of a flat-out mouse benchmark
+
+// Persistent storage (WiFi credentials, pointer calibration)
+#define EEPROM_SIZE 512
+
+// Stored HID sequences (LittleFS, see hid_sequence_store.h)
+#define HID_SEQUENCE_MAX_ENTRIES 32
+#define HID_SEQUENCE_MAX_REPORTS 512     // Compiled reports per sequence (8 bytes each)
+#define HID_SEQUENCE_CACHE_SLOTS 4       // Sequences kept compiled in RAM
+#define HID_SEQUENCE_NAME_SIZE 32
+
+// HID arbitration between clients (hid_arbiter.h)
+#define HID_LEASE_DEFAULT_MS 30000       // Lease TTL, renewed by each HID call from the holder
+#define HID_LEASE_MAX_MS 600000
+#define HID_RATE_LIMIT_PER_S 100         // HID calls or binary events per second, per client
+#define HID_RATE_LIMIT_BURST 200
+
+// MCP Server Buffers
+#define MCP_SEND_BUFFER_SIZE 8192        // Largest response serialized without a heap copy; holds tools/list
+#define MCP_REQUEST_ARENA_SIZE 4096      // Parsed request, per client slot (MAX_CLIENTS)
+#define MCP_RESPONSE_ARENA_SIZE 2048     // Response under construction, per client slot
+#define MCP_JOB_QUEUE_SIZE 8             // tools/call jobs tracked per client slot; the job credit
+#define MCP_CREDIT_BYTES 4096            // Bytes of HID tools/call frames a client may have in flight
+#define MCP_JOB_ID_SIZE 32               // Serialized JSON-RPC id kept for the completion message
+#define MCP_PARKED_CALL_SIZE 1024        // tools/call waiting for its HID turn, per client slot
+#define MCP_DEFAULT_VERBOSITY MCP_VERBOSITY_NORMAL  // Until initialize asks otherwise (mcp_schema.h)
+
 // Security Configuration
-#define ENABLE_AUTHENTICATION false
-#define API_KEY ""      
+#define ENABLE_AUTHENTICATION false     // Challenge-response at initialize (session_auth.h)
+#define API_KEY ""                      // HMAC key; required when authentication is enabled
 #define MAX_CLIENTS 5
 #define CONNECTION_TIMEOUT 30000         // 30 seconds
 
@@ -57,6 +116,14 @@
 #define TOOL_MOUSE_MOVE "mouse_move"
 #define TOOL_MOUSE_CLICK "mouse_click"
 #define TOOL_MOUSE_SCROLL "mouse_scroll"
+#define TOOL_MOUSE_PATH "mouse_path"
+#define TOOL_MOUSE_CALIBRATE "mouse_calibrate"
 #define TOOL_SYSTEM_STATUS "system_status"
+#define TOOL_HID_BENCHMARK "hid_benchmark"
+#define TOOL_JOB_STATUS "job_status"
+#define TOOL_RUN_SCRIPT "run_script"
+#define TOOL_SEQUENCE "sequence"
+#define TOOL_METRICS "metrics"
+#define TOOL_HID_LEASE "hid_lease"
 
 #endif // CONFIG_H
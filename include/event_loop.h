@@ -0,0 +1,48 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// Reasons for the main loop to wake, one task notification bit each
+enum EventSource : uint8_t {
+    EVENT_NETWORK,                // A WebSocket client has data to read
+    EVENT_NETWORK_POLL,           // NETWORK_POLL_MS passed with no socket readable
+    EVENT_HID,                    // HID events finished, so jobs may complete
+    EVENT_USB,                    // USB bus state changed
+    EVENT_WIFI,                   // Station or access point state changed
+    EVENT_TIMER,                  // The wait ran out: HID reports or a feeder are due
+    EVENT_SOURCE_COUNT
+};
+
+#define EVENT_BIT(source) (1UL << (source))
+
+// Puts the Arduino loop task to sleep until something has work for it,
+// instead of cycling through every subsystem behind delay(1). Other tasks
+// and event callbacks notify() a source; wait() returns the set of
+// sources since the last wait, so loop() services only those subsystems.
+// Bits accumulate while the loop is busy, so no wakeup is lost.
+class EventLoop {
+private:
+    TaskHandle_t task;
+    uint32_t iterations;
+    uint32_t wakeups[EVENT_SOURCE_COUNT];
+    uint64_t sleepUs;             // Time spent blocked in wait()
+    unsigned long startMs;
+
+public:
+    EventLoop();
+
+    // Binds to the calling task, the one wait() will block
+    void begin();
+    // Any task or event callback; not from an ISR
+    void notify(EventSource source);
+    // Blocks for up to timeoutMs (UINT32_MAX: until notified) and returns
+    // the EVENT_BIT()s of the sources that fired; EVENT_TIMER on timeout
+    uint32_t wait(uint32_t timeoutMs);
+
+    void results(JsonObject out) const;
+};
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,96 @@
+#ifndef HID_ARBITER_H
+#define HID_ARBITER_H
+
+#include <stdint.h>
+#include "config.h"
+
+enum HIDLeaseMode : uint8_t {
+    HID_LEASE_NONE,
+    HID_LEASE_SHARED,             // Held by any number of clients at once
+    HID_LEASE_EXCLUSIVE           // Held by one client, shutting out the rest
+};
+
+enum HIDAccess : uint8_t {
+    HID_ACCESS_OK,
+    HID_ACCESS_LEASED,            // Another client holds a lease this one lacks
+    HID_ACCESS_RATE_LIMITED
+};
+
+// Answer to work that feeds HID from loop() after its call returned, a
+// script or a benchmark, asking for the next turn of the client that
+// started it
+enum HIDTurn : uint8_t {
+    HID_TURN_GO,
+    HID_TURN_WAIT,                // Another client goes first, or tokens are short
+    HID_TURN_DENIED               // A lease shuts the client out
+};
+
+// Asked before each such step, with the tokens it costs. On HID_TURN_WAIT
+// for tokens, retryMs is when they will be back; otherwise it stays 0 and
+// the wait ends with progress of the HID queue.
+typedef HIDTurn (*HIDTurnGate)(void* context, uint8_t clientId, uint16_t cost, uint32_t& retryMs);
+// Told once the step is queued, so later calls take turns after it
+typedef void (*HIDTurnNotice)(void* context, uint8_t clientId);
+
+// Decides which client may drive the HID path, and how fast.
+//
+// While nobody holds a lease every client may queue HID work. Once a
+// client takes a lease, only lease holders may: an exclusive lease keeps
+// everyone else out, so one client's keystrokes are never interleaved with
+// another's mid-word. A lease lapses after its TTL without HID work from
+// its holder, and with the holder's connection.
+//
+// Every client also has a token bucket refilled at HID_RATE_LIMIT_PER_S up
+// to HID_RATE_LIMIT_BURST; each HID call or binary event costs a token.
+//
+// Calls that have to wait for another client's work are marked waiting and
+// handed out round robin by nextWaiting().
+//
+// Times are passed in, so it has no Arduino dependencies and can be built
+// and checked on the host.
+class HIDArbiter {
+private:
+    struct Client {
+        bool waiting;
+        HIDLeaseMode lease;
+        uint32_t leaseTtlMs;
+        uint32_t leaseExpiresMs;
+        uint32_t tokens;          // Thousandths of a call
+        uint32_t refilledMs;
+    };
+    Client clients[MAX_CLIENTS];
+    uint8_t turn;                 // Client after which nextWaiting() looks
+
+    void expireLeases(uint32_t nowMs);
+    void refill(Client& client, uint32_t nowMs);
+
+public:
+    HIDArbiter();
+
+    void connect(uint8_t clientId, uint32_t nowMs);
+    void disconnect(uint8_t clientId);
+
+    // Takes or renews a lease; false with error set when it conflicts with
+    // one another client holds
+    bool acquire(uint8_t clientId, HIDLeaseMode mode, uint32_t ttlMs, uint32_t nowMs, const char*& error);
+    void release(uint8_t clientId);
+
+    HIDLeaseMode lease(uint8_t clientId) const { return clients[clientId].lease; }
+    uint32_t leaseRemaining(uint8_t clientId, uint32_t nowMs) const;
+    uint8_t holders(uint32_t nowMs);
+
+    // Whether leases let the client use HID at all, without spending tokens
+    bool mayUse(uint8_t clientId, uint32_t nowMs);
+
+    // Admits HID work costing cost tokens, renewing the client's lease;
+    // on HID_ACCESS_RATE_LIMITED, retryMs is when enough tokens will be back
+    HIDAccess admit(uint8_t clientId, uint16_t cost, uint32_t nowMs, uint32_t& retryMs);
+
+    void setWaiting(uint8_t clientId, bool waiting) { clients[clientId].waiting = waiting; }
+    bool isWaiting(uint8_t clientId) const { return clients[clientId].waiting; }
+    bool othersWaiting(uint8_t clientId) const;
+    // Next waiting client after the last one served, or -1
+    int nextWaiting();
+};
+
+#endif // HID_ARBITER_H
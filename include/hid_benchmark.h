@@ -0,0 +1,118 @@
+#ifndef HID_BENCHMARK_H
+#define HID_BENCHMARK_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include "hid_controller.h"
+#include "hid_arbiter.h"
+
+#define HID_BENCHMARK_MAX_DURATION_MS 10000
+#define HID_BENCHMARK_JITTER_BUCKETS 8
+
+enum HIDBenchmarkMode : uint8_t {
+    HID_BENCHMARK_KEYBOARD,       // keyboard_type text at a report rate
+    HID_BENCHMARK_MOUSE           // mouse_move calls at a call rate
+};
+
+// Pushes a synthetic keyboard or mouse stream through HIDController, the
+// same path tool calls take, and measures what comes out the other end:
+// reports and characters per second, the spread of the gaps between
+// reports, and the latency from a WebSocket frame that queues HID work
+// during the run (the start call included) to that work's first report.
+//
+// Runs asynchronously from loop(); start() returns at once and results()
+// reports progress until the queue has drained. With a turn gate set it
+// feeds HID as the client that started it, taking turns with the others.
+//
+// Reports are timed by the report observer, on the side that runs the
+// scheduler: the HID task with HID_DUAL_CORE. What it shares with loop()
+// is atomic, each value read whole but not all of them at one instant.
+// start() resets them only on an idle queue, when the observer cannot be
+// running.
+class HIDBenchmark {
+private:
+    HIDController* hid;
+
+    std::atomic<bool> running;
+    bool draining;
+    HIDBenchmarkMode mode;
+    uint16_t rate;                // Reports/s (keyboard) or calls/s (mouse); 0 = flat out
+    uint16_t durationMs;
+    unsigned long startMs;
+    unsigned long finishMs;
+    unsigned long lastCallUs;
+
+    uint32_t calls;
+    uint32_t chars;
+    uint32_t coalescedAtStart;
+    int8_t direction;
+    bool blocked;                 // The last pass waits for the HID queue to move
+
+    // Client that started the run, and the last HID work it queued
+    uint8_t clientId;
+    uint32_t lastSequence;
+    HIDTurnGate turnGate;
+    HIDTurnNotice turnNotice;
+    void* turnContext;
+
+    // Report timing, written by the observer alone
+    std::atomic<uint32_t> reports;
+    std::atomic<uint32_t> firstReportUs;
+    std::atomic<uint32_t> lastReportUs;
+    std::atomic<float> intervalMean;  // Welford running mean/variance
+    std::atomic<float> intervalM2;
+    std::atomic<uint32_t> maxDeviationUs;
+    std::atomic<uint32_t> jitter[HID_BENCHMARK_JITTER_BUCKETS];
+
+    // Frame to report latency, for one frame at a time: its work starts
+    // once everything up to frameSequence has been sent. loop() arms it,
+    // the observer takes it.
+    std::atomic<bool> frameArmed;
+    bool frameOpen;               // Armed by the frame being handled
+    std::atomic<uint32_t> frameUs;
+    std::atomic<uint32_t> frameSequence;
+    uint32_t frameEnd;            // Last event the frame queued
+    std::atomic<uint32_t> latencySamples;
+    std::atomic<uint32_t> latencyMinUs;
+    std::atomic<uint32_t> latencyMaxUs;
+    // Frames are timed one after another, so the total stays below the
+    // run's length and fits 32 bits, which stay lock-free on Xtensa
+    std::atomic<uint32_t> latencyTotalUs;
+
+    void feed();
+    void feedCalls();
+    void onReport();
+    static void reportObserver(void* context);
+
+public:
+    HIDBenchmark(HIDController* controller);
+
+    void begin();
+    void loop();
+    // Milliseconds until loop() has calls to make or the run ends;
+    // UINT32_MAX when idle, or when only HID progress can move it on
+    uint32_t msUntilDue();
+
+    void setTurnGate(HIDTurnGate gate, HIDTurnNotice notice, void* context) {
+        turnGate = gate;
+        turnNotice = notice;
+        turnContext = context;
+    }
+
+    bool start(uint8_t client, HIDBenchmarkMode mode, uint16_t rate, uint16_t durationMs);
+    // Drops what the run queued and has not sent; other clients' work stays
+    void stop();
+    bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+    // Bracket the handling of a WebSocket frame received at receivedUs;
+    // the first report of HID work it queues is matched to it. Armed
+    // before handling, since with HID_DUAL_CORE that report can go out
+    // before handling returns.
+    void frameStarted(unsigned long receivedUs);
+    void frameFinished();
+
+    void results(JsonObject out) const;
+};
+
+#endif // HID_BENCHMARK_H
@@ -4,6 +4,11 @@
 #include <Arduino.h>
 #include "USBHIDKeyboard.h"
 #include "USBHIDMouse.h"
+#include "USBHIDConsumerControl.h"
+#include "usb_hid_absolute_mouse.h"
+#include "hid_scheduler.h"
+#include "key_names.h"
+#include "pointer_calibration.h"
 
 // Mouse button definitions
 #define MOUSE_LEFT 0x01
@@ -20,24 +25,57 @@ class HIDController {
 private:
     USBHIDKeyboard* keyboard;
     USBHIDMouse* mouse;
+    USBHIDConsumerControl* consumer;
+    USBHIDAbsoluteMouse* pointer;
+    HIDScheduler scheduler;
+    PointerCalibration calibration;
     bool isInitialized;
     
+    // Told after a scheduler pass that finished events, from the side
+    // that runs the scheduler; set before begin()
+    HIDQueueObserver progressObserver;
+    void* progressContext;
+    void runScheduler();
+    
+#if HID_DUAL_CORE
+    // Runs the scheduler on HID_TASK_CORE, woken when events are queued
+    TaskHandle_t task;
+    static void taskMain(void* context);
+    static void wakeTask(void* context);
+#endif
+    
+    bool moveMouseCompensated(int16_t x, int16_t y);
+    size_t walkCompensatedMove(float length, float dirX, float dirY, bool queue);
+    
     // Key mapping functions
-    uint8_t mapSpecialKey(const String& keyName);
+    uint8_t parseModifiers(const String& modifiers);
     uint8_t mapMouseButton(const String& buttonName);
+    static uint16_t scaleToAbsolute(int16_t pixel, uint16_t screenSize);
     
 public:
-    HIDController(USBHIDKeyboard* kb, USBHIDMouse* ms);
+    HIDController(USBHIDKeyboard* kb, USBHIDMouse* ms, USBHIDConsumerControl* cc = nullptr,
+                  USBHIDAbsoluteMouse* am = nullptr);
     ~HIDController();
     
     bool begin();
+    // Drains the scheduler; does nothing when HID_DUAL_CORE gives it a task
+    void loop();
+    // Milliseconds until loop() has reports to send; UINT32_MAX when it has
+    // none, or when HID_DUAL_CORE leaves them to the task
+    uint32_t msUntilDue();
     
     // Keyboard functions
-    bool typeText(const String& text);
+    bool typeText(const String& text, uint8_t layout = KEYBOARD_LAYOUT, uint16_t reportDelay = HID_TYPE_DELAY_MS);
+    bool typeText(const char* text, size_t length, uint8_t layout, uint16_t reportDelay);
+    // Sends precompiled reports; they must stay valid until completed()
+    // passes the sequence() taken after this call
+    bool playReports(const HIDKeyboardReport* reports, uint16_t count, uint16_t reportDelay = HID_TYPE_DELAY_MS);
     bool pressKey(uint8_t key, uint8_t modifiers = 0);
     bool releaseKey(uint8_t key, uint8_t modifiers = 0);
+    bool releaseAllKeys();
     bool sendKeyStroke(uint8_t key, uint8_t modifiers = 0);
     bool sendKeyStroke(const String& keyName, const String& modifiers = "");
+    bool sendKeyStroke(const KeyCode& code, uint8_t modifiers);
     bool sendKeySequence(const String& sequence);
     
     // Special key combinations
@@ -48,6 +86,7 @@ public:
     bool sendWinKey();
     
     // Mouse functions
+    // Absolute coordinates are screen pixels on a SCREEN_WIDTH x SCREEN_HEIGHT display
     bool moveMouse(int16_t x, int16_t y, bool relative = true);
     bool clickMouse(uint8_t button = MOUSE_LEFT, uint16_t duration = 50);
     bool doubleClickMouse(uint8_t button = MOUSE_LEFT);
@@ -55,9 +94,44 @@ public:
     bool releaseMouse(uint8_t button);
     bool scrollMouse(int8_t scroll);
     
+    // Holds the queue for ms before the next event
+    bool pause(uint16_t ms);
+    
+    // Moves along a polyline or Bezier path over durationMs, optionally
+    // holding button for a drag. Absolute points are screen pixels and are
+    // scaled in place.
+    bool moveMousePath(HIDPathPoint* points, uint16_t count, bool relative, bool bezier,
+                       uint16_t durationMs, uint8_t button = 0);
+    
+    // Resolves a key name, or a single character as the configured layout
+    // types it, to a key code; false for characters composed with a dead
+    // key, which take two strokes
+    static bool resolveKey(const char* name, size_t length, KeyCode& code);
+    
+    // Pointer acceleration calibration
+    PointerCalibration& pointerCalibration() { return calibration; }
+    bool probePointer(uint8_t index);
+    
     // System functions
     bool isReady();
+    bool isBusy();
+    size_t freeTextBytes() { return scheduler.freeText(); }
+    uint32_t reportsCoalesced() { return scheduler.reportsCoalesced(); }
+    uint32_t reportsSent() { return scheduler.reportsSent(); }
+    size_t pendingEvents() { return scheduler.pendingEvents(); }
+    // Progress marks for tracking queued work: take sequence() after
+    // queueing, then poll completed() until that work has been sent
+    uint32_t sequence() { return scheduler.sequence(); }
+    bool completed(uint32_t sequence) { return scheduler.finished(sequence); }
+    void setReportObserver(HIDReportObserver observer, void* context) { scheduler.setReportObserver(observer, context); }
+    void setProgressObserver(HIDQueueObserver observer, void* context) {
+        progressObserver = observer;
+        progressContext = context;
+    }
     void reset();
+    // Drops queued work up to sequence(), taken after the last call to
+    // drop, and lets go of every key and button
+    void reset(uint32_t sequence);
     String getStatus();
 };
 
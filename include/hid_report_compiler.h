@@ -0,0 +1,66 @@
+#ifndef HID_REPORT_COMPILER_H
+#define HID_REPORT_COMPILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "keyboard_layouts.h"
+
+#define HID_REPORT_KEYS 6
+
+// 8-byte boot keyboard report (same layout as KeyReport in USBHIDKeyboard.h)
+struct HIDKeyboardReport {
+    uint8_t modifiers;
+    uint8_t reserved;
+    uint8_t keys[HID_REPORT_KEYS];
+};
+
+// Turns text into a minimal sequence of boot keyboard reports.
+//
+// Keys are accumulated into the 6-key rollover array one per report, so the
+// host always sees key-downs in typing order, and are only released when the
+// next character repeats a held key, needs different modifiers, or the array
+// is full. Shift stays held across runs of uppercase and symbol characters.
+// Typical prose compiles to a little over one report per character instead of
+// the two (or four, with shift) that press()/release() pairs cost.
+//
+// Characters are Unicode code points resolved through a KeyboardLayout;
+// accented characters go through the layout's dead keys, which are always
+// pressed and released on their own.
+//
+// No Arduino dependencies, so it can be built and checked on the host.
+class HIDReportCompiler {
+public:
+    // Upper bound on reports produced by a single feed() or finish() call:
+    // release, dead key press, dead key release, key press
+    static const size_t MAX_REPORTS_PER_CHAR = 4;
+
+    explicit HIDReportCompiler(uint8_t layoutId = KEYBOARD_LAYOUT_US);
+
+    void reset();
+    void setLayout(uint8_t layoutId);
+
+    // Appends the reports needed to type one code point; returns how many
+    // were written. Characters the layout cannot type produce nothing.
+    size_t feed(uint32_t codepoint, HIDKeyboardReport* out);
+
+    // Releases every held key and modifier
+    size_t finish(HIDKeyboardReport* out);
+
+    bool isIdle() const { return keyCount == 0 && current.modifiers == 0; }
+
+    // Compiles a whole UTF-8 string; returns the number of reports written,
+    // or 0 if maxReports is too small to hold the result.
+    static size_t compile(const char* text, size_t length, uint8_t layoutId,
+                          HIDKeyboardReport* out, size_t maxReports);
+
+private:
+    const KeyboardLayout* layout;
+    HIDKeyboardReport current;
+    uint8_t keyCount;
+
+    bool isHeld(uint8_t usage) const;
+    size_t emitRelease(HIDKeyboardReport* out);
+    size_t emitPress(uint8_t usage, uint8_t modifiers, HIDKeyboardReport* out);
+};
+
+#endif // HID_REPORT_COMPILER_H
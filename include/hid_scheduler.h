@@ -0,0 +1,232 @@
+#ifndef HID_SCHEDULER_H
+#define HID_SCHEDULER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "USBHIDKeyboard.h"
+#include "USBHIDMouse.h"
+#include "USBHIDConsumerControl.h"
+#include "usb_hid_absolute_mouse.h"
+#include "hid_report_compiler.h"
+#include "spsc_ring.h"
+#include "utf8_decoder.h"
+
+// Timed HID event types
+enum HIDEventType : uint8_t {
+    HID_EVENT_DELAY,
+    HID_EVENT_KEY_PRESS,          // Usage id and/or modifier bits
+    HID_EVENT_KEY_RELEASE,
+    HID_EVENT_KEY_RELEASE_ALL,
+    HID_EVENT_CONSUMER_PRESS,     // Consumer control usage
+    HID_EVENT_CONSUMER_RELEASE,
+    HID_EVENT_TEXT,               // Compiled lazily from the text buffer
+    HID_EVENT_MOUSE_MOVE,
+    HID_EVENT_MOUSE_MOVE_ABSOLUTE, // Logical 0..HID_ABSOLUTE_MAX coordinates
+    HID_EVENT_MOUSE_PATH,         // Sampled lazily from the path buffer
+    HID_EVENT_MOUSE_PRESS,
+    HID_EVENT_MOUSE_RELEASE,
+    HID_EVENT_REPORTS             // Precompiled keyboard reports, sent as they are
+};
+
+// Path flags
+#define HID_PATH_ABSOLUTE 0x01    // Points are logical absolute coordinates, not offsets
+#define HID_PATH_BEZIER   0x02    // Points are Bezier control points, not a polyline
+
+// Highest Bezier degree is HID_PATH_MAX_BEZIER_POINTS - 1
+#define HID_PATH_MAX_BEZIER_POINTS 8
+
+// Path vertex; relative paths are offsets from where the cursor started
+struct HIDPathPoint {
+    int16_t x;
+    int16_t y;
+};
+
+struct HIDEvent {
+    HIDEventType type;
+    uint16_t delayAfter;          // ms to wait after emitting (per report for text)
+    union {
+        struct {
+            uint8_t usage;
+            uint8_t modifiers;
+        } key;
+        uint16_t consumer;
+        uint8_t button;
+        struct {
+            uint16_t length;
+            uint8_t layout;
+        } text;
+        struct {
+            int8_t x;
+            int8_t y;
+            int8_t wheel;
+        } move;
+        struct {
+            uint16_t x;
+            uint16_t y;
+        } position;
+        struct {
+            uint16_t points;
+            uint16_t steps;
+            uint8_t flags;
+        } path;
+        struct {
+            const HIDKeyboardReport* data;
+            uint16_t count;
+        } reports;
+    };
+};
+
+// Called after every report handed to the USB stack
+typedef void (*HIDReportObserver)(void* context);
+// Called after an event is queued, on the side that queued it
+typedef void (*HIDQueueObserver)(void* context);
+
+// Queue of press/release/move events drained incrementally from loop(),
+// so long HID jobs never block the network stack.
+//
+// The enqueue calls, the free and progress queries and clear() form the
+// producer side; loop() is the consumer. Events, text and path points
+// travel through SPSC rings, so the two sides may run on different cores
+// (HID_DUAL_CORE) without a lock. Report observers run on the consumer.
+class HIDScheduler {
+private:
+    USBHIDKeyboard* keyboard;
+    USBHIDMouse* mouse;
+    USBHIDConsumerControl* consumer;
+    USBHIDAbsoluteMouse* pointer;
+
+    // Keys and modifiers currently held by key press/release events
+    HIDKeyboardReport keyState;
+
+    SPSCRing<HIDEvent, HID_EVENT_QUEUE_SIZE> events;
+    SPSCRing<uint8_t, HID_TEXT_BUFFER_SIZE> textBuffer;
+
+    // Text event currently being compiled into keyboard reports
+    HIDReportCompiler compiler;
+    Utf8Decoder decoder;
+    HIDKeyboardReport staged[HIDReportCompiler::MAX_REPORTS_PER_CHAR];
+    uint8_t stagedCount;
+    uint8_t stagedPos;
+    bool textActive;
+    bool textFinished;
+    uint16_t textRemaining;
+    uint16_t textDelay;
+
+    // A path event's points stay in the ring until its last report
+    SPSCRing<HIDPathPoint, HID_PATH_BUFFER_SIZE> pathBuffer;
+
+    // Path event currently being sampled into mouse reports
+    bool pathActive;
+    uint8_t pathFlags;
+    uint16_t pathPoints;
+    uint16_t pathSteps;
+    uint16_t pathStep;
+    uint16_t pathDelay;
+    float pathLength;             // Polyline only: total and walked arc length
+    uint16_t pathSegment;
+    float segmentStart;
+    float segmentLength;
+    int32_t pathX;                // Relative only: counts emitted so far
+    int32_t pathY;
+
+    // Precompiled report sequence being streamed; the caller keeps the
+    // reports alive until finished() passes its sequence number
+    bool replayActive;
+    const HIDKeyboardReport* replayData;
+    uint16_t replayRemaining;
+    uint16_t replayDelay;
+
+    unsigned long nextDueMs;
+    std::atomic<uint32_t> coalescedReports;
+    std::atomic<uint32_t> sentReports;
+
+    // Events ever queued and ever finished; text and paths finish with
+    // their last report, merged moves when they are folded away. The
+    // producer owns the first, the consumer the second.
+    uint32_t queuedTotal;
+    std::atomic<uint32_t> finishedTotal;
+
+    // clear() from the producer asks the consumer to drop events up to
+    // clearTarget, so events queued after it survive
+    std::atomic<bool> clearRequested;
+    std::atomic<uint32_t> clearTarget;
+
+    HIDReportObserver reportObserver;
+    void* observerContext;
+    HIDQueueObserver queueObserver;
+    void* queueContext;
+
+    void emit(const HIDEvent& event);
+    void reportSent() {
+        sentReports.fetch_add(1, std::memory_order_relaxed);
+        if (reportObserver) reportObserver(observerContext);
+    }
+    void finishEvent() { finishedTotal.fetch_add(1, std::memory_order_release); }
+    void discard(uint32_t target);
+    void applyKey(const HIDEvent& event);
+    bool emitNextTextReport();
+    void coalesceMouseMoves(HIDEvent& event);
+    void sendKeyboardReport(const HIDKeyboardReport& report);
+    void startPath(const HIDEvent& event);
+    bool emitNextPathReport();
+    bool emitNextReplayReport();
+    void pathVertex(uint16_t index, float& x, float& y) const;
+    void samplePath(float t, float& x, float& y);
+
+public:
+    HIDScheduler(USBHIDKeyboard* kb, USBHIDMouse* ms, USBHIDConsumerControl* cc, USBHIDAbsoluteMouse* am);
+
+    bool enqueue(const HIDEvent& event);
+    bool enqueueDelay(uint16_t ms);
+    bool enqueueKey(HIDEventType type, uint8_t usage, uint8_t modifiers, uint16_t delayAfter = 0);
+    bool enqueueConsumer(HIDEventType type, uint16_t usage, uint16_t delayAfter = 0);
+    bool enqueueText(const char* text, size_t length, uint8_t layout, uint16_t reportDelay);
+    bool enqueueMouseMove(int8_t x, int8_t y, int8_t wheel, uint16_t delayAfter = 0);
+    bool enqueueMouseMoveAbsolute(uint16_t x, uint16_t y, uint16_t delayAfter = 0);
+    // Queues a polyline or Bezier path sampled into evenly timed reports
+    // over durationMs; relative paths are split so no report exceeds +-127
+    bool enqueueMousePath(const HIDPathPoint* points, uint16_t count, uint8_t flags, uint16_t durationMs);
+    bool enqueueMouseButton(HIDEventType type, uint8_t button, uint16_t delayAfter = 0);
+    // Streams reports, reportDelay ms apart, without copying them
+    bool enqueueReports(const HIDKeyboardReport* reports, uint16_t count, uint16_t reportDelay);
+
+    void setReportObserver(HIDReportObserver observer, void* context) {
+        reportObserver = observer;
+        observerContext = context;
+    }
+    void setQueueObserver(HIDQueueObserver observer, void* context) {
+        queueObserver = observer;
+        queueContext = context;
+    }
+
+    // Emit every event that is due, bounded by HID_EVENTS_PER_LOOP
+    void loop();
+    // Drops everything queued so far and lets go of every key and button;
+    // takes effect at the start of the next loop()
+    void clear();
+    // The same for events up to sequence only; later ones are kept
+    void clear(uint32_t sequence);
+    // Consumer side: milliseconds until loop() has something to emit, 0
+    // when it is due now, UINT32_MAX when nothing is queued
+    uint32_t msUntilDue() const;
+
+    size_t freeEvents() const { return events.free(); }
+    size_t freeText() const { return textBuffer.free(); }
+    size_t freePathPoints() const { return pathBuffer.free(); }
+    // Queued events not yet finished, the one being sent included
+    size_t pendingEvents() const { return queuedTotal - finishedTotal.load(std::memory_order_acquire); }
+    // Reports saved by merging queued relative moves and scrolls
+    uint32_t reportsCoalesced() const { return coalescedReports.load(std::memory_order_relaxed); }
+    uint32_t reportsSent() const { return sentReports.load(std::memory_order_relaxed); }
+    bool isIdle() const { return finished(queuedTotal); }
+    // Sequence number of the last queued event; finished(sequence) turns
+    // true once that event and everything before it has been sent
+    uint32_t sequence() const { return queuedTotal; }
+    bool finished(uint32_t sequence) const {
+        return (int32_t)(finishedTotal.load(std::memory_order_acquire) - sequence) >= 0;
+    }
+    // Events finished so far; moves whenever loop() completes work
+    uint32_t progress() const { return finishedTotal.load(std::memory_order_acquire); }
+};
+
+#endif // HID_SCHEDULER_H
@@ -0,0 +1,126 @@
+#ifndef HID_SCRIPT_H
+#define HID_SCRIPT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "hid_controller.h"
+#include "hid_arbiter.h"
+
+#define HID_SCRIPT_MAX_BYTECODE 2048
+#define HID_SCRIPT_MAX_VARIABLES 16
+#define HID_SCRIPT_MAX_NESTING 4       // REPEAT of a REPEAT of ...
+#define HID_SCRIPT_STEPS_PER_LOOP 16
+
+// Where compilation stopped; line is 1-based
+struct HIDScriptError {
+    uint16_t line;
+    const char* message;
+};
+
+// DuckyScript-style macros compiled to bytecode and run on the device, so
+// a multi-step sequence keeps its local timing and costs one request. One
+// command per line:
+//
+//   REM text                   comment
+//   STRING text                type text; STRINGLN also presses Enter
+//   DELAY n                    wait n ms
+//   DEFAULT_DELAY n            wait n ms after every following command
+//   CTRL ALT DELETE, GUI r     key chord: modifiers plus at most one key,
+//                              names as for keyboard_key, '+' also separates
+//   MOUSE_MOVE dx dy           relative move, calibrated like mouse_move
+//   MOUSE_MOVE_TO x y          absolute move to a screen pixel
+//   MOUSE_CLICK [button]       left (default), right or middle
+//   MOUSE_PRESS [button], MOUSE_RELEASE [button]
+//   MOUSE_SCROLL n
+//   REPEAT n                   run the previous command n more times
+//   VAR $name = a [op b]       define an integer variable; op is + - * / %
+//   $name = a [op b]           assign
+//
+// Variables are 32-bit: results saturate at the int32 range, and / or % by zero
+// gives 0.
+//
+// Numeric arguments are integers or $variables. The interpreter runs from
+// loop() and only issues a step when the HID queue can take it, so long
+// scripts never overflow the scheduler. With a turn gate set, each HID
+// step also takes its turn as the client that started the script: a
+// lease that shuts the client out stops it, and other clients' work is
+// not interleaved with its steps.
+class HIDScript {
+private:
+    HIDController* hid;
+
+    uint8_t code[HID_SCRIPT_MAX_BYTECODE];
+    uint16_t codeLength;
+
+    int32_t variables[HID_SCRIPT_MAX_VARIABLES];
+
+    struct Repeat {
+        uint16_t pc;              // Of the REPEAT instruction
+        int32_t remaining;
+    };
+    Repeat repeats[HID_SCRIPT_MAX_NESTING];
+    uint8_t repeatDepth;
+
+    uint16_t pc;
+    uint32_t pendingDelay;        // Of a DELAY too long for one queue event
+    uint8_t heldButtons;          // Pressed by MOUSE_PRESS and not released
+    uint32_t defaultDelay;
+    bool running;
+    const char* failure;
+    uint32_t steps;
+    unsigned long startMs;
+    unsigned long finishMs;
+
+    // Client that started the script, and the HID work it queued
+    uint8_t clientId;
+    uint32_t startSequence;
+    uint32_t lastSequence;
+    bool turnTaken;
+
+    // Why the last loop() stopped short of its budget: waiting for the HID
+    // queue to move, or for tokens until retryAtMs
+    bool blocked;
+    bool retryTimed;
+    unsigned long retryAtMs;
+
+    HIDTurnGate turnGate;
+    HIDTurnNotice turnNotice;
+    void* turnContext;
+
+    int32_t readValue(uint16_t& at) const;
+    bool takeTurn(uint16_t cost);
+    void stepQueued();
+    bool step();
+    void abort(const char* error);
+    void finish(const char* error);
+
+public:
+    HIDScript(HIDController* controller);
+
+    void setTurnGate(HIDTurnGate gate, HIDTurnNotice notice, void* context) {
+        turnGate = gate;
+        turnNotice = notice;
+        turnContext = context;
+    }
+
+    void loop();
+    // Milliseconds until loop() has steps to run; UINT32_MAX when it has
+    // none, or waits for the HID queue to make progress
+    uint32_t msUntilDue() const;
+
+    // Compiles source and starts it for client; false with error set when
+    // it does not compile or a script is already running
+    bool run(uint8_t client, const char* source, size_t length, HIDScriptError& error);
+    // Drops the steps the script queued that have not been sent, and any
+    // calls of its client queued among them; other clients' work stays
+    void stop();
+    bool isRunning() const { return running; }
+
+    void results(JsonObject out) const;
+
+    // Returns the bytecode length, or 0 with error set
+    static size_t compile(const char* source, size_t length, uint8_t* out, size_t capacity,
+                          HIDScriptError& error);
+};
+
+#endif // HID_SCRIPT_H
@@ -0,0 +1,73 @@
+#ifndef HID_SEQUENCE_STORE_H
+#define HID_SEQUENCE_STORE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "hid_controller.h"
+
+struct HIDSequenceInfo {
+    char name[HID_SEQUENCE_NAME_SIZE];
+    uint32_t nameHash;            // Also the file name
+    uint32_t contentHash;         // fnv1a of the UTF-8 text
+    uint16_t reports;
+    uint8_t layout;
+};
+
+// Named keyboard sequences kept in LittleFS as compiled boot keyboard
+// reports. Boilerplate an agent types again and again (banners, commands,
+// form fills) is compiled once by define(); replay() hands the stored
+// reports straight to the HID scheduler with no JSON or layout work.
+//
+// The most recently used sequences stay in RAM; a cache slot is only
+// reused once the scheduler has sent every report queued from it.
+class HIDSequenceStore {
+private:
+    HIDController* hid;
+    bool mounted;
+
+    HIDSequenceInfo entries[HID_SEQUENCE_MAX_ENTRIES];
+    uint8_t entryCount;
+
+    struct CacheSlot {
+        bool valid;
+        uint32_t nameHash;
+        uint16_t count;
+        uint32_t lastUsed;
+        uint32_t busyUntil;       // HIDController::sequence() of the last replay
+        HIDKeyboardReport reports[HID_SEQUENCE_MAX_REPORTS];
+    };
+    CacheSlot cache[HID_SEQUENCE_CACHE_SLOTS];
+    uint32_t useClock;
+    uint32_t hits;
+    uint32_t misses;
+
+    int findByName(const char* name) const;
+    int findByHash(uint32_t contentHash) const;
+    CacheSlot* findSlot(uint32_t nameHash);
+    CacheSlot* acquireSlot();
+    void invalidate(uint32_t nameHash);
+    static void pathFor(uint32_t nameHash, char* path);
+
+public:
+    HIDSequenceStore(HIDController* controller);
+
+    // Mounts LittleFS and indexes the stored sequences
+    bool begin();
+
+    // Compiles text and stores it as name, replacing a sequence of the
+    // same name; false with error set on failure
+    bool define(const char* name, const char* text, size_t length, uint8_t layout,
+                uint32_t& contentHash, const char*& error);
+    bool remove(const char* name);
+
+    // Queues a stored sequence, found by name or, when name is empty, by
+    // content hash
+    bool replay(const char* name, uint32_t contentHash, uint16_t reportDelay, const char*& error);
+
+    uint8_t count() const { return entryCount; }
+    const HIDSequenceInfo& info(uint8_t index) const { return entries[index]; }
+    uint32_t cacheHits() const { return hits; }
+    uint32_t cacheMisses() const { return misses; }
+};
+
+#endif // HID_SEQUENCE_STORE_H
@@ -0,0 +1,109 @@
+#ifndef HID_WIRE_PROTOCOL_H
+#define HID_WIRE_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary WebSocket framing for HID event streams, carried in binary frames
+// next to JSON-RPC text frames. A frame is a version byte followed by
+// records; each record is an opcode and a fixed payload, multi-byte fields
+// little-endian:
+//
+//   0x01 key down       usage u8, modifiers u8
+//   0x02 key up         usage u8, modifiers u8
+//   0x03 release all
+//   0x04 text           length u8, layout u8 (keyboard_layouts.h id, 0xff
+//                       for the default), length bytes of UTF-8
+//   0x05 move           dx i16, dy i16 (pixels, calibrated like mouse_move)
+//   0x06 move absolute  x u16, y u16 (screen pixels)
+//   0x07 button down    buttons u8 (MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE)
+//   0x08 button up      buttons u8
+//   0x09 scroll         amount i8
+//   0x0a delay          ms u16
+//   0x0b replay         content hash u32 of a stored sequence (tool sequence)
+//
+// A relative move costs 5 bytes against roughly 110 for the equivalent
+// tools/call. Records are queued in order; the device answers only when a
+// frame is rejected, with [HID_WIRE_ERROR, status, offset u16]. A malformed
+// frame is rejected whole and offset is where decoding stopped; on
+// HID_WIRE_QUEUE_FULL the records before offset were queued.
+//
+// No Arduino dependencies, so it can be built and checked on the host.
+
+#define HID_WIRE_VERSION 1
+#define HID_WIRE_ERROR 0xff
+
+enum HIDWireOpcode : uint8_t {
+    HID_WIRE_KEY_DOWN = 0x01,
+    HID_WIRE_KEY_UP = 0x02,
+    HID_WIRE_RELEASE_ALL = 0x03,
+    HID_WIRE_TEXT = 0x04,
+    HID_WIRE_MOVE = 0x05,
+    HID_WIRE_MOVE_ABSOLUTE = 0x06,
+    HID_WIRE_BUTTON_DOWN = 0x07,
+    HID_WIRE_BUTTON_UP = 0x08,
+    HID_WIRE_SCROLL = 0x09,
+    HID_WIRE_DELAY = 0x0a,
+    HID_WIRE_REPLAY = 0x0b
+};
+
+enum HIDWireStatus : uint8_t {
+    HID_WIRE_OK,
+    HID_WIRE_BAD_VERSION,
+    HID_WIRE_BAD_OPCODE,
+    HID_WIRE_TRUNCATED,
+    HID_WIRE_QUEUE_FULL,      // Reported by the receiver, not the decoder
+    HID_WIRE_REPLAY_FAILED,   // No such sequence, or its cache is busy
+    HID_WIRE_LEASED,          // Another client holds the HID lease
+    HID_WIRE_RATE_LIMITED,
+    HID_WIRE_UNAUTHORIZED     // Connection has not completed initialize auth
+};
+
+struct HIDWireEvent {
+    HIDWireOpcode opcode;
+    union {
+        struct {
+            uint8_t usage;
+            uint8_t modifiers;
+        } key;
+        struct {
+            const char* data;     // Points into the frame
+            uint8_t length;
+            uint8_t layout;
+        } text;
+        struct {
+            int16_t x;
+            int16_t y;
+        } move;
+        struct {
+            uint16_t x;
+            uint16_t y;
+        } position;
+        uint8_t buttons;
+        int8_t scroll;
+        uint16_t delay;
+        uint32_t contentHash;
+    };
+};
+
+// Walks the records of one frame. Every read is bounds-checked against the
+// frame, so any byte sequence either decodes or stops with a status.
+class HIDWireDecoder {
+private:
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+    HIDWireStatus state;
+
+public:
+    HIDWireDecoder(const uint8_t* frame, size_t frameLength);
+
+    // Decodes the next record into event; false at the end of the frame or
+    // on the first malformed record (status() tells which)
+    bool next(HIDWireEvent& event);
+
+    HIDWireStatus status() const { return state; }
+    size_t offset() const { return pos; }
+};
+
+#endif // HID_WIRE_PROTOCOL_H
@@ -0,0 +1,24 @@
+#ifndef KEY_NAMES_H
+#define KEY_NAMES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Which HID page a named key lives on
+enum KeyPage : uint8_t {
+    KEY_PAGE_KEYBOARD,    // Keyboard/keypad usage id
+    KEY_PAGE_MODIFIER,    // Modifier bit (HID_MOD_*)
+    KEY_PAGE_CONSUMER     // Consumer control usage (media keys)
+};
+
+struct KeyCode {
+    uint8_t page;
+    uint16_t code;
+};
+
+// Resolves a key name such as "Enter", "PgDn", "kp_plus", "F17" or
+// "volume-up" through a perfect hash built at compile time: one hash, one
+// table probe and one string compare. Case, '_', '-' and ' ' are ignored.
+bool lookupKeyName(const char* name, size_t length, KeyCode& out);
+
+#endif // KEY_NAMES_H
@@ -0,0 +1,104 @@
+#ifndef KEYBOARD_LAYOUTS_H
+#define KEYBOARD_LAYOUTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// HID modifier bits as they appear in byte 0 of a boot keyboard report
+#define HID_MOD_LEFT_CTRL   0x01
+#define HID_MOD_LEFT_SHIFT  0x02
+#define HID_MOD_LEFT_ALT    0x04
+#define HID_MOD_LEFT_GUI    0x08
+#define HID_MOD_RIGHT_CTRL  0x10
+#define HID_MOD_RIGHT_SHIFT 0x20
+#define HID_MOD_RIGHT_ALT   0x40
+#define HID_MOD_RIGHT_GUI   0x80
+
+// Layout ids, usable from config.h (KEYBOARD_LAYOUT) and per request
+#define KEYBOARD_LAYOUT_US     0
+#define KEYBOARD_LAYOUT_UK     1
+#define KEYBOARD_LAYOUT_DE     2
+#define KEYBOARD_LAYOUT_FR     3
+#define KEYBOARD_LAYOUT_NORDIC 4
+#define KEYBOARD_LAYOUT_COUNT  5
+
+// Dead keys used to compose accented characters
+enum DeadKey : uint8_t {
+    DEAD_NONE = 0,
+    DEAD_GRAVE,
+    DEAD_ACUTE,
+    DEAD_CIRCUMFLEX,
+    DEAD_TILDE,
+    DEAD_DIAERESIS,
+    DEAD_KEY_COUNT
+};
+
+// How to produce one character: optional dead key, then usage + modifiers
+struct KeyMapping {
+    uint8_t usage;
+    uint8_t modifiers;
+    uint8_t deadKey;
+};
+
+struct DeadKeyMapping {
+    uint8_t usage;
+    uint8_t modifiers;
+};
+
+struct UnicodeMapping {
+    uint16_t codepoint;
+    KeyMapping key;
+};
+
+#define KEYBOARD_LAYOUT_MAX_EXTRAS 4
+
+// Flat lookup table for one layout. Latin-1 (U+0000..U+00FF) is indexed
+// directly; the few characters above it (such as the euro sign) live in a
+// short extras list. Tables are built by constexpr functions, so they are
+// computed by the compiler and stored in flash.
+struct KeyboardLayout {
+    KeyMapping latin1[256];
+    DeadKeyMapping deadKeys[DEAD_KEY_COUNT];
+    UnicodeMapping extras[KEYBOARD_LAYOUT_MAX_EXTRAS];
+    uint8_t extraCount;
+
+    constexpr void map(uint32_t codepoint, uint8_t usage, uint8_t modifiers = 0, uint8_t deadKey = DEAD_NONE) {
+        if (codepoint < 256) {
+            latin1[codepoint] = KeyMapping{usage, modifiers, deadKey};
+        } else if (extraCount < KEYBOARD_LAYOUT_MAX_EXTRAS) {
+            extras[extraCount++] = UnicodeMapping{(uint16_t)codepoint, KeyMapping{usage, modifiers, deadKey}};
+        }
+    }
+
+    // Character typed as a dead key followed by the key for base
+    constexpr void compose(uint32_t codepoint, DeadKey deadKey, uint8_t base) {
+        map(codepoint, latin1[base].usage, latin1[base].modifiers, deadKey);
+    }
+
+    constexpr void dead(DeadKey deadKey, uint8_t usage, uint8_t modifiers = 0) {
+        deadKeys[deadKey] = DeadKeyMapping{usage, modifiers};
+    }
+
+    // Returns false when the layout cannot type the character
+    bool lookup(uint32_t codepoint, KeyMapping& out) const {
+        if (codepoint < 256) {
+            out = latin1[codepoint];
+            return out.usage != 0;
+        }
+        for (uint8_t i = 0; i < extraCount; i++) {
+            if (extras[i].codepoint == codepoint) {
+                out = extras[i].key;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+const KeyboardLayout& keyboardLayout(uint8_t id);
+
+// Maps "us", "uk", "de", "fr", "nordic" to a layout id; -1 if unknown
+int keyboardLayoutFromName(const char* name);
+const char* keyboardLayoutName(uint8_t id);
+
+#endif // KEYBOARD_LAYOUTS_H
@@ -0,0 +1,103 @@
+#ifndef MCP_METRICS_H
+#define MCP_METRICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "mcp_tools.h"
+
+#define MCP_METRICS_BUCKETS 12
+
+// COUNTER(id, name, help); monotonic until reset
+#define MCP_COUNTERS(COUNTER) \
+    COUNTER(CONNECTIONS, "connections", "WebSocket connections accepted") \
+    COUNTER(DISCONNECTS, "disconnects", "WebSocket disconnects") \
+    COUNTER(REQUESTS, "requests", "JSON-RPC messages received; a batch counts once") \
+    COUNTER(TOOL_CALLS, "tool_calls", "tools/call requests, including batch entries") \
+    COUNTER(ERRORS, "errors", "JSON-RPC error responses sent") \
+    COUNTER(WIRE_ERRORS, "wire_errors", "Binary HID frames rejected") \
+    COUNTER(LEASE_DENIED, "lease_denied", "HID calls and frames refused because another client holds the lease") \
+    COUNTER(RATE_LIMITED, "rate_limited", "HID calls and frames refused by the per-client rate limit") \
+    COUNTER(AUTH_FAILURES, "auth_failures", "Handshakes and messages refused by session authentication") \
+    COUNTER(BUSY, "busy", "tools/call requests refused for lack of byte or job credits") \
+    COUNTER(PARKED, "parked", "tools/call requests held back for another client's HID turn") \
+    COUNTER(BYTES_IN, "bytes_in", "WebSocket payload bytes received") \
+    COUNTER(BYTES_OUT, "bytes_out", "WebSocket payload bytes sent") \
+    COUNTER(HID_REPORTS, "hid_reports", "USB HID reports emitted")
+
+// GAUGE(id, name, help); sampled when metrics are read
+#define MCP_GAUGES(GAUGE) \
+    GAUGE(CLIENTS, "clients", "Connected WebSocket clients") \
+    GAUGE(HID_QUEUE_DEPTH, "hid_queue_depth", "Events waiting in the HID queue") \
+    GAUGE(PENDING_JOBS, "pending_jobs", "tools/call jobs not yet completed") \
+    GAUGE(FREE_HEAP, "free_heap_bytes", "Free heap")
+
+#define MCP_COUNTER_ENUM(id, name, help) MCP_COUNTER_##id,
+enum MCPCounter : uint8_t { MCP_COUNTERS(MCP_COUNTER_ENUM) MCP_COUNTER_COUNT };
+#undef MCP_COUNTER_ENUM
+
+#define MCP_GAUGE_ENUM(id, name, help) MCP_GAUGE_##id,
+enum MCPGauge : uint8_t { MCP_GAUGES(MCP_GAUGE_ENUM) MCP_GAUGE_COUNT };
+#undef MCP_GAUGE_ENUM
+
+enum MCPMetricPhase : uint8_t {
+    MCP_PHASE_PARSE,
+    MCP_PHASE_EXECUTE,
+    MCP_PHASE_SEND,
+    MCP_PHASE_COUNT
+};
+
+// Latency is kept per method: one slot per tool (MCP_TOOL_<Id>), then the
+// methods that are not tools
+enum MCPMetricMethod : uint8_t {
+    MCP_METHOD_INITIALIZE = MCP_TOOL_COUNT,
+    MCP_METHOD_TOOLS_LIST,
+    MCP_METHOD_BATCH,
+    MCP_METHOD_NOTIFICATION,      // Job completions pushed by the device
+    MCP_METHOD_OTHER,             // Unknown methods, unparseable messages
+    MCP_METHOD_COUNT
+};
+
+// Request counters and fixed-bucket latency histograms. Recording is a
+// few increments and a short bucket search, so it stays on in release
+// builds; reading renders either a tool result or Prometheus text.
+class MCPMetrics {
+private:
+    struct Histogram {
+        uint32_t buckets[MCP_METRICS_BUCKETS];    // Not cumulative
+        uint32_t count;
+        uint32_t maxUs;
+        uint64_t sumUs;
+    };
+    Histogram histograms[MCP_METHOD_COUNT][MCP_PHASE_COUNT];
+    uint32_t counters[MCP_COUNTER_COUNT];
+    uint32_t gauges[MCP_GAUGE_COUNT];
+
+    static uint32_t quantile(const Histogram& histogram, float q);
+    static void describeHistogram(const Histogram& histogram, JsonObject out);
+
+public:
+    // Upper bounds of the buckets; the last bucket is open-ended
+    static const uint32_t BOUNDS_US[MCP_METRICS_BUCKETS - 1];
+
+    MCPMetrics();
+
+    void record(uint8_t method, MCPMetricPhase phase, uint32_t us);
+    void count(MCPCounter counter, uint32_t amount = 1) { counters[counter] += amount; }
+    // For counters kept elsewhere, such as the HID report total
+    void setCounter(MCPCounter counter, uint32_t value) { counters[counter] = value; }
+    void setGauge(MCPGauge gauge, uint32_t value) { gauges[gauge] = value; }
+    void reset();
+
+    static const char* methodName(uint8_t method);
+    // -1 for an unknown name
+    static int findMethod(const char* name);
+
+    // Counters, gauges and a p50/p99 summary of every method seen, or the
+    // full histograms of one method
+    void report(JsonObject out, int method = -1) const;
+
+    // Prometheus text exposition format, version 0.0.4
+    void writePrometheus(Print& out) const;
+};
+
+#endif // MCP_METRICS_H
@@ -0,0 +1,42 @@
+#ifndef MCP_SCHEMA_H
+#define MCP_SCHEMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// How much a tools/call result says. A session picks a level with
+// initialize params.verbosity; a tools/call can override it for itself.
+//   minimal   calls that queued HID work, or failed, answer with a status
+//             code only; calls that return data answer in full
+//   normal    result, message and echoed arguments
+//   debug     normal, plus the typed text and execution timing
+#define MCP_VERBOSITY_LEVELS(LEVEL) \
+    LEVEL(MINIMAL, "minimal") \
+    LEVEL(NORMAL, "normal") \
+    LEVEL(DEBUG, "debug")
+
+#define MCP_VERBOSITY_ENUM(id, name) MCP_VERBOSITY_##id,
+enum MCPVerbosity : uint8_t { MCP_VERBOSITY_LEVELS(MCP_VERBOSITY_ENUM) MCP_VERBOSITY_COUNT };
+#undef MCP_VERBOSITY_ENUM
+
+// -1 for an unknown name
+int verbosityFromName(const char* name);
+
+// Result objects of initialize and tools/list, serialized at compile time
+// and kept in flash. MCPServer splices them into a response after the
+// request id, so answering either method is a handful of memcpy calls.
+// initialize has one result per verbosity level, naming the level granted.
+extern const char* const MCP_INITIALIZE_RESULTS[MCP_VERBOSITY_COUNT];
+extern const size_t MCP_INITIALIZE_RESULT_LENGTHS[MCP_VERBOSITY_COUNT];
+extern const char* const MCP_TOOLS_LIST_RESULT;
+extern const size_t MCP_TOOLS_LIST_RESULT_LENGTH;
+
+// FNV-1a of the tools/list result, advertised by initialize as schemaHash
+// so clients can reuse a cached tool list while it is unchanged
+extern const uint32_t MCP_SCHEMA_HASH;
+
+// Room MCPServer needs around a flash result for the JSON-RPC envelope,
+// an id of up to MCP_JOB_ID_SIZE bytes and a session token
+#define MCP_RESULT_ENVELOPE_SIZE 128
+
+#endif // MCP_SCHEMA_H
@@ -2,40 +2,194 @@
 #define MCP_SERVER_H
 
 #include <WebSocketsServer.h>
+#include <WebServer.h>
 #include <ArduinoJson.h>
 
-// Use DynamicJsonDocument instead of JsonDocument
-#define JSON_DOC_SIZE 2048
+#include "config.h"
+#include "event_loop.h"
 #include "hid_controller.h"
+#include "hid_arbiter.h"
+#include "hid_benchmark.h"
+#include "hid_script.h"
+#include "hid_sequence_store.h"
+#include "hid_wire_protocol.h"
+#include "mcp_metrics.h"
+#include "mcp_schema.h"
+#include "mcp_tools.h"
+#include "session_auth.h"
 
 class MCPServer {
 private:
     WebSocketsServer* webSocket;
     HIDController* hidController;
+    HIDBenchmark* hidBenchmark;
+    HIDScript* hidScript;
+    HIDSequenceStore* hidSequences;
+    EventLoop* eventLoop;
     bool isInitialized;
     
+    // Responses are serialized here, after room for the WebSocket frame
+    // header, and sent without another copy
+    uint8_t sendBuffer[WEBSOCKETS_MAX_HEADER_SIZE + MCP_SEND_BUFFER_SIZE];
+    
+    // JSON storage for one client slot, reused for every message so a
+    // request never allocates: the request is parsed into one pool and the
+    // response, including the tool result, is built directly in the other
+    struct ClientArena {
+        StaticJsonDocument<MCP_REQUEST_ARENA_SIZE> request;
+        StaticJsonDocument<MCP_RESPONSE_ARENA_SIZE> response;
+        size_t requestPeak;     // High-water marks, in pool bytes
+        size_t responsePeak;
+        uint32_t overflows;     // Requests or responses that did not fit
+    };
+    ClientArena arenas[MAX_CLIENTS];
+    
+    // A tools/call that queued HID work. It is answered at once with the
+    // job id; a notifications/tools/completed message carrying the request
+    // id follows when its last HID event has been sent.
+    struct MCPJob {
+        uint32_t id;
+        uint32_t sequence;        // HIDController::sequence() after the call
+        unsigned long acceptedMs;
+        unsigned long finishedMs;
+        uint32_t credit;          // Frame bytes given back when it completes
+        uint8_t tool;
+        bool done;
+        char requestId[MCP_JOB_ID_SIZE];  // Serialized JSON-RPC id
+    };
+    
+    // Ring of a client's most recent jobs; the last pending entries are
+    // the ones still running, oldest first, since HID work drains in order
+    struct ClientJobs {
+        MCPJob jobs[MCP_JOB_QUEUE_SIZE];
+        uint8_t head;             // Next slot to write
+        uint8_t count;            // Valid entries, pending or done
+        uint8_t pending;
+    };
+    ClientJobs jobQueues[MAX_CLIENTS];
+    uint32_t nextJobId;
+    
+    // Flow control. initialize advertises MCP_CREDIT_BYTES and
+    // MCP_JOB_QUEUE_SIZE; a tools/call driving HID spends its frame length
+    // and a job until the job completes. Calls beyond either are refused
+    // with a Busy error (-32002) instead of queueing more.
+    uint32_t creditBytes[MAX_CLIENTS];    // In flight
+    uint8_t callingClient;        // Client whose tools/call is executing
+    
+    // MCPVerbosity granted by each client's initialize, and the level of
+    // the tools/call executing, which tools consult before echoing input
+    uint8_t sessionVerbosity[MAX_CLIENTS];
+    uint8_t callVerbosity;
+    
+    // Traffic per framing, so JSON-RPC and binary cost per event can be
+    // compared on the device (system_status "wire")
+    struct WireStats {
+        uint32_t frames;
+        uint32_t events;
+        uint32_t bytes;
+        uint32_t parseUs;
+    };
+    WireStats jsonWire;
+    WireStats binaryWire;
+    
+    // Counters and per-method latency, also served as Prometheus text on
+    // MCP_METRICS_PORT. metricMethod is the MCPMetricMethod of the message
+    // being handled; its send time is recorded against it.
+    MCPMetrics metrics;
+    uint8_t metricMethod;
+    WebServer* metricsHttp;
+    
+    // Leases, rate limits and turn-taking between clients. A tools/call
+    // whose HID work would queue behind another client's is parked here,
+    // serialized, and run when its turn comes; one per client.
+    HIDArbiter arbiter;
+    struct ParkedCall {
+        uint32_t credit;
+        uint16_t length;
+        char text[MCP_PARKED_CALL_SIZE];
+    };
+    ParkedCall parked[MAX_CLIENTS];
+    uint8_t hidOwner;             // Client whose HID work was queued last
+    uint32_t hidOwnerSequence;
+    
+    // Session tokens issued by the initialize handshake when
+    // ENABLE_AUTHENTICATION is set
+    SessionAuth auth;
+    
     // MCP Protocol handling
     void handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
-    void handleMCPMessage(uint8_t clientId, const String& message);
-    void sendMCPResponse(uint8_t clientId, const DynamicJsonDocument& response);
-    void sendMCPError(uint8_t clientId, int requestId, const String& error);
+    void handleMCPMessage(uint8_t clientId, uint8_t* payload, size_t length);
+    void handleBatch(uint8_t clientId, JsonArrayConst calls);
+    // Request ids are echoed as received: number, string or null
+    JsonObject beginResponse(uint8_t clientId, JsonVariantConst id);
+    void sendMCPResponse(uint8_t clientId);
+    void sendMCPError(uint8_t clientId, JsonVariantConst id, const String& error, int code = -32000);
+    void setError(JsonObject response, int code, const String& error);
+    
+    // Binary HID frames (hid_wire_protocol.h)
+    void handleWireFrame(uint8_t clientId, const uint8_t* payload, size_t length);
+    HIDWireStatus applyWireEvent(const HIDWireEvent& event);
+    void sendWireError(uint8_t clientId, HIDWireStatus status, size_t offset);
+    static void reportWireStats(const WireStats& stats, JsonObject out);
+    void sampleMetrics();
+    void handleMetricsHttp();
+    void sendResultResponse(uint8_t clientId, JsonVariantConst id, const char* result, size_t resultLength,
+                            const char* session = nullptr);
     
     // MCP Protocol methods
-    void handleInitialize(uint8_t clientId, const DynamicJsonDocument& request);
-    void handleListTools(uint8_t clientId, const DynamicJsonDocument& request);
-    void handleCallTool(uint8_t clientId, const DynamicJsonDocument& request);
-    
-    // Tool implementations
-    DynamicJsonDocument executeKeyboardType(const JsonVariantConst& args);
-    DynamicJsonDocument executeKeyboardKey(const JsonVariantConst& args);
-    DynamicJsonDocument executeKeyboardShortcut(const JsonVariantConst& args);
-    DynamicJsonDocument executeMouseMove(const JsonVariantConst& args);
-    DynamicJsonDocument executeMouseClick(const JsonVariantConst& args);
-    DynamicJsonDocument executeMouseScroll(const JsonVariantConst& args);
-    DynamicJsonDocument executeSystemStatus(const JsonVariantConst& args);
+    void handleInitialize(uint8_t clientId, const JsonDocument& request);
+    void handleListTools(uint8_t clientId, const JsonDocument& request);
+    void handleCallTool(uint8_t clientId, JsonObject response, JsonObjectConst request);
+    uint8_t negotiateVerbosity(uint8_t clientId, JsonVariantConst params);
+    bool authorize(uint8_t clientId, const JsonDocument& request, bool batch);
+    
+    // HID arbitration
+    static bool toolUsesHID(uint8_t tool, JsonVariantConst args);
+    bool parkCall(uint8_t clientId, const JsonDocument& request, uint32_t credit);
+    void dispatchParked();
+    void noteHIDOwner(uint8_t clientId);
+    // Turns of scripts and benchmarks, which feed HID from loop()
+    HIDTurn takeHIDTurn(uint8_t clientId, uint16_t cost, uint32_t& retryMs);
+    static HIDTurn hidTurnGate(void* context, uint8_t clientId, uint16_t cost, uint32_t& retryMs);
+    static void hidTurnNotice(void* context, uint8_t clientId);
+    static void compactResult(JsonObject result, bool queued);
+    
+    // Flow control
+    bool takeCredit(uint8_t clientId, const JsonDocument& request, bool batch, size_t length, uint32_t& credit);
+    void settleCredit(uint8_t clientId, uint32_t jobsBefore, uint32_t credit);
+    void setBusy(JsonObject response, uint8_t clientId, const char* reason);
+    void describeCredits(uint8_t clientId, JsonObject out);
+    
+    // Job tracking
+    void acceptJob(uint8_t clientId, uint8_t tool, uint32_t sequence, JsonObject response);
+    void pollJobs();
+    void sendJobCompleted(uint8_t clientId, const MCPJob& job);
+    void resetJobs(uint8_t clientId);
+    static void describeJob(const MCPJob& job, JsonObject out);
+    
+    // Tool implementations, one per entry in MCP_TOOLS (mcp_tools.h); each
+    // fills result, which already lives in the client's response arena
+#define MCP_TOOL_EXECUTE_DECL(id, name, description, ARGS) \
+    void execute##id(const id##Args& args, JsonObject result);
+    MCP_TOOLS(MCP_TOOL_EXECUTE_DECL)
+#undef MCP_TOOL_EXECUTE_DECL
+    
+    // Decodes the arguments and runs the tool; false with error set when
+    // the arguments do not match the tool's declaration
+    typedef bool (*ToolInvoker)(MCPServer& server, JsonObjectConst args,
+                                JsonObject result, const char*& error);
+    static const ToolInvoker toolInvokers[MCP_TOOL_COUNT];
+    
+    template <typename Args, void (MCPServer::*Execute)(const Args&, JsonObject)>
+    static bool invokeTool(MCPServer& server, JsonObjectConst args,
+                           JsonObject result, const char*& error) {
+        Args decoded;
+        if (!decodeToolArgs(args, decoded, error)) return false;
+        (server.*Execute)(decoded, result);
+        return true;
+    }
     
     // Utility methods
-    bool authenticateClient(const String& apiKey);
     String generateToolSchema();
     
 public:
@@ -43,8 +197,18 @@ public:
     ~MCPServer();
     
     bool begin();
+    // Everything at once; the event loop calls the parts as they have work
     void loop();
+    // WebSocket traffic and the metrics endpoint
+    void pollNetwork();
+    // Job completions and parked calls, which move as HID work drains
+    void pollWork();
+    bool hasPendingWork();
     void setHIDController(HIDController* controller);
+    void setHIDBenchmark(HIDBenchmark* benchmark);
+    void setHIDScript(HIDScript* script);
+    void setHIDSequences(HIDSequenceStore* sequences);
+    void setEventLoop(EventLoop* loop);
     
     // Static callback wrapper
     static void webSocketEventWrapper(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
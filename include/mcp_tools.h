@@ -0,0 +1,191 @@
+#ifndef MCP_TOOLS_H
+#define MCP_TOOLS_H
+
+#include <ArduinoJson.h>
+#include "config.h"
+
+// Tool registry. Every tool is declared once below, with its arguments;
+// the declaration generates
+//   - a typed argument struct (KeyboardTypeArgs, ...),
+//   - decodeToolArgs(), which checks types and required arguments in one
+//     pass over the JSON object and fills the struct,
+//   - the tools/list schema (mcp_schema.cpp), and
+//   - the name -> tool hash table used for dispatch (mcp_tools.cpp).
+// MCPServer provides a matching execute<Id>(const <Id>Args&) per tool, and
+// index.js getFallbackTools() mirrors this list for offline use.
+//
+// Argument entries: ARG(name, type, required|optional, default, range, description)
+// Types: integer, number, boolean, string, points
+// Ranges: MCP_RANGE(min, max) bounds an integer, MCP_ANY leaves it open.
+// Out-of-range values are refused with -32602 before the tool runs, so
+// executors may narrow integers to the HID field widths. MCP_RANGE and
+// MCP_ANY are not macros; they are pasted onto the MCP_RANGE_* helpers
+// below.
+
+#define KEYBOARD_TYPE_ARGS(ARG) \
+    ARG(text, string, required, "", MCP_ANY, "Text to type (UTF-8)") \
+    ARG(layout, string, optional, "", MCP_ANY, "Target keyboard layout (us, uk, de, fr, nordic); defaults to the firmware setting")
+
+#define KEYBOARD_KEY_ARGS(ARG) \
+    ARG(key, string, required, "", MCP_ANY, "Key to press (e.g., 'a', 'Enter', 'PgDn', 'F13', 'kp_plus', 'VolumeUp')") \
+    ARG(modifiers, string, optional, "", MCP_ANY, "Modifier keys separated by spaces or + (ctrl, shift, alt, gui, altgr, rctrl, ...)")
+
+#define KEYBOARD_SHORTCUT_ARGS(ARG) \
+    ARG(shortcut, string, required, "", MCP_ANY, "Shortcut in ctrl+alt+delete format")
+
+#define MOUSE_MOVE_ARGS(ARG) \
+    ARG(x, integer, required, 0, MCP_RANGE(-32767, 32767), "X movement, or screen pixel when relative is false") \
+    ARG(y, integer, required, 0, MCP_RANGE(-32767, 32767), "Y movement, or screen pixel when relative is false") \
+    ARG(relative, boolean, optional, true, MCP_ANY, "Relative movement (default: true); false places the cursor in one absolute report")
+
+#define MOUSE_CLICK_ARGS(ARG) \
+    ARG(button, string, optional, "left", MCP_ANY, "Mouse button (left, right, middle)") \
+    ARG(duration, integer, optional, 50, MCP_RANGE(0, 65535), "Click duration in milliseconds")
+
+#define MOUSE_SCROLL_ARGS(ARG) \
+    ARG(scroll, integer, required, 0, MCP_RANGE(-127, 127), "Scroll amount (positive = up, negative = down)")
+
+#define MOUSE_PATH_ARGS(ARG) \
+    ARG(points, points, required, JsonArrayConst(), MCP_ANY, "Waypoints {x, y}; offsets from the start position when relative, screen pixels otherwise") \
+    ARG(curve, string, optional, "line", MCP_ANY, "line (through every point, default) or bezier (points are control points, last is the end)") \
+    ARG(relative, boolean, optional, true, MCP_ANY, "Points are offsets from the current position (default: true)") \
+    ARG(duration, integer, optional, 0, MCP_RANGE(0, 65535), "Time to travel the whole path in milliseconds (default: 0, as fast as possible)") \
+    ARG(button, string, optional, "", MCP_ANY, "Button to hold for a drag (left, right, middle)")
+
+#define MOUSE_CALIBRATE_ARGS(ARG) \
+    ARG(action, string, required, "", MCP_ANY, "start, probe, record, commit, status or reset") \
+    ARG(probe, integer, optional, -1, MCP_RANGE(-1, 255), "Probe index for probe/record (default: next unrecorded probe)") \
+    ARG(pixels, number, optional, 0, MCP_ANY, "Horizontal pixels the cursor travelled during the probe (record)")
+
+#define SYSTEM_STATUS_ARGS(ARG)
+
+#define HID_BENCHMARK_ARGS(ARG) \
+    ARG(action, string, optional, "result", MCP_ANY, "start, result or stop (default: result)") \
+    ARG(mode, string, optional, "keyboard", MCP_ANY, "keyboard (typed text) or mouse (mouse_move calls)") \
+    ARG(rate, integer, optional, 0, MCP_RANGE(0, 65535), "Reports/s for keyboard, calls/s for mouse; 0 = as fast as possible") \
+    ARG(duration, integer, optional, 2000, MCP_RANGE(0, 10000), "Run time in milliseconds (default: 2000, max: 10000)")
+
+#define JOB_STATUS_ARGS(ARG) \
+    ARG(job, integer, optional, 0, MCP_RANGE(0, 2147483647), "Job id from a tools/call result (default: 0, every job of this connection)")
+
+#define RUN_SCRIPT_ARGS(ARG) \
+    ARG(action, string, optional, "run", MCP_ANY, "run, status or stop (default: run)") \
+    ARG(script, string, optional, "", MCP_ANY, "DuckyScript-style source: STRING, STRINGLN, DELAY, DEFAULT_DELAY, key chords " \
+        "(CTRL ALT DELETE), MOUSE_MOVE, MOUSE_MOVE_TO, MOUSE_CLICK, MOUSE_PRESS, MOUSE_RELEASE, MOUSE_SCROLL, " \
+        "REPEAT n, VAR $name = a [op b]")
+
+#define SEQUENCE_ARGS(ARG) \
+    ARG(action, string, required, "", MCP_ANY, "define, replay, list or delete") \
+    ARG(name, string, optional, "", MCP_ANY, "Sequence name (define, delete; replay by name)") \
+    ARG(text, string, optional, "", MCP_ANY, "Text to compile and store (define, UTF-8)") \
+    ARG(layout, string, optional, "", MCP_ANY, "Keyboard layout for define (us, uk, de, fr, nordic); defaults to the firmware setting") \
+    ARG(hash, string, optional, "", MCP_ANY, "Content hash from define or list; replays without naming the sequence") \
+    ARG(delay, integer, optional, HID_TYPE_DELAY_MS, MCP_RANGE(0, 65535), "Milliseconds between reports on replay")
+
+#define HID_LEASE_ARGS(ARG) \
+    ARG(action, string, optional, "status", MCP_ANY, "acquire, release or status (default: status)") \
+    ARG(mode, string, optional, "exclusive", MCP_ANY, "exclusive or shared (acquire)") \
+    ARG(ttl_ms, integer, optional, HID_LEASE_DEFAULT_MS, MCP_RANGE(1, HID_LEASE_MAX_MS), "Lease lifetime in ms, renewed by each HID call of the holder (acquire)")
+
+#define METRICS_ARGS(ARG) \
+    ARG(method, string, optional, "", MCP_ANY, "Tool or method name for its full parse, execute and send histograms (default: a p99 summary of all)") \
+    ARG(reset, boolean, optional, false, MCP_ANY, "Zero counters and histograms after reading")
+
+// TOOL(Id, name, description, ARGS); tools/list keeps this order
+#define MCP_TOOLS(TOOL) \
+    TOOL(KeyboardType, TOOL_KEYBOARD_TYPE, "Type text using the keyboard", KEYBOARD_TYPE_ARGS) \
+    TOOL(KeyboardKey, TOOL_KEYBOARD_KEY, "Press a specific key or key combination", KEYBOARD_KEY_ARGS) \
+    TOOL(KeyboardShortcut, TOOL_KEYBOARD_SHORTCUT, "Send a keyboard shortcut combination", KEYBOARD_SHORTCUT_ARGS) \
+    TOOL(MouseMove, TOOL_MOUSE_MOVE, "Move the mouse cursor", MOUSE_MOVE_ARGS) \
+    TOOL(MouseClick, TOOL_MOUSE_CLICK, "Click mouse button", MOUSE_CLICK_ARGS) \
+    TOOL(MouseScroll, TOOL_MOUSE_SCROLL, "Scroll the mouse wheel", MOUSE_SCROLL_ARGS) \
+    TOOL(MousePath, TOOL_MOUSE_PATH, "Move the mouse along a path in one request (smooth motion or drags)", MOUSE_PATH_ARGS) \
+    TOOL(MouseCalibrate, TOOL_MOUSE_CALIBRATE, "Calibrate relative mouse moves against host pointer acceleration: " \
+         "start, then for each probe run it and record the pixels the cursor moved right, then commit", MOUSE_CALIBRATE_ARGS) \
+    TOOL(SystemStatus, TOOL_SYSTEM_STATUS, "Get system status information", SYSTEM_STATUS_ARGS) \
+    TOOL(HIDBenchmark, TOOL_HID_BENCHMARK, "Measure HID throughput, frame-to-report latency and report jitter; " \
+         "start a run, then poll result until state is done", HID_BENCHMARK_ARGS) \
+    TOOL(JobStatus, TOOL_JOB_STATUS, "Report queue depth and the state of this connection's tools/call jobs", JOB_STATUS_ARGS) \
+    TOOL(RunScript, TOOL_RUN_SCRIPT, "Compile a multi-step keyboard and mouse macro and run it on the device with local timing; " \
+         "poll status until state is done", RUN_SCRIPT_ARGS) \
+    TOOL(Sequence, TOOL_SEQUENCE, "Store text as a named, precompiled keystroke sequence in flash and replay it " \
+         "by name or content hash without re-sending it", SEQUENCE_ARGS) \
+    TOOL(Metrics, TOOL_METRICS, "Request, error and byte counters, queue gauges and per-method latency histograms", METRICS_ARGS) \
+    TOOL(HIDLease, TOOL_HID_LEASE, "Take, renew or release a lease on keyboard and mouse so other clients cannot " \
+         "interleave input", HID_LEASE_ARGS)
+
+// Argument types: C++ type, JSON type name, and schema fragment
+#define MCP_CTYPE_integer int32_t
+#define MCP_CTYPE_number float
+#define MCP_CTYPE_boolean bool
+#define MCP_CTYPE_string const char*
+#define MCP_CTYPE_points JsonArrayConst
+
+#define MCP_JSON_TYPE_integer "integer"
+#define MCP_JSON_TYPE_number "number"
+#define MCP_JSON_TYPE_boolean "boolean"
+#define MCP_JSON_TYPE_string "string"
+#define MCP_JSON_TYPE_points "an array of {x, y} integers" MCP_RANGE_TEXT_MCP_RANGE(MCP_POINT_MIN, MCP_POINT_MAX)
+
+#define MCP_SCHEMA_integer "\"type\":\"integer\""
+#define MCP_SCHEMA_number "\"type\":\"number\""
+#define MCP_SCHEMA_boolean "\"type\":\"boolean\""
+#define MCP_SCHEMA_string "\"type\":\"string\""
+#define MCP_SCHEMA_points "\"type\":\"array\",\"items\":{\"type\":\"object\",\"properties\":" \
+                          "{\"x\":{\"type\":\"integer\"" MCP_SCHEMA_RANGE_MCP_POINT_RANGE "}," \
+                          "\"y\":{\"type\":\"integer\"" MCP_SCHEMA_RANGE_MCP_POINT_RANGE "}}}"
+
+#define MCP_STRINGIFY(value) #value
+#define MCP_NUMBER_TEXT(value) MCP_STRINGIFY(value)
+
+// Range helpers, reached by pasting: MCP_RANGE_MIN_##range and so on
+#define MCP_RANGE_MIN_MCP_RANGE(min, max) (min)
+#define MCP_RANGE_MAX_MCP_RANGE(min, max) (max)
+#define MCP_RANGE_MIN_MCP_ANY INT32_MIN
+#define MCP_RANGE_MAX_MCP_ANY INT32_MAX
+#define MCP_SCHEMA_RANGE_MCP_RANGE(min, max) ",\"minimum\":" MCP_NUMBER_TEXT(min) ",\"maximum\":" MCP_NUMBER_TEXT(max)
+#define MCP_SCHEMA_RANGE_MCP_ANY ""
+#define MCP_RANGE_TEXT_MCP_RANGE(min, max) " from " MCP_NUMBER_TEXT(min) " to " MCP_NUMBER_TEXT(max)
+#define MCP_RANGE_TEXT_MCP_ANY ""
+
+// Bounds of mouse_path waypoint coordinates, which are int16
+#define MCP_POINT_MIN -32767
+#define MCP_POINT_MAX 32767
+#define MCP_SCHEMA_RANGE_MCP_POINT_RANGE MCP_SCHEMA_RANGE_MCP_RANGE(MCP_POINT_MIN, MCP_POINT_MAX)
+
+#define MCP_ARG_IS_required true
+#define MCP_ARG_IS_optional false
+
+// Argument structs
+#define MCP_ARG_FIELD(name, type, presence, def, range, desc) MCP_CTYPE_##type name;
+#define MCP_TOOL_ARGS_STRUCT(id, name, description, ARGS) \
+    struct id##Args { ARGS(MCP_ARG_FIELD) };
+MCP_TOOLS(MCP_TOOL_ARGS_STRUCT)
+#undef MCP_TOOL_ARGS_STRUCT
+
+#define MCP_TOOL_ENUM(id, name, description, ARGS) MCP_TOOL_##id,
+enum MCPToolId : uint8_t {
+    MCP_TOOLS(MCP_TOOL_ENUM)
+    MCP_TOOL_COUNT
+};
+#undef MCP_TOOL_ENUM
+
+// Fills out from args; on failure error names the offending argument
+#define MCP_TOOL_DECODE_DECL(id, name, description, ARGS) \
+    bool decodeToolArgs(JsonObjectConst args, id##Args& out, const char*& error);
+MCP_TOOLS(MCP_TOOL_DECODE_DECL)
+#undef MCP_TOOL_DECODE_DECL
+
+// Tool id for name, or -1; one hash and usually one string compare
+int findTool(const char* name);
+const char* toolName(uint8_t tool);
+
+constexpr uint32_t fnv1a(const char* text, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#endif // MCP_TOOLS_H
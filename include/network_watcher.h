@@ -0,0 +1,52 @@
+#ifndef NETWORK_WATCHER_H
+#define NETWORK_WATCHER_H
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include <atomic>
+#include "config.h"
+#include "event_loop.h"
+
+// WebSocketsServer that exposes its client sockets, so they can be
+// watched for data instead of polled
+class WatchedWebSocketsServer : public WebSocketsServer {
+public:
+    using WebSocketsServer::WebSocketsServer;
+
+    // Socket of a connected client slot, or -1
+    int clientSocket(uint8_t num);
+    // Bytes already read off a client's socket into its buffer, which
+    // select() cannot see
+    bool clientBuffered(uint8_t num);
+};
+
+// Task that blocks in select() on the WebSocket client sockets and wakes
+// the main loop with EVENT_NETWORK when one becomes readable, or with
+// EVENT_NETWORK_POLL after NETWORK_POLL_MS so new connections, heartbeats
+// and the polled HTTP servers are still serviced.
+//
+// After each wakeup it waits for rearm(), which the main loop calls once it
+// has read the sockets; otherwise a socket that is still readable would
+// wake it again at once.
+class NetworkWatcher {
+private:
+    WatchedWebSocketsServer* server;
+    EventLoop* loop;
+    TaskHandle_t task;
+    // Sockets to watch, published by rearm() for the watcher task
+    std::atomic<int> sockets[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+    static void taskMain(void* context);
+    void watch();
+
+public:
+    NetworkWatcher(WatchedWebSocketsServer* ws, EventLoop* eventLoop);
+
+    bool begin();
+    // Main loop, after servicing the network: takes the current sockets
+    // and watches again. True when a client still has buffered bytes, in
+    // which case the network needs servicing again without waiting.
+    bool rearm();
+};
+
+#endif // NETWORK_WATCHER_H
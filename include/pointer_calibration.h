@@ -0,0 +1,55 @@
+#ifndef POINTER_CALIBRATION_H
+#define POINTER_CALIBRATION_H
+
+#include <Arduino.h>
+
+#define POINTER_CALIBRATION_POINTS 8
+
+// Learns the host's pointer acceleration curve for relative mouse reports.
+//
+// The device cannot see the cursor, so calibration is driven by the agent:
+// for each probe size the firmware sends a burst of equal reports along +X
+// and the agent records how many pixels the cursor actually travelled.
+// commit() turns the measurements into a monotonic pixels-per-report curve
+// and stores it in EEPROM. Relative moves are then planned against that
+// curve so one mouse_move lands within a few pixels of the requested delta.
+class PointerCalibration {
+public:
+    // Counts per report for each probe, smallest first
+    static const uint8_t PROBE_COUNTS[POINTER_CALIBRATION_POINTS];
+
+    PointerCalibration();
+
+    // Loads a stored calibration, if any
+    void begin();
+
+    bool isValid() const { return valid; }
+
+    // Probe sequence
+    void start();
+    uint8_t probeReports(uint8_t index) const;
+    uint8_t nextProbe() const;   // First unrecorded probe, or POINTER_CALIBRATION_POINTS
+    bool record(uint8_t index, float pixels);
+    bool isComplete() const;
+    bool commit();
+
+    // Forgets the stored calibration; moves go out uncompensated again
+    void reset();
+
+    // Calibrated curve: pixels travelled by one report of the given size,
+    // and the report size that travels closest to the given distance
+    // (0 when even a single count overshoots by more than half)
+    float pixelsPerReport(uint8_t counts) const;
+    uint8_t countsForPixels(float pixels) const;
+
+private:
+    float curve[POINTER_CALIBRATION_POINTS];      // Committed pixels per report
+    float measured[POINTER_CALIBRATION_POINTS];   // Pixels per report being recorded
+    uint8_t recorded;                             // Bitmask of recorded probes
+    bool valid;
+
+    bool load();
+    bool save();
+};
+
+#endif // POINTER_CALIBRATION_H
@@ -0,0 +1,69 @@
+#ifndef SESSION_AUTH_H
+#define SESSION_AUTH_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+#define AUTH_CHALLENGE_SIZE 16
+#define AUTH_TOKEN_SIZE 16
+#define AUTH_CHALLENGE_TTL_MS 30000
+
+// Challenge-response authentication for a client slot, done once per
+// connection so ordinary messages only pay for a token compare.
+//
+//   1. initialize without params.auth is refused with a random challenge
+//   2. initialize with params.auth.response = hex HMAC-SHA256(API_KEY,
+//      challenge bytes) returns a session token bound to the slot
+//   3. every later message carries "session": token
+//
+// HMAC runs through mbedtls, which the ESP32 core backs with the SHA
+// accelerator; the challenge comes from the hardware RNG. A challenge
+// answers one attempt only.
+//
+// The metrics HTTP endpoint has no handshake; it takes a fixed bearer
+// token, hex HMAC-SHA256(API_KEY, "metrics"), so scrape configs need not
+// hold the key itself.
+class SessionAuth {
+private:
+    struct Slot {
+        bool challenged;
+        bool authenticated;
+        unsigned long challengeMs;
+        uint8_t challenge[AUTH_CHALLENGE_SIZE];
+        char token[AUTH_TOKEN_SIZE * 2 + 1];      // Hex, as clients send it
+    };
+    Slot slots[MAX_CLIENTS];
+    const char* key;
+
+    uint32_t handshakes;
+    uint32_t failures;
+    uint32_t checks;
+    uint64_t checkCycles;
+    uint32_t hmacUs;              // Of the last handshake
+
+    void hmac(const uint8_t* data, size_t length, uint8_t out[32]);
+
+public:
+    SessionAuth(const char* apiKey);
+
+    void reset(uint8_t clientId);
+    bool isAuthenticated(uint8_t clientId) const { return slots[clientId].authenticated; }
+
+    // Issues a fresh challenge; hex needs AUTH_CHALLENGE_SIZE * 2 + 1 bytes
+    void challenge(uint8_t clientId, char* hex);
+
+    // Checks a response to the slot's challenge; on success the slot is
+    // authenticated and its token returned
+    bool verify(uint8_t clientId, const char* responseHex, const char*& token);
+
+    // Constant-time check of a message's session token
+    bool check(uint8_t clientId, const char* token);
+
+    // Checks an HTTP Authorization header against the metrics token
+    bool checkMetricsBearer(const char* authorization);
+
+    void results(JsonObject out) const;
+};
+
+#endif // SESSION_AUTH_H
@@ -0,0 +1,76 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Fixed-size ring for exactly one producer and one consumer, which may run
+// on different cores without a lock. The producer only moves head and the
+// consumer only moves tail; each publishes with a release store and reads
+// the other's index with an acquire load, so an item is always written
+// before it can be seen.
+//
+// Items between tail and head belong to the consumer, which may modify
+// them in place (at(), front()) before popping them.
+//
+// No Arduino dependencies, so it can be built and checked on the host.
+template <typename T, uint32_t Capacity>
+class SPSCRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "SPSCRing capacity must be a power of two");
+
+private:
+    T items[Capacity];
+    // Free-running counts of items ever pushed and popped; their difference
+    // is the fill level even across wraparound
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+
+public:
+    SPSCRing() : head(0), tail(0) {}
+
+    // Producer side
+    size_t free() const { return Capacity - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire)); }
+
+    bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= Capacity) return false;
+        items[h % Capacity] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // All or nothing, published at once
+    bool write(const T* source, size_t count) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (count > Capacity - (h - tail.load(std::memory_order_acquire))) return false;
+        for (size_t i = 0; i < count; i++) items[(h + i) % Capacity] = source[i];
+        head.store(h + count, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+
+    // index counts from the oldest item; valid below size()
+    T& at(size_t index) { return items[(tail.load(std::memory_order_relaxed) + index) % Capacity]; }
+    const T& at(size_t index) const { return items[(tail.load(std::memory_order_relaxed) + index) % Capacity]; }
+    T& front() { return at(0); }
+
+    void drop(size_t count) { tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release); }
+    void pop() { drop(1); }
+
+    bool pop(T& item) {
+        if (empty()) return false;
+        item = front();
+        pop();
+        return true;
+    }
+
+    // Consumer side; empties the ring without taking items one by one
+    void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+};
+
+#endif // SPSC_RING_H
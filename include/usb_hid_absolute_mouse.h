@@ -0,0 +1,32 @@
+#ifndef USB_HID_ABSOLUTE_MOUSE_H
+#define USB_HID_ABSOLUTE_MOUSE_H
+
+#include <Arduino.h>
+#include "USBHID.h"
+
+// USBHID already uses report ids 1-6 (keyboard, mouse, gamepad, consumer,
+// system, vendor)
+#define HID_REPORT_ID_ABSOLUTE_MOUSE 7
+
+// Logical range of the absolute X/Y axes; the host maps it onto the screen
+#define HID_ABSOLUTE_MAX 32767
+
+// Absolute pointer added to the composite USB device next to USBHIDMouse.
+// A single report places the cursor anywhere on screen, so reaching a
+// coordinate no longer means slamming into a corner and stepping back.
+class USBHIDAbsoluteMouse : public USBHIDDevice {
+private:
+    USBHID hid;
+
+public:
+    USBHIDAbsoluteMouse();
+    void begin();
+
+    // x and y in 0..HID_ABSOLUTE_MAX
+    bool move(uint16_t x, uint16_t y, int8_t wheel = 0);
+
+    // USBHIDDevice
+    uint16_t _onGetDescriptor(uint8_t* buffer) override;
+};
+
+#endif // USB_HID_ABSOLUTE_MOUSE_H
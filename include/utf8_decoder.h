@@ -0,0 +1,60 @@
+#ifndef UTF8_DECODER_H
+#define UTF8_DECODER_H
+
+#include <stdint.h>
+
+// Incremental UTF-8 decoder fed one byte at a time, so text can be decoded
+// straight out of a ring buffer. Malformed, overlong and surrogate sequences
+// are dropped rather than reported.
+class Utf8Decoder {
+private:
+    uint32_t codepoint;
+    uint32_t minimum;
+    uint8_t remaining;
+
+public:
+    Utf8Decoder() : codepoint(0), minimum(0), remaining(0) {}
+
+    void reset() {
+        codepoint = 0;
+        minimum = 0;
+        remaining = 0;
+    }
+
+    // Returns true when byte completes a code point, stored in out
+    bool feed(uint8_t byte, uint32_t& out) {
+        if ((byte & 0xc0) == 0x80) {
+            if (remaining == 0) return false;
+            codepoint = (codepoint << 6) | (byte & 0x3f);
+            if (--remaining > 0) return false;
+            if (codepoint < minimum || codepoint > 0x10ffff ||
+                (codepoint >= 0xd800 && codepoint <= 0xdfff)) {
+                return false;
+            }
+            out = codepoint;
+            return true;
+        }
+
+        // Any non-continuation byte abandons an unfinished sequence
+        remaining = 0;
+        if (byte < 0x80) {
+            out = byte;
+            return true;
+        } else if ((byte & 0xe0) == 0xc0) {
+            codepoint = byte & 0x1f;
+            minimum = 0x80;
+            remaining = 1;
+        } else if ((byte & 0xf0) == 0xe0) {
+            codepoint = byte & 0x0f;
+            minimum = 0x800;
+            remaining = 2;
+        } else if ((byte & 0xf8) == 0xf0) {
+            codepoint = byte & 0x07;
+            minimum = 0x10000;
+            remaining = 3;
+        }
+        return false;
+    }
+};
+
+#endif // UTF8_DECODER_H
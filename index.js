@@ -65,16 +65,58 @@ psAI-Ducky — ESP32-S2 HID MCP Bridge (Node client)
 const MockedWebSocket = globalThis.__ESP32_MCP_MOCKS__?.WebSocket;
 const WebSocket = MockedWebSocket || require('ws');
 const readline = require('readline');
+const crypto = require('crypto');
+
+// Tools that queue no HID work and so spend no flow-control credits
+const CREDIT_FREE_TOOLS = new Set(['system_status', 'job_status', 'metrics', 'hid_lease']);
+// Actions of other tools that only read their state, with each tool's default action
+const CREDIT_FREE_ACTIONS = {
+    hid_benchmark: { free: 'result', fallback: 'result' },
+    run_script: { free: 'status', fallback: 'run' }
+};
+
+function spendsCredits(toolName, args) {
+    const poll = CREDIT_FREE_ACTIONS[toolName];
+    if (poll) {
+        return (args?.action ?? poll.fallback) !== poll.free;
+    }
+    return !CREDIT_FREE_TOOLS.has(toolName);
+}
+// JSON-RPC error the ESP32 answers with when a call exceeds its credits
+const ESP32_BUSY = -32002;
 
 class ESP32MCPServer {
     constructor() {
 this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
         this.esp32Port = process.env.ESP32_PORT || '8080';
+        // Status codes instead of echoed text for HID calls
+        this.verbosity = process.env.ESP32_VERBOSITY || 'minimal';
+        // Answers the initialize challenge when the firmware has
+        // ENABLE_AUTHENTICATION; the session token then goes with every request
+        this.apiKey = process.env.ESP32_API_KEY || '';
+        this.session = null;
         this.esp32Ws = null;
         this.initialized = false;
         this.requestId = 1;
         this.connectPromise = null;
         
+        // In-flight requests by JSON-RPC id; the ESP32 may answer out of order
+        this.pending = new Map();
+        // tools/call jobs still running on the ESP32, by request id, with
+        // the credit bytes they hold
+        this.jobs = new Map();
+        
+        // Flow-control allowance from initialize; HID calls wait here until
+        // their frame fits, instead of overrunning the ESP32's queues
+        this.credits = null;
+        this.creditsInFlight = { bytes: 0, jobs: 0 };
+        this.creditWaiters = [];
+        
+        // tools/list cache, valid while the ESP32 advertises the same schemaHash
+        this.schemaHash = null;
+        this.cachedTools = null;
+        this.cachedToolsHash = null;
+        
         // Setup stdio interface
         this.rl = readline.createInterface({
             input: process.stdin,
@@ -104,6 +146,8 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
         }
         this.esp32Ws = null;
         this.initialized = false;
+        this.session = null;
+        this.credits = null;
     }
     
     async connectToESP32() {
@@ -125,10 +169,15 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                 console.error(`⚠️  ESP32 socket error: ${error.message}`);
             };
 
+            const handleMessage = (data) => this.handleESP32Message(data);
+
             const handleClose = () => {
                 socket.off('error', handleRuntimeError);
+                socket.off('message', handleMessage);
                 if (this.esp32Ws === socket) {
+                    this.rejectPending(new Error('ESP32 connection closed'));
                     this.initialized = false;
+                    this.session = null;
                     this.esp32Ws = null;
                 }
             };
@@ -159,16 +208,31 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                 try {
                     socket.off('error', handleError);
                     socket.on('error', handleRuntimeError);
-                    const response = await this.sendToESP32({
-                        method: 'initialize',
-                        params: {
-                            protocolVersion: '2024-11-05',
-                            capabilities: { tools: true },
-                            clientInfo: { name: 'esp32-hid-mcp-bridge', version: '1.0.0' }
-                        }
-                    }, { skipEnsure: true });
+                    const params = {
+                        protocolVersion: '2024-11-05',
+                        capabilities: { tools: true },
+                        clientInfo: { name: 'esp32-hid-mcp-bridge', version: '1.0.0' },
+                        verbosity: this.verbosity
+                    };
+                    let response = await this.sendToESP32({ method: 'initialize', params }, { skipEnsure: true });
+
+                    const challenge = response.error?.data?.challenge;
+                    if (challenge && this.apiKey) {
+                        const answer = crypto.createHmac('sha256', this.apiKey)
+                            .update(Buffer.from(challenge, 'hex'))
+                            .digest('hex');
+                        response = await this.sendToESP32({
+                            method: 'initialize',
+                            params: { ...params, auth: { response: answer } }
+                        }, { skipEnsure: true });
+                    } else if (challenge) {
+                        console.error('⚠️  ESP32 requires authentication; set ESP32_API_KEY');
+                    }
 
                     if (response.result) {
+                        this.schemaHash = response.result.schemaHash || null;
+                        this.session = response.result.session || null;
+                        this.credits = response.result.credits || null;
                         this.initialized = true;
                         resolve(true);
                     } else {
@@ -194,6 +258,7 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
 
             socket.once('open', handleOpen);
             socket.once('error', handleError);
+            socket.on('message', handleMessage);
             socket.on('close', handleClose);
         });
 
@@ -217,7 +282,7 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
     }
 
     async sendToESP32(message, options = {}) {
-        const { skipEnsure = false } = options;
+        const { skipEnsure = false, credit = false } = options;
 
         if (!skipEnsure) {
             const connected = await this.ensureConnected();
@@ -234,53 +299,159 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
             method: message.method,
             params: message.params || {}
         };
+        if (this.session) {
+            request.session = this.session;
+        }
+
+        // The ESP32 charges the frame exactly as sent
+        const frame = JSON.stringify(request);
+        const cost = credit && this.credits ? Buffer.byteLength(frame) : 0;
+        if (cost && !(await this.acquireCredits(cost))) {
+            throw new Error('Not connected to ESP32');
+        }
 
         return new Promise((resolve, reject) => {
             const timeout = setTimeout(() => {
-                this.esp32Ws.off('message', messageHandler);
+                this.pending.delete(request.id);
+                this.releaseCredits(cost);
                 reject(new Error('ESP32 request timeout'));
             }, 10000);
 
-            const messageHandler = (data) => {
-                clearTimeout(timeout);
-                this.esp32Ws.off('message', messageHandler);
-
-                try {
-                    const response = JSON.parse(data.toString());
-                    resolve(response);
-                } catch (error) {
-                    reject(error);
-                }
-            };
-
+            this.pending.set(request.id, { resolve, reject, timeout, cost });
             try {
-                this.esp32Ws.on('message', messageHandler);
-                this.esp32Ws.send(JSON.stringify(request));
+                this.esp32Ws.send(frame);
             } catch (error) {
                 clearTimeout(timeout);
-                this.esp32Ws.off('message', messageHandler);
+                this.pending.delete(request.id);
+                this.releaseCredits(cost);
                 reject(error);
             }
         });
     }
 
+    // Waits until a call of this many bytes fits the credits, then takes
+    // them; false if the connection went away meanwhile. A frame larger
+    // than the whole byte credit goes alone, as the ESP32 allows.
+    async acquireCredits(bytes) {
+        for (;;) {
+            if (!this.credits) {
+                return false;
+            }
+            const inFlight = this.creditsInFlight;
+            if (inFlight.jobs < this.credits.jobs &&
+                (inFlight.bytes === 0 || inFlight.bytes + bytes <= this.credits.bytes)) {
+                inFlight.bytes += bytes;
+                inFlight.jobs += 1;
+                return true;
+            }
+            await new Promise((resolve) => this.creditWaiters.push(resolve));
+        }
+    }
+
+    releaseCredits(bytes) {
+        if (!bytes) {
+            return;
+        }
+        this.creditsInFlight.bytes -= bytes;
+        this.creditsInFlight.jobs -= 1;
+        this.wakeCreditWaiters();
+    }
+
+    wakeCreditWaiters() {
+        const waiters = this.creditWaiters;
+        this.creditWaiters = [];
+        for (const resolve of waiters) {
+            resolve();
+        }
+    }
+
+    // Routes every frame from the ESP32: responses to the request with the
+    // same id, job completion notifications to the job table
+    handleESP32Message(data) {
+        let message;
+        try {
+            message = JSON.parse(data.toString());
+        } catch (error) {
+            console.error(`⚠️  Invalid message from ESP32: ${error.message}`);
+            return;
+        }
+
+        if (message.method === 'notifications/tools/completed') {
+            const job = this.jobs.get(message.params?.id);
+            if (job) {
+                this.jobs.delete(message.params.id);
+                this.releaseCredits(job.cost);
+            }
+            return;
+        }
+
+        const waiter = this.pending.get(message.id);
+        if (!waiter) {
+            return;
+        }
+        clearTimeout(waiter.timeout);
+        this.pending.delete(message.id);
+
+        // Minimal results carry status 1 instead of state and job. Credits
+        // of a queued call are held until its completion notification.
+        const result = message.result;
+        if (result && (result.state === 'queued' || result.status === 1)) {
+            this.jobs.set(message.id, { job: result.job, cost: waiter.cost });
+        } else {
+            this.releaseCredits(waiter.cost);
+        }
+        waiter.resolve(message);
+    }
+
+    rejectPending(error) {
+        for (const waiter of this.pending.values()) {
+            clearTimeout(waiter.timeout);
+            waiter.reject(error);
+        }
+        this.pending.clear();
+        this.jobs.clear();
+        // Credits come back with the next initialize
+        this.credits = null;
+        this.creditsInFlight = { bytes: 0, jobs: 0 };
+        this.wakeCreditWaiters();
+    }
+
     async getTools() {
+        // Reconnects re-run initialize; skip tools/list if the schema is unchanged
+        if (this.cachedTools && this.schemaHash && this.schemaHash === this.cachedToolsHash) {
+            return this.cachedTools;
+        }
+
         const response = await this.sendToESP32({
             method: 'tools/list',
             params: {}
         });
-        return this.extractTools(response);
+        const tools = this.extractTools(response);
+        if (tools.length > 0 && this.schemaHash) {
+            this.cachedTools = tools;
+            this.cachedToolsHash = this.schemaHash;
+        }
+        return tools;
     }
 
     async callTool(toolName, args) {
-        const response = await this.sendToESP32({
-            method: 'tools/call',
-            params: {
-                name: toolName,
-                args: args
+        const credit = spendsCredits(toolName, args);
+        for (let attempt = 0; ; attempt++) {
+            const response = await this.sendToESP32({
+                method: 'tools/call',
+                params: {
+                    name: toolName,
+                    args: args
+                }
+            }, { credit });
+            // Busy when our count drifted from the ESP32's, e.g. after
+            // another bridge on the same key, or when an earlier call is
+            // still waiting for its HID turn; wait for either to finish and retry
+            if (response.error?.code !== ESP32_BUSY || attempt >= 3 || this.creditsInFlight.jobs === 0) {
+                return response;
             }
-        });
-        return response;
+            await new Promise((resolve) => this.creditWaiters.push(resolve));
+        }
     }
 
     extractTools(response) {
@@ -306,7 +477,11 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                     properties: {
                         text: {
                             type: "string",
-                            description: "Text to type"
+                            description: "Text to type (UTF-8)"
+                        },
+                        layout: {
+                            type: "string",
+                            description: "Target keyboard layout (us, uk, de, fr, nordic); defaults to the firmware setting"
                         }
                     },
                     required: ["text"]
@@ -320,11 +495,11 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                     properties: {
                         key: {
                             type: "string",
-                            description: "Key to press (e.g., 'a', 'Enter', 'F1')"
+                            description: "Key to press (e.g., 'a', 'Enter', 'PgDn', 'F13', 'kp_plus', 'VolumeUp')"
                         },
                         modifiers: {
                             type: "string",
-                            description: "Modifier keys (ctrl, shift, alt, gui)"
+                            description: "Modifier keys separated by spaces or + (ctrl, shift, alt, gui, altgr, rctrl, ...)"
                         }
                     },
                     required: ["key"]
@@ -352,15 +527,19 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                     properties: {
                         x: {
                             type: "integer",
-                            description: "X coordinate or relative movement"
+                            minimum: -32767,
+                            maximum: 32767,
+                            description: "X movement, or screen pixel when relative is false"
                         },
                         y: {
                             type: "integer",
-                            description: "Y coordinate or relative movement"
+                            minimum: -32767,
+                            maximum: 32767,
+                            description: "Y movement, or screen pixel when relative is false"
                         },
                         relative: {
                             type: "boolean",
-                            description: "Whether movement is relative (default: true)"
+                            description: "Relative movement (default: true); false places the cursor in one absolute report"
                         }
                     },
                     required: ["x", "y"]
@@ -378,6 +557,8 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                         },
                         duration: {
                             type: "integer",
+                            minimum: 0,
+                            maximum: 65535,
                             description: "Click duration in milliseconds"
                         }
                     }
@@ -391,12 +572,77 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                     properties: {
                         scroll: {
                             type: "integer",
+                            minimum: -127,
+                            maximum: 127,
                             description: "Scroll amount (positive = up, negative = down)"
                         }
                     },
                     required: ["scroll"]
                 }
             },
+            {
+                name: "mouse_path",
+                description: "Move the mouse along a path in one request (smooth motion or drags)",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        points: {
+                            type: "array",
+                            description: "Waypoints {x, y}; offsets from the start position when relative, screen pixels otherwise",
+                            items: {
+                                type: "object",
+                                properties: {
+                                    x: { type: "integer", minimum: -32767, maximum: 32767 },
+                                    y: { type: "integer", minimum: -32767, maximum: 32767 }
+                                }
+                            }
+                        },
+                        curve: {
+                            type: "string",
+                            description: "line (through every point, default) or bezier (points are control points, last is the end)"
+                        },
+                        relative: {
+                            type: "boolean",
+                            description: "Points are offsets from the current position (default: true)"
+                        },
+                        duration: {
+                            type: "integer",
+                            minimum: 0,
+                            maximum: 65535,
+                            description: "Time to travel the whole path in milliseconds (default: 0, as fast as possible)"
+                        },
+                        button: {
+                            type: "string",
+                            description: "Button to hold for a drag (left, right, middle)"
+                        }
+                    },
+                    required: ["points"]
+                }
+            },
+            {
+                name: "mouse_calibrate",
+                description: "Calibrate relative mouse moves against host pointer acceleration: start, then for each probe run it and record the pixels the cursor moved right, then commit",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        action: {
+                            type: "string",
+                            description: "start, probe, record, commit, status or reset"
+                        },
+                        probe: {
+                            type: "integer",
+                            minimum: -1,
+                            maximum: 255,
+                            description: "Probe index for probe/record (default: next unrecorded probe)"
+                        },
+                        pixels: {
+                            type: "number",
+                            description: "Horizontal pixels the cursor travelled during the probe (record)"
+                        }
+                    },
+                    required: ["action"]
+                }
+            },
             {
                 name: "system_status",
                 description: "Get system status information",
@@ -404,6 +650,143 @@ this.esp32Host = process.env.ESP32_HOST || '192.168.4.1';
                     type: "object",
                     properties: {}
                 }
+            },
+            {
+                name: "hid_benchmark",
+                description: "Measure HID throughput, frame-to-report latency and report jitter; start a run, then poll result until state is done",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        action: {
+                            type: "string",
+                            description: "start, result or stop (default: result)"
+                        },
+                        mode: {
+                            type: "string",
+                            description: "keyboard (typed text) or mouse (mouse_move calls)"
+                        },
+                        rate: {
+                            type: "integer",
+                            minimum: 0,
+                            maximum: 65535,
+                            description: "Reports/s for keyboard, calls/s for mouse; 0 = as fast as possible"
+                        },
+                        duration: {
+                            type: "integer",
+                            minimum: 0,
+                            maximum: 10000,
+                            description: "Run time in milliseconds (default: 2000, max: 10000)"
+                        }
+                    }
+                }
+            },
+            {
+                name: "job_status",
+                description: "Report queue depth and the state of this connection's tools/call jobs",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        job: {
+                            type: "integer",
+                            minimum: 0,
+                            maximum: 2147483647,
+                            description: "Job id from a tools/call result (default: 0, every job of this connection)"
+                        }
+                    }
+                }
+            },
+            {
+                name: "run_script",
+                description: "Compile a multi-step keyboard and mouse macro and run it on the device with local timing; poll status until state is done",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        action: {
+                            type: "string",
+                            description: "run, status or stop (default: run)"
+                        },
+                        script: {
+                            type: "string",
+                            description: "DuckyScript-style source: STRING, STRINGLN, DELAY, DEFAULT_DELAY, key chords (CTRL ALT DELETE), MOUSE_MOVE, MOUSE_MOVE_TO, MOUSE_CLICK, MOUSE_PRESS, MOUSE_RELEASE, MOUSE_SCROLL, REPEAT n, VAR $name = a [op b]"
+                        }
+                    }
+                }
+            },
+            {
+                name: "sequence",
+                description: "Store text as a named, precompiled keystroke sequence in flash and replay it by name or content hash without re-sending it",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        action: {
+                            type: "string",
+                            description: "define, replay, list or delete"
+                        },
+                        name: {
+                            type: "string",
+                            description: "Sequence name (define, delete; replay by name)"
+                        },
+                        text: {
+                            type: "string",
+                            description: "Text to compile and store (define, UTF-8)"
+                        },
+                        layout: {
+                            type: "string",
+                            description: "Keyboard layout for define (us, uk, de, fr, nordic); defaults to the firmware setting"
+                        },
+                        hash: {
+                            type: "string",
+                            description: "Content hash from define or list; replays without naming the sequence"
+                        },
+                        delay: {
+                            type: "integer",
+                            minimum: 0,
+                            maximum: 65535,
+                            description: "Milliseconds between reports on replay"
+                        }
+                    },
+                    required: ["action"]
+                }
+            },
+            {
+                name: "metrics",
+                description: "Request, error and byte counters, queue gauges and per-method latency histograms",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        method: {
+                            type: "string",
+                            description: "Tool or method name for its full parse, execute and send histograms (default: a p99 summary of all)"
+                        },
+                        reset: {
+                            type: "boolean",
+                            description: "Zero counters and histograms after reading"
+                        }
+                    }
+                }
+            },
+            {
+                name: "hid_lease",
+                description: "Take, renew or release a lease on keyboard and mouse so other clients cannot interleave input",
+                inputSchema: {
+                    type: "object",
+                    properties: {
+                        action: {
+                            type: "string",
+                            description: "acquire, release or status (default: status)"
+                        },
+                        mode: {
+                            type: "string",
+                            description: "exclusive or shared (acquire)"
+                        },
+                        ttl_ms: {
+                            type: "integer",
+                            minimum: 1,
+                            maximum: 600000,
+                            description: "Lease lifetime in ms, renewed by each HID call of the holder (acquire)"
+                        }
+                    }
+                }
             }
         ];
     }
@@ -0,0 +1,50 @@
+#include "event_loop.h"
+
+static const char* const SOURCE_NAMES[EVENT_SOURCE_COUNT] = {
+    "network", "network_poll", "hid", "usb", "wifi", "timer"
+};
+
+EventLoop::EventLoop() : task(nullptr), iterations(0), wakeups(), sleepUs(0), startMs(0) {
+}
+
+void EventLoop::begin() {
+    task = xTaskGetCurrentTaskHandle();
+    startMs = millis();
+}
+
+void EventLoop::notify(EventSource source) {
+    if (task) xTaskNotify(task, EVENT_BIT(source), eSetBits);
+}
+
+uint32_t EventLoop::wait(uint32_t timeoutMs) {
+    iterations++;
+    TickType_t ticks = timeoutMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+    // A wait shorter than a tick still yields one, as delay(1) did
+    if (timeoutMs > 0 && ticks == 0) ticks = 1;
+
+    uint32_t bits = 0;
+    unsigned long start = micros();
+    if (xTaskNotifyWait(0, UINT32_MAX, &bits, ticks) != pdTRUE) {
+        bits = EVENT_BIT(EVENT_TIMER);
+    }
+    sleepUs += micros() - start;
+
+    for (uint8_t i = 0; i < EVENT_SOURCE_COUNT; i++) {
+        if (bits & EVENT_BIT(i)) wakeups[i]++;
+    }
+    return bits;
+}
+
+void EventLoop::results(JsonObject out) const {
+    unsigned long elapsedMs = millis() - startMs;
+    out["iterations"] = iterations;
+    if (elapsedMs) {
+        out["iterations_per_s"] = (float)iterations * 1000 / elapsedMs;
+        // Share of the loop task's time spent asleep rather than polling
+        out["sleep_percent"] = (float)(sleepUs / 1000) * 100 / elapsedMs;
+    }
+    JsonObject counts = out.createNestedObject("wakeups");
+    for (uint8_t i = 0; i < EVENT_SOURCE_COUNT; i++) {
+        counts[SOURCE_NAMES[i]] = wakeups[i];
+    }
+}
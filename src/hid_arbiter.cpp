@@ -0,0 +1,126 @@
+#include "hid_arbiter.h"
+
+#define TOKEN_SCALE 1000
+#define BUCKET_CAPACITY ((uint32_t)HID_RATE_LIMIT_BURST * TOKEN_SCALE)
+
+HIDArbiter::HIDArbiter() : turn(MAX_CLIENTS - 1) {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) disconnect(i);
+}
+
+void HIDArbiter::connect(uint8_t clientId, uint32_t nowMs) {
+    Client& client = clients[clientId];
+    disconnect(clientId);
+    client.tokens = BUCKET_CAPACITY;
+    client.refilledMs = nowMs;
+}
+
+void HIDArbiter::disconnect(uint8_t clientId) {
+    Client& client = clients[clientId];
+    client.waiting = false;
+    client.lease = HID_LEASE_NONE;
+    client.leaseTtlMs = 0;
+    client.leaseExpiresMs = 0;
+    client.tokens = 0;
+    client.refilledMs = 0;
+}
+
+void HIDArbiter::expireLeases(uint32_t nowMs) {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        Client& client = clients[i];
+        if (client.lease != HID_LEASE_NONE && (int32_t)(nowMs - client.leaseExpiresMs) >= 0) {
+            client.lease = HID_LEASE_NONE;
+        }
+    }
+}
+
+bool HIDArbiter::acquire(uint8_t clientId, HIDLeaseMode mode, uint32_t ttlMs, uint32_t nowMs, const char*& error) {
+    expireLeases(nowMs);
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (i == clientId || clients[i].lease == HID_LEASE_NONE) continue;
+        if (mode == HID_LEASE_EXCLUSIVE || clients[i].lease == HID_LEASE_EXCLUSIVE) {
+            error = clients[i].lease == HID_LEASE_EXCLUSIVE ? "HID is leased exclusively by another client"
+                                                            : "HID is leased shared by another client";
+            return false;
+        }
+    }
+
+    Client& client = clients[clientId];
+    client.lease = mode;
+    client.leaseTtlMs = ttlMs;
+    client.leaseExpiresMs = nowMs + ttlMs;
+    return true;
+}
+
+void HIDArbiter::release(uint8_t clientId) {
+    clients[clientId].lease = HID_LEASE_NONE;
+}
+
+uint32_t HIDArbiter::leaseRemaining(uint8_t clientId, uint32_t nowMs) const {
+    const Client& client = clients[clientId];
+    if (client.lease == HID_LEASE_NONE) return 0;
+    int32_t remaining = (int32_t)(client.leaseExpiresMs - nowMs);
+    return remaining > 0 ? remaining : 0;
+}
+
+uint8_t HIDArbiter::holders(uint32_t nowMs) {
+    expireLeases(nowMs);
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].lease != HID_LEASE_NONE) count++;
+    }
+    return count;
+}
+
+bool HIDArbiter::mayUse(uint8_t clientId, uint32_t nowMs) {
+    expireLeases(nowMs);
+    if (clients[clientId].lease != HID_LEASE_NONE) return true;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].lease != HID_LEASE_NONE) return false;
+    }
+    return true;
+}
+
+void HIDArbiter::refill(Client& client, uint32_t nowMs) {
+    // Tokens per ms are rate / 1000, so in thousandths the rate itself
+    uint32_t elapsed = nowMs - client.refilledMs;
+    uint64_t tokens = client.tokens + (uint64_t)elapsed * HID_RATE_LIMIT_PER_S;
+    client.tokens = tokens > BUCKET_CAPACITY ? BUCKET_CAPACITY : (uint32_t)tokens;
+    client.refilledMs = nowMs;
+}
+
+HIDAccess HIDArbiter::admit(uint8_t clientId, uint16_t cost, uint32_t nowMs, uint32_t& retryMs) {
+    if (!mayUse(clientId, nowMs)) return HID_ACCESS_LEASED;
+
+    Client& client = clients[clientId];
+    refill(client, nowMs);
+    // A burst larger than the bucket would never be admitted; let it drain
+    // the bucket instead
+    uint32_t needed = (uint32_t)cost * TOKEN_SCALE;
+    if (needed > BUCKET_CAPACITY) needed = BUCKET_CAPACITY;
+    if (client.tokens < needed) {
+        retryMs = (needed - client.tokens + HID_RATE_LIMIT_PER_S - 1) / HID_RATE_LIMIT_PER_S;
+        return HID_ACCESS_RATE_LIMITED;
+    }
+    client.tokens -= needed;
+
+    if (client.lease != HID_LEASE_NONE) client.leaseExpiresMs = nowMs + client.leaseTtlMs;
+    return HID_ACCESS_OK;
+}
+
+bool HIDArbiter::othersWaiting(uint8_t clientId) const {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (i != clientId && clients[i].waiting) return true;
+    }
+    return false;
+}
+
+int HIDArbiter::nextWaiting() {
+    for (uint8_t step = 1; step <= MAX_CLIENTS; step++) {
+        uint8_t candidate = (turn + step) % MAX_CLIENTS;
+        if (clients[candidate].waiting) {
+            turn = candidate;
+            return candidate;
+        }
+    }
+    return -1;
+}
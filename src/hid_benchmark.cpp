@@ -0,0 +1,283 @@
+#include "hid_benchmark.h"
+
+// Upper bounds (us) of the jitter histogram buckets; the last is open-ended
+static const uint32_t JITTER_BOUNDS_US[HID_BENCHMARK_JITTER_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2000, 5000
+};
+
+static const char BENCHMARK_TEXT[] = "the quick brown fox jumps over the lazy dog 0123456789 ";
+
+// Keep roughly this much text queued in keyboard mode
+#define BENCHMARK_TEXT_LOW_WATER 256
+
+// Mouse mode turns around every this many calls to stay on screen
+#define BENCHMARK_MOUSE_SWEEP 64
+
+// mouse_move calls issued per loop() pass at most
+#define BENCHMARK_CALLS_PER_LOOP 16
+
+HIDBenchmark::HIDBenchmark(HIDController* controller)
+    : hid(controller), running(false), draining(false), mode(HID_BENCHMARK_KEYBOARD),
+      rate(0), durationMs(0), startMs(0), finishMs(0), lastCallUs(0), calls(0), chars(0),
+      coalescedAtStart(0), direction(1), blocked(false), clientId(0), lastSequence(0), turnGate(nullptr),
+      turnNotice(nullptr), turnContext(nullptr), reports(0), firstReportUs(0), lastReportUs(0),
+      intervalMean(0), intervalM2(0), maxDeviationUs(0), jitter(), frameArmed(false),
+      frameOpen(false), frameUs(0), frameSequence(0), frameEnd(0), latencySamples(0), latencyMinUs(0),
+      latencyMaxUs(0), latencyTotalUs(0) {
+}
+
+void HIDBenchmark::begin() {
+    hid->setReportObserver(reportObserver, this);
+}
+
+bool HIDBenchmark::start(uint8_t client, HIDBenchmarkMode benchmarkMode, uint16_t targetRate, uint16_t duration) {
+    if (running || !hid->isReady() || hid->isBusy()) return false;
+
+    clientId = client;
+    lastSequence = hid->sequence();
+    mode = benchmarkMode;
+    rate = targetRate;
+    durationMs = duration > HID_BENCHMARK_MAX_DURATION_MS ? HID_BENCHMARK_MAX_DURATION_MS : duration;
+
+    calls = chars = 0;
+    // The queue is idle, so the report observer is not running
+    reports.store(0, std::memory_order_relaxed);
+    firstReportUs.store(0, std::memory_order_relaxed);
+    lastReportUs.store(0, std::memory_order_relaxed);
+    intervalMean.store(0, std::memory_order_relaxed);
+    intervalM2.store(0, std::memory_order_relaxed);
+    maxDeviationUs.store(0, std::memory_order_relaxed);
+    for (uint8_t i = 0; i < HID_BENCHMARK_JITTER_BUCKETS; i++) jitter[i].store(0, std::memory_order_relaxed);
+    latencySamples.store(0, std::memory_order_relaxed);
+    latencyMinUs.store(UINT32_MAX, std::memory_order_relaxed);
+    latencyMaxUs.store(0, std::memory_order_relaxed);
+    latencyTotalUs.store(0, std::memory_order_relaxed);
+    coalescedAtStart = hid->reportsCoalesced();
+    direction = 1;
+
+    startMs = millis();
+    finishMs = 0;
+    lastCallUs = micros();
+    draining = false;
+    blocked = false;
+    running.store(true, std::memory_order_release);
+
+    DEBUG_PRINTF("HID benchmark started: mode=%d rate=%d duration=%d\n", mode, rate, durationMs);
+    feed();
+    return true;
+}
+
+void HIDBenchmark::stop() {
+    if (!running) return;
+    // The run started on an idle queue and other clients wait for its
+    // turns, so everything up to its last call is its own
+    if (!hid->completed(lastSequence)) hid->reset(lastSequence);
+    running.store(false, std::memory_order_relaxed);
+    draining = false;
+    finishMs = millis();
+}
+
+void HIDBenchmark::loop() {
+    if (!running) return;
+
+    if (!draining) {
+        if (millis() - startMs >= durationMs) {
+            draining = true;
+        } else {
+            feed();
+        }
+    }
+
+    // Results are final once everything queued has reached the USB stack
+    if (draining && !hid->isBusy()) {
+        running.store(false, std::memory_order_relaxed);
+        draining = false;
+        finishMs = millis();
+        DEBUG_PRINTF("HID benchmark finished: %u reports\n", reports.load(std::memory_order_relaxed));
+    }
+}
+
+uint32_t HIDBenchmark::msUntilDue() {
+    // Draining ends when the last event finishes, which wakes loop()
+    if (!running || draining) return UINT32_MAX;
+    uint32_t elapsed = millis() - startMs;
+    if (elapsed >= durationMs) return 0;
+    uint32_t wait = durationMs - elapsed;
+    if (blocked || mode == HID_BENCHMARK_KEYBOARD) return wait;
+
+    // Mouse calls are paced here: the next period, or a pass every
+    // MAIN_LOOP_FEED_MS when flat out
+    uint32_t due = MAIN_LOOP_FEED_MS;
+    if (rate) {
+        long us = (long)(lastCallUs + 1000000UL / rate - micros());
+        due = us > 0 ? (us + 999) / 1000 : 0;
+    }
+    return due < wait ? due : wait;
+}
+
+void HIDBenchmark::feed() {
+    // Each pass takes a turn; the run is measured, so it spends no tokens.
+    // Waiting for it, or for queue space, ends when HID events finish.
+    blocked = true;
+    if (turnGate) {
+        uint32_t retryMs = 0;
+        HIDTurn turn = turnGate(turnContext, clientId, 0, retryMs);
+        if (turn == HID_TURN_DENIED) {
+            stop();
+            return;
+        }
+        if (turn == HID_TURN_WAIT) return;
+    }
+    uint32_t before = hid->sequence();
+    feedCalls();
+    if (hid->sequence() != before) {
+        lastSequence = hid->sequence();
+        if (turnNotice) turnNotice(turnContext, clientId);
+    }
+}
+
+void HIDBenchmark::feedCalls() {
+    if (mode == HID_BENCHMARK_KEYBOARD) {
+        // The scheduler paces text itself; just keep it supplied
+        uint16_t reportDelay = rate ? 1000 / rate : 0;
+        while (hid->freeTextBytes() > HID_TEXT_BUFFER_SIZE - BENCHMARK_TEXT_LOW_WATER) {
+            if (!hid->typeText(BENCHMARK_TEXT, KEYBOARD_LAYOUT_US, reportDelay)) break;
+            chars += sizeof(BENCHMARK_TEXT) - 1;
+            calls++;
+        }
+        return;
+    }
+
+    // Mouse: one mouse_move call per period, or a burst per pass when flat out
+    unsigned long now = micros();
+    unsigned long periodUs = rate ? 1000000UL / rate : 0;
+    blocked = false;
+    for (uint8_t budget = BENCHMARK_CALLS_PER_LOOP; budget > 0; budget--) {
+        if (periodUs && now - lastCallUs < periodUs) break;
+        if (!hid->moveMouse(direction, 0, true)) {
+            blocked = true;
+            break;
+        }
+        calls++;
+        if (calls % BENCHMARK_MOUSE_SWEEP == 0) direction = -direction;
+        lastCallUs = periodUs ? lastCallUs + periodUs : now;
+    }
+}
+
+// Frames are timed whether or not a run is going, so that the start call
+// itself is; only reports during a run are counted
+void HIDBenchmark::frameStarted(unsigned long receivedUs) {
+    // A frame still waiting for its report keeps the slot, unless its work
+    // finished without one, as when it was dropped
+    if (frameArmed.load(std::memory_order_acquire) && !hid->completed(frameEnd)) return;
+    frameUs.store(receivedUs, std::memory_order_relaxed);
+    frameSequence.store(hid->sequence(), std::memory_order_relaxed);
+    frameEnd = hid->sequence();
+    frameOpen = true;
+    frameArmed.store(true, std::memory_order_release);
+}
+
+void HIDBenchmark::frameFinished() {
+    if (!frameOpen) return;
+    frameOpen = false;
+    frameEnd = hid->sequence();
+    if (frameEnd == frameSequence.load(std::memory_order_relaxed)) {
+        frameArmed.store(false, std::memory_order_relaxed);
+    }
+}
+
+void HIDBenchmark::reportObserver(void* context) {
+    static_cast<HIDBenchmark*>(context)->onReport();
+}
+
+// Runs after every report, on the side that runs the scheduler
+void HIDBenchmark::onReport() {
+    uint32_t now = micros();
+    bool measuring = running.load(std::memory_order_acquire);
+
+    // Reports go out before their event finishes, so once the work ahead
+    // of the frame's has finished, this report is the frame's first
+    bool armed = frameArmed.load(std::memory_order_acquire);
+    if (armed && hid->completed(frameSequence.load(std::memory_order_relaxed)) &&
+        frameArmed.compare_exchange_strong(armed, false, std::memory_order_relaxed) && measuring) {
+        uint32_t latency = now - frameUs.load(std::memory_order_relaxed);
+        latencySamples.fetch_add(1, std::memory_order_relaxed);
+        latencyTotalUs.fetch_add(latency, std::memory_order_relaxed);
+        if (latency < latencyMinUs.load(std::memory_order_relaxed)) {
+            latencyMinUs.store(latency, std::memory_order_relaxed);
+        }
+        if (latency > latencyMaxUs.load(std::memory_order_relaxed)) {
+            latencyMaxUs.store(latency, std::memory_order_relaxed);
+        }
+    }
+    if (!measuring) return;
+
+    uint32_t count = reports.load(std::memory_order_relaxed);
+    if (count == 0) {
+        firstReportUs.store(now, std::memory_order_relaxed);
+    } else {
+        float interval = now - lastReportUs.load(std::memory_order_relaxed);
+        float mean = intervalMean.load(std::memory_order_relaxed);
+        float delta = interval - mean;
+        mean += delta / count;            // count intervals seen, including this one
+        intervalMean.store(mean, std::memory_order_relaxed);
+        intervalM2.store(intervalM2.load(std::memory_order_relaxed) + delta * (interval - mean),
+                         std::memory_order_relaxed);
+
+        // Jitter against the requested spacing, or the running mean when flat out
+        float expected = rate ? 1000000.0f / rate : mean;
+        uint32_t deviation = fabsf(interval - expected);
+        if (deviation > maxDeviationUs.load(std::memory_order_relaxed)) {
+            maxDeviationUs.store(deviation, std::memory_order_relaxed);
+        }
+        uint8_t bucket = 0;
+        while (bucket < HID_BENCHMARK_JITTER_BUCKETS - 1 && deviation > JITTER_BOUNDS_US[bucket]) bucket++;
+        jitter[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+    lastReportUs.store(now, std::memory_order_relaxed);
+    reports.store(count + 1, std::memory_order_relaxed);
+}
+
+void HIDBenchmark::results(JsonObject out) const {
+    bool active = running.load(std::memory_order_relaxed);
+    uint32_t reportCount = reports.load(std::memory_order_relaxed);
+    out["state"] = active ? (draining ? "draining" : "running") : (reportCount ? "done" : "idle");
+    out["mode"] = mode == HID_BENCHMARK_KEYBOARD ? "keyboard" : "mouse";
+    out["target_rate"] = rate;
+    out["duration_ms"] = durationMs;
+    out["calls"] = calls;
+    out["reports"] = reportCount;
+
+    uint32_t spanUs = lastReportUs.load(std::memory_order_relaxed) - firstReportUs.load(std::memory_order_relaxed);
+    float seconds = reportCount > 1 ? spanUs / 1000000.0f : 0;
+    out["elapsed_ms"] = (active ? millis() : finishMs) - startMs;
+    out["reports_per_s"] = seconds > 0 ? (reportCount - 1) / seconds : 0;
+    if (mode == HID_BENCHMARK_KEYBOARD) {
+        out["chars"] = chars;
+        out["chars_per_s"] = seconds > 0 && !active ? chars / seconds : 0;
+    } else {
+        out["coalesced_reports"] = hid->reportsCoalesced() - coalescedAtStart;
+    }
+
+    uint32_t samples = latencySamples.load(std::memory_order_relaxed);
+    JsonObject latency = out.createNestedObject("frame_to_report_us");
+    latency["samples"] = samples;
+    latency["min"] = samples ? latencyMinUs.load(std::memory_order_relaxed) : 0;
+    latency["avg"] = samples ? latencyTotalUs.load(std::memory_order_relaxed) / samples : 0;
+    latency["max"] = latencyMaxUs.load(std::memory_order_relaxed);
+
+    JsonObject interval = out.createNestedObject("interval_us");
+    interval["mean"] = intervalMean.load(std::memory_order_relaxed);
+    interval["stddev"] = reportCount > 2 ? sqrtf(intervalM2.load(std::memory_order_relaxed) / (reportCount - 2)) : 0;
+    interval["max_deviation"] = maxDeviationUs.load(std::memory_order_relaxed);
+    JsonArray histogram = interval.createNestedArray("jitter_histogram");
+    for (uint8_t i = 0; i < HID_BENCHMARK_JITTER_BUCKETS; i++) {
+        JsonObject bucket = histogram.createNestedObject();
+        if (i < HID_BENCHMARK_JITTER_BUCKETS - 1) {
+            bucket["le"] = JITTER_BOUNDS_US[i];
+        } else {
+            bucket["le"] = "inf";
+        }
+        bucket["count"] = jitter[i].load(std::memory_order_relaxed);
+    }
+}
@@ -2,8 +2,15 @@
 #include "config.h"
 #include <ArduinoJson.h>
 
-HIDController::HIDController(USBHIDKeyboard* kb, USBHIDMouse* ms) 
-    : keyboard(kb), mouse(ms), isInitialized(false) {
+static_assert(KEYBOARD_LAYOUT < KEYBOARD_LAYOUT_COUNT, "KEYBOARD_LAYOUT must name a layout from keyboard_layouts.h");
+
+HIDController::HIDController(USBHIDKeyboard* kb, USBHIDMouse* ms, USBHIDConsumerControl* cc,
+                             USBHIDAbsoluteMouse* am) 
+    : keyboard(kb), mouse(ms), consumer(cc), pointer(am), scheduler(kb, ms, cc, am), isInitialized(false),
+      progressObserver(nullptr), progressContext(nullptr) {
+#if HID_DUAL_CORE
+    task = nullptr;
+#endif
 }
 
 HIDController::~HIDController() {
@@ -15,54 +22,128 @@ bool HIDController::begin() {
         return false;
     }
     
+    calibration.begin();
+    
     isInitialized = true;
+#if HID_DUAL_CORE
+    scheduler.setQueueObserver(wakeTask, this);
+    if (xTaskCreatePinnedToCore(taskMain, "hid", HID_TASK_STACK_SIZE, this, HID_TASK_PRIORITY,
+                                &task, HID_TASK_CORE) != pdPASS) {
+        DEBUG_PRINTLN("HID task could not be created");
+        isInitialized = false;
+        return false;
+    }
+#endif
     DEBUG_PRINTLN("HID Controller initialized");
     return true;
 }
 
-bool HIDController::typeText(const String& text) {
-    if (!isReady()) return false;
-    
-    for (int i = 0; i < text.length(); i++) {
-        char c = text.charAt(i);
-        keyboard->write(c);
-        delay(10); // Small delay between keystrokes
+void HIDController::loop() {
+#if !HID_DUAL_CORE
+    if (isReady()) {
+        runScheduler();
+    }
+#endif
+}
+
+uint32_t HIDController::msUntilDue() {
+#if HID_DUAL_CORE
+    return UINT32_MAX;
+#else
+    return isReady() ? scheduler.msUntilDue() : UINT32_MAX;
+#endif
+}
+
+void HIDController::runScheduler() {
+    uint32_t before = scheduler.progress();
+    scheduler.loop();
+    if (progressObserver && scheduler.progress() != before) progressObserver(progressContext);
+}
+
+#if HID_DUAL_CORE
+void HIDController::taskMain(void* context) {
+    HIDController* controller = static_cast<HIDController*>(context);
+    for (;;) {
+        controller->runScheduler();
+        // Sleep until the next report is due or new events wake us. When
+        // loop() stopped on its budget, still give up a tick so the idle
+        // task on this core is never starved.
+        uint32_t wait = controller->scheduler.msUntilDue();
+        TickType_t ticks = wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait);
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    }
+}
+
+void HIDController::wakeTask(void* context) {
+    HIDController* controller = static_cast<HIDController*>(context);
+    if (controller->task) xTaskNotifyGive(controller->task);
+}
+#endif
+
+uint8_t HIDController::parseModifiers(const String& modifiers) {
+    // Tokens are separated by spaces, '+' or ','; each must name a modifier
+    uint8_t flags = 0;
+    const char* p = modifiers.c_str();
+    while (*p) {
+        while (*p == ' ' || *p == '+' || *p == ',') p++;
+        const char* start = p;
+        while (*p && *p != ' ' && *p != '+' && *p != ',') p++;
+        
+        KeyCode code;
+        if (p > start && lookupKeyName(start, p - start, code) && code.page == KEY_PAGE_MODIFIER) {
+            flags |= code.code;
+        } else if (p > start) {
+            DEBUG_PRINTF("Ignoring unknown modifier in: %s\n", modifiers.c_str());
+        }
+    }
+    return flags;
+}
+
+bool HIDController::typeText(const String& text, uint8_t layout, uint16_t reportDelay) {
+    if (!typeText(text.c_str(), text.length(), layout, reportDelay)) {
+        return false;
     }
     
-    DEBUG_PRINTF("Typed text: %s\n", text.c_str());
+    DEBUG_PRINTF("Queued text: %s\n", text.c_str());
     return true;
 }
 
-bool HIDController::pressKey(uint8_t key, uint8_t modifiers) {
+bool HIDController::typeText(const char* text, size_t length, uint8_t layout, uint16_t reportDelay) {
     if (!isReady()) return false;
     
-    keyboard->pressRaw(key);
-    if (modifiers & KEY_CTRL) keyboard->press(KEY_LEFT_CTRL);
-    if (modifiers & KEY_SHIFT) keyboard->press(KEY_LEFT_SHIFT);
-    if (modifiers & KEY_ALT) keyboard->press(KEY_LEFT_ALT);
-    if (modifiers & KEY_GUI) keyboard->press(KEY_LEFT_GUI);
+    return scheduler.enqueueText(text, length, layout, reportDelay);
+}
+
+bool HIDController::playReports(const HIDKeyboardReport* reports, uint16_t count, uint16_t reportDelay) {
+    if (!isReady()) return false;
     
-    return true;
+    return scheduler.enqueueReports(reports, count, reportDelay);
+}
+
+bool HIDController::pressKey(uint8_t key, uint8_t modifiers) {
+    if (!isReady()) return false;
+    
+    return scheduler.enqueueKey(HID_EVENT_KEY_PRESS, key, modifiers);
 }
 
 bool HIDController::releaseKey(uint8_t key, uint8_t modifiers) {
     if (!isReady()) return false;
     
-    keyboard->releaseRaw(key);
-    if (modifiers & KEY_CTRL) keyboard->release(KEY_LEFT_CTRL);
-    if (modifiers & KEY_SHIFT) keyboard->release(KEY_LEFT_SHIFT);
-    if (modifiers & KEY_ALT) keyboard->release(KEY_LEFT_ALT);
-    if (modifiers & KEY_GUI) keyboard->release(KEY_LEFT_GUI);
+    return scheduler.enqueueKey(HID_EVENT_KEY_RELEASE, key, modifiers);
+}
+
+bool HIDController::releaseAllKeys() {
+    if (!isReady()) return false;
     
-    return true;
+    return scheduler.enqueueKey(HID_EVENT_KEY_RELEASE_ALL, 0, 0);
 }
 
 bool HIDController::sendKeyStroke(uint8_t key, uint8_t modifiers) {
     if (!isReady()) return false;
+    if (scheduler.freeEvents() < 2) return false;
     
-    pressKey(key, modifiers);
-    delay(50);
-    releaseKey(key, modifiers);
+    scheduler.enqueueKey(HID_EVENT_KEY_PRESS, key, modifiers, HID_KEY_HOLD_MS);
+    scheduler.enqueueKey(HID_EVENT_KEY_RELEASE, key, modifiers);
     
     return true;
 }
@@ -70,70 +151,41 @@ bool HIDController::sendKeyStroke(uint8_t key, uint8_t modifiers) {
 bool HIDController::sendKeyStroke(const String& keyName, const String& modifiers) {
     if (!isReady()) return false;
     
-    uint8_t modifierFlags = 0;
-    if (modifiers.indexOf("ctrl") >= 0) modifierFlags |= KEY_CTRL;
-    if (modifiers.indexOf("shift") >= 0) modifierFlags |= KEY_SHIFT;
-    if (modifiers.indexOf("alt") >= 0) modifierFlags |= KEY_ALT;
-    if (modifiers.indexOf("gui") >= 0 || modifiers.indexOf("cmd") >= 0 || modifiers.indexOf("win") >= 0) {
-        modifierFlags |= KEY_GUI;
-    }
-    
-    // Handle special keys
-    uint8_t key = 0;
-    if (keyName == "Enter" || keyName == "Return") {
-        key = KEY_RETURN;
-    } else if (keyName == "Escape" || keyName == "Esc") {
-        key = KEY_ESC;
-    } else if (keyName == "Tab") {
-        key = KEY_TAB;
-    } else if (keyName == "Space") {
-        key = ' ';
-    } else if (keyName == "Backspace") {
-        key = KEY_BACKSPACE;
-    } else if (keyName == "Delete" || keyName == "Del") {
-        key = KEY_DELETE;
-    } else if (keyName == "Up") {
-        key = KEY_UP_ARROW;
-    } else if (keyName == "Down") {
-        key = KEY_DOWN_ARROW;
-    } else if (keyName == "Left") {
-        key = KEY_LEFT_ARROW;
-    } else if (keyName == "Right") {
-        key = KEY_RIGHT_ARROW;
-    } else if (keyName.startsWith("F") && keyName.length() <= 3) {
-        // Function keys F1-F12
-        int fNum = keyName.substring(1).toInt();
-        if (fNum >= 1 && fNum <= 12) {
-            key = KEY_F1 + (fNum - 1);
-        }
-    } else if (keyName.length() == 1) {
-        // Single character
-        key = keyName.charAt(0);
-    }
-    
-    if (key == 0) {
+    KeyCode code;
+    if (!resolveKey(keyName.c_str(), keyName.length(), code)) {
         DEBUG_PRINTF("Unknown key: %s\n", keyName.c_str());
         return false;
     }
     
-    // Press modifiers first
-    if (modifierFlags & KEY_CTRL) keyboard->press(KEY_LEFT_CTRL);
-    if (modifierFlags & KEY_SHIFT) keyboard->press(KEY_LEFT_SHIFT);
-    if (modifierFlags & KEY_ALT) keyboard->press(KEY_LEFT_ALT);
-    if (modifierFlags & KEY_GUI) keyboard->press(KEY_LEFT_GUI);
-    
-    // Press and release the main key
-    keyboard->press(key);
-    delay(50);
-    keyboard->release(key);
+    if (!sendKeyStroke(code, parseModifiers(modifiers))) return false;
     
-    // Release modifiers
-    if (modifierFlags & KEY_GUI) keyboard->release(KEY_LEFT_GUI);
-    if (modifierFlags & KEY_ALT) keyboard->release(KEY_LEFT_ALT);
-    if (modifierFlags & KEY_SHIFT) keyboard->release(KEY_LEFT_SHIFT);
-    if (modifierFlags & KEY_CTRL) keyboard->release(KEY_LEFT_CTRL);
+    DEBUG_PRINTF("Queued keystroke: %s with modifiers: %s\n", keyName.c_str(), modifiers.c_str());
+    return true;
+}
+
+bool HIDController::sendKeyStroke(const KeyCode& code, uint8_t modifierFlags) {
+    if (!isReady()) return false;
+    if (scheduler.freeEvents() < 4) return false;
     
-    DEBUG_PRINTF("Sent keystroke: %s with modifiers: %s\n", keyName.c_str(), modifiers.c_str());
+    if (code.page == KEY_PAGE_CONSUMER) {
+        // Media keys live on their own report; hold modifiers around them
+        if (modifierFlags) scheduler.enqueueKey(HID_EVENT_KEY_PRESS, 0, modifierFlags);
+        scheduler.enqueueConsumer(HID_EVENT_CONSUMER_PRESS, code.code, HID_KEY_HOLD_MS);
+        scheduler.enqueueConsumer(HID_EVENT_CONSUMER_RELEASE, code.code);
+        if (modifierFlags) scheduler.enqueueKey(HID_EVENT_KEY_RELEASE, 0, modifierFlags);
+    } else {
+        uint8_t usage = 0;
+        if (code.page == KEY_PAGE_MODIFIER) {
+            modifierFlags |= code.code;
+        } else {
+            usage = code.code & 0xff;
+            modifierFlags |= code.code >> 8;
+        }
+        
+        // Modifiers and key go down together and come up together
+        scheduler.enqueueKey(HID_EVENT_KEY_PRESS, usage, modifierFlags, HID_KEY_HOLD_MS);
+        scheduler.enqueueKey(HID_EVENT_KEY_RELEASE, usage, modifierFlags);
+    }
     return true;
 }
 
@@ -159,41 +211,149 @@ bool HIDController::sendAltTab() {
 }
 
 bool HIDController::sendWinKey() {
-    return sendKeyStroke("", "gui");
+    return sendKeyStroke("gui");
 }
 
 bool HIDController::moveMouse(int16_t x, int16_t y, bool relative) {
     if (!isReady()) return false;
     
-    if (relative) {
-        mouse->move(x, y);
+    bool ok;
+    if (relative && calibration.isValid()) {
+        ok = moveMouseCompensated(x, y);
+    } else if (relative && x >= -127 && x <= 127 && y >= -127 && y <= 127) {
+        ok = scheduler.enqueueMouseMove(x, y, 0);
+    } else if (relative) {
+        // Too far for one int8_t report; let the scheduler split it
+        HIDPathPoint target = {x, y};
+        ok = scheduler.enqueueMousePath(&target, 1, 0, 0);
     } else {
-        // For absolute positioning, we'd need screen resolution
-        // For now, treat as relative
-        mouse->move(x, y);
+        if (!pointer) return false;
+        ok = scheduler.enqueueMouseMoveAbsolute(scaleToAbsolute(x, SCREEN_WIDTH),
+                                                scaleToAbsolute(y, SCREEN_HEIGHT));
     }
+    if (!ok) return false;
     
     DEBUG_PRINTF("Mouse moved: x=%d, y=%d, relative=%d\n", x, y, relative);
     return true;
 }
 
+bool HIDController::moveMouseCompensated(int16_t x, int16_t y) {
+    float length = sqrtf((float)x * x + (float)y * y);
+    if (length < 0.5f) return true;
+    
+    // Count the reports first, so that a move which does not fit the queue
+    // is refused before any of it is queued. Only this side queues events,
+    // so the room found here cannot shrink.
+    float dirX = x / length;
+    float dirY = y / length;
+    if (scheduler.freeEvents() < walkCompensatedMove(length, dirX, dirY, false)) return false;
+    walkCompensatedMove(length, dirX, dirY, true);
+    return true;
+}
+
+// Walks the pixel distance along the move direction, picking each report's
+// size from the calibrated curve, and returns the number of reports. The
+// reports are evenly spaced so the host sees the same speed it did while
+// probing.
+size_t HIDController::walkCompensatedMove(float length, float dirX, float dirY, bool queue) {
+    size_t steps = 0;
+    float carryX = 0, carryY = 0;
+    float remaining = length;
+    while (remaining >= 0.5f) {
+        uint8_t counts = calibration.countsForPixels(remaining);
+        if (counts == 0) break;
+        
+        float fx = counts * dirX + carryX;
+        float fy = counts * dirY + carryY;
+        int8_t stepX = (int8_t)lroundf(fx);
+        int8_t stepY = (int8_t)lroundf(fy);
+        carryX = fx - stepX;
+        carryY = fy - stepY;
+        
+        if (queue) scheduler.enqueueMouseMove(stepX, stepY, 0, MOUSE_REPORT_INTERVAL_MS);
+        remaining -= calibration.pixelsPerReport(counts);
+        steps++;
+    }
+    return steps;
+}
+
+bool HIDController::moveMousePath(HIDPathPoint* points, uint16_t count, bool relative, bool bezier,
+                                  uint16_t durationMs, uint8_t button) {
+    if (!isReady() || count == 0) return false;
+    if (!relative && !pointer) return false;
+    if (bezier && count + (relative ? 1 : 0) > HID_PATH_MAX_BEZIER_POINTS) return false;
+    if (scheduler.freeEvents() < 4 || scheduler.freePathPoints() < count) return false;
+    
+    uint8_t flags = bezier ? HID_PATH_BEZIER : 0;
+    if (!relative) {
+        flags |= HID_PATH_ABSOLUTE;
+        for (uint16_t i = 0; i < count; i++) {
+            points[i].x = scaleToAbsolute(points[i].x, SCREEN_WIDTH);
+            points[i].y = scaleToAbsolute(points[i].y, SCREEN_HEIGHT);
+        }
+    }
+    
+    if (button) {
+        // Put the cursor on the start point before grabbing
+        if (!relative) scheduler.enqueueMouseMoveAbsolute(points[0].x, points[0].y);
+        scheduler.enqueueMouseButton(HID_EVENT_MOUSE_PRESS, button, HID_KEY_HOLD_MS);
+    }
+    if (!scheduler.enqueueMousePath(points, count, flags, durationMs)) {
+        // Never leave a button stuck down
+        if (button) scheduler.enqueueMouseButton(HID_EVENT_MOUSE_RELEASE, button);
+        return false;
+    }
+    if (button) {
+        scheduler.enqueueMouseButton(HID_EVENT_MOUSE_RELEASE, button);
+    }
+    
+    DEBUG_PRINTF("Mouse path queued: %d points over %d ms\n", count, durationMs);
+    return true;
+}
+
+bool HIDController::probePointer(uint8_t index) {
+    if (!isReady()) return false;
+    
+    uint8_t reports = calibration.probeReports(index);
+    if (reports == 0 || scheduler.freeEvents() < reports) return false;
+    
+    int8_t counts = PointerCalibration::PROBE_COUNTS[index];
+    for (uint8_t i = 0; i < reports; i++) {
+        scheduler.enqueueMouseMove(counts, 0, 0, MOUSE_REPORT_INTERVAL_MS);
+    }
+    
+    DEBUG_PRINTF("Pointer probe %d queued: %d reports of %d counts\n", index, reports, counts);
+    return true;
+}
+
+uint16_t HIDController::scaleToAbsolute(int16_t pixel, uint16_t screenSize) {
+    // Pixel 0 maps to 0 and the last pixel to HID_ABSOLUTE_MAX
+    if (pixel <= 0 || screenSize <= 1) return 0;
+    if (pixel >= screenSize - 1) return HID_ABSOLUTE_MAX;
+    return ((uint32_t)pixel * HID_ABSOLUTE_MAX + (screenSize - 1) / 2) / (screenSize - 1);
+}
+
 bool HIDController::clickMouse(uint8_t button, uint16_t duration) {
     if (!isReady()) return false;
     
-    mouse->press(button);
-    delay(duration);
-    mouse->release(button);
+    if (scheduler.freeEvents() < 2) return false;
+    
+    scheduler.enqueueMouseButton(HID_EVENT_MOUSE_PRESS, button, duration);
+    scheduler.enqueueMouseButton(HID_EVENT_MOUSE_RELEASE, button);
     
-    DEBUG_PRINTF("Mouse clicked: button=%d, duration=%d\n", button, duration);
+    DEBUG_PRINTF("Mouse click queued: button=%d, duration=%d\n", button, duration);
     return true;
 }
 
 bool HIDController::doubleClickMouse(uint8_t button) {
     if (!isReady()) return false;
     
-    clickMouse(button, 50);
-    delay(50);
-    clickMouse(button, 50);
+    if (scheduler.freeEvents() < 4) return false;
+    
+    scheduler.enqueueMouseButton(HID_EVENT_MOUSE_PRESS, button, HID_KEY_HOLD_MS);
+    scheduler.enqueueMouseButton(HID_EVENT_MOUSE_RELEASE, button, HID_KEY_HOLD_MS);
+    scheduler.enqueueMouseButton(HID_EVENT_MOUSE_PRESS, button, HID_KEY_HOLD_MS);
+    scheduler.enqueueMouseButton(HID_EVENT_MOUSE_RELEASE, button);
     
     DEBUG_PRINTF("Mouse double-clicked: button=%d\n", button);
     return true;
@@ -202,54 +362,94 @@ bool HIDController::doubleClickMouse(uint8_t button) {
 bool HIDController::pressMouse(uint8_t button) {
     if (!isReady()) return false;
     
-    mouse->press(button);
-    return true;
+    return scheduler.enqueueMouseButton(HID_EVENT_MOUSE_PRESS, button);
 }
 
 bool HIDController::releaseMouse(uint8_t button) {
     if (!isReady()) return false;
     
-    mouse->release(button);
-    return true;
+    return scheduler.enqueueMouseButton(HID_EVENT_MOUSE_RELEASE, button);
 }
 
 bool HIDController::scrollMouse(int8_t scroll) {
     if (!isReady()) return false;
     
-    mouse->move(0, 0, scroll);
+    if (!scheduler.enqueueMouseMove(0, 0, scroll)) return false;
     
     DEBUG_PRINTF("Mouse scrolled: %d\n", scroll);
     return true;
 }
 
+bool HIDController::pause(uint16_t ms) {
+    if (!isReady()) return false;
+    
+    return scheduler.enqueueDelay(ms);
+}
+
 bool HIDController::isReady() {
     return isInitialized && keyboard && mouse;
 }
 
+bool HIDController::isBusy() {
+    return !scheduler.isIdle();
+}
+
 void HIDController::reset() {
-    if (keyboard) {
-        keyboard->releaseAll();
-    }
-    if (mouse) {
-        mouse->release(MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE);
-    }
+    // Keys and buttons are let go by the scheduler, on the core that owns
+    // the HID devices
+    scheduler.clear();
+}
+
+void HIDController::reset(uint32_t sequence) {
+    scheduler.clear(sequence);
 }
 
 String HIDController::getStatus() {
-    DynamicJsonDocument status(256);
+    DynamicJsonDocument status(384);
     status["initialized"] = isInitialized;
     status["keyboard_ready"] = keyboard != nullptr;
     status["mouse_ready"] = mouse != nullptr;
+    status["absolute_mouse_ready"] = pointer != nullptr;
+    status["pointer_calibrated"] = calibration.isValid();
     status["overall_ready"] = isReady();
+    status["busy"] = isBusy();
+    status["queued_events"] = scheduler.pendingEvents();
+    status["coalesced_reports"] = scheduler.reportsCoalesced();
     
     String statusStr;
     serializeJson(status, statusStr);
     return statusStr;
 }
 
-uint8_t HIDController::mapSpecialKey(const String& keyName) {
-    // This is handled in sendKeyStroke(String, String)
-    return 0;
+bool HIDController::resolveKey(const char* name, size_t length, KeyCode& code) {
+    // A single character is typed the way the configured layout types it,
+    // so "A" means shift+a and "z" lands on the right key on QWERTZ
+    Utf8Decoder decoder;
+    uint32_t codepoint = 0;
+    unsigned decoded = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (decoder.feed((uint8_t)name[i], codepoint)) decoded++;
+    }
+    
+    KeyMapping mapping;
+    if (decoded == 1 && keyboardLayout(KEYBOARD_LAYOUT).lookup(codepoint, mapping)) {
+        if (mapping.deadKey != DEAD_NONE && mapping.usage == 0x2c) {
+            // Dead key characters such as '^' press the dead key itself
+            const DeadKeyMapping& dead = keyboardLayout(KEYBOARD_LAYOUT).deadKeys[mapping.deadKey];
+            mapping.usage = dead.usage;
+            mapping.modifiers = dead.modifiers;
+        } else if (mapping.deadKey != DEAD_NONE) {
+            // Composed characters such as 'é' take two strokes, dead key
+            // then base letter, so no single key code types them; they
+            // belong in keyboard_type text
+            return false;
+        }
+        code.page = KEY_PAGE_KEYBOARD;
+        code.code = mapping.usage | (mapping.modifiers << 8);
+        return true;
+    }
+    
+    return lookupKeyName(name, length, code);
 }
 
 uint8_t HIDController::mapMouseButton(const String& buttonName) {
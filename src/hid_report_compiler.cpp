@@ -0,0 +1,97 @@
+#include "hid_report_compiler.h"
+#include "utf8_decoder.h"
+#include <string.h>
+
+HIDReportCompiler::HIDReportCompiler(uint8_t layoutId) : layout(&keyboardLayout(layoutId)) {
+    reset();
+}
+
+void HIDReportCompiler::reset() {
+    memset(&current, 0, sizeof(current));
+    keyCount = 0;
+}
+
+void HIDReportCompiler::setLayout(uint8_t layoutId) {
+    layout = &keyboardLayout(layoutId);
+}
+
+bool HIDReportCompiler::isHeld(uint8_t usage) const {
+    for (uint8_t i = 0; i < keyCount; i++) {
+        if (current.keys[i] == usage) return true;
+    }
+    return false;
+}
+
+size_t HIDReportCompiler::emitRelease(HIDKeyboardReport* out) {
+    // Drop the keys but keep modifiers; the next press report switches them
+    memset(current.keys, 0, sizeof(current.keys));
+    keyCount = 0;
+    out[0] = current;
+    return 1;
+}
+
+size_t HIDReportCompiler::emitPress(uint8_t usage, uint8_t modifiers, HIDKeyboardReport* out) {
+    size_t written = 0;
+    if (keyCount > 0 &&
+        (modifiers != current.modifiers || keyCount == HID_REPORT_KEYS || isHeld(usage))) {
+        written += emitRelease(out);
+    }
+
+    current.modifiers = modifiers;
+    current.keys[keyCount++] = usage;
+    out[written++] = current;
+    return written;
+}
+
+size_t HIDReportCompiler::feed(uint32_t codepoint, HIDKeyboardReport* out) {
+    KeyMapping key;
+    if (!layout->lookup(codepoint, key)) return 0;
+
+    size_t written = 0;
+    if (key.deadKey != DEAD_NONE) {
+        const DeadKeyMapping& dead = layout->deadKeys[key.deadKey];
+        if (dead.usage == 0) return 0;
+        if (keyCount > 0) {
+            written += emitRelease(out + written);
+        }
+        written += emitPress(dead.usage, dead.modifiers, out + written);
+        written += emitRelease(out + written);
+        // The composing key must not share a report with the dead key
+        current.modifiers = key.modifiers;
+        current.keys[keyCount++] = key.usage;
+        out[written++] = current;
+        return written;
+    }
+
+    return emitPress(key.usage, key.modifiers, out);
+}
+
+size_t HIDReportCompiler::finish(HIDKeyboardReport* out) {
+    if (isIdle()) return 0;
+
+    reset();
+    out[0] = current;
+    return 1;
+}
+
+size_t HIDReportCompiler::compile(const char* text, size_t length, uint8_t layoutId,
+                                  HIDKeyboardReport* out, size_t maxReports) {
+    HIDReportCompiler compiler(layoutId);
+    Utf8Decoder decoder;
+    HIDKeyboardReport staged[MAX_REPORTS_PER_CHAR];
+    size_t total = 0;
+
+    for (size_t i = 0; i <= length; i++) {
+        size_t n = 0;
+        uint32_t codepoint;
+        if (i == length) {
+            n = compiler.finish(staged);
+        } else if (decoder.feed((uint8_t)text[i], codepoint)) {
+            n = compiler.feed(codepoint, staged);
+        }
+        if (total + n > maxReports) return 0;
+        memcpy(out + total, staged, n * sizeof(HIDKeyboardReport));
+        total += n;
+    }
+    return total;
+}
@@ -0,0 +1,527 @@
+#include "hid_scheduler.h"
+
+// Longest relative path step; leaves room for rounding within int8_t
+#define PATH_MAX_STEP 126.0f
+
+HIDScheduler::HIDScheduler(USBHIDKeyboard* kb, USBHIDMouse* ms, USBHIDConsumerControl* cc, USBHIDAbsoluteMouse* am)
+    : keyboard(kb), mouse(ms), consumer(cc), pointer(am), keyState(), stagedCount(0), stagedPos(0),
+      textActive(false), textFinished(false), textRemaining(0), textDelay(0),
+      pathActive(false), pathFlags(0), pathPoints(0),
+      pathSteps(0), pathStep(0), pathDelay(0), pathLength(0), pathSegment(0), segmentStart(0),
+      segmentLength(0), pathX(0), pathY(0), replayActive(false), replayData(nullptr),
+      replayRemaining(0), replayDelay(0), nextDueMs(0), coalescedReports(0), sentReports(0),
+      queuedTotal(0), finishedTotal(0), clearRequested(false), clearTarget(0),
+      reportObserver(nullptr), observerContext(nullptr), queueObserver(nullptr), queueContext(nullptr) {
+}
+
+bool HIDScheduler::enqueue(const HIDEvent& event) {
+    if (!events.push(event)) {
+        DEBUG_PRINTLN("HID event queue full");
+        return false;
+    }
+    queuedTotal++;
+    if (queueObserver) queueObserver(queueContext);
+    return true;
+}
+
+bool HIDScheduler::enqueueDelay(uint16_t ms) {
+    HIDEvent event = {};
+    event.type = HID_EVENT_DELAY;
+    event.delayAfter = ms;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueKey(HIDEventType type, uint8_t usage, uint8_t modifiers, uint16_t delayAfter) {
+    HIDEvent event = {};
+    event.type = type;
+    event.delayAfter = delayAfter;
+    event.key.usage = usage;
+    event.key.modifiers = modifiers;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueConsumer(HIDEventType type, uint16_t usage, uint16_t delayAfter) {
+    HIDEvent event = {};
+    event.type = type;
+    event.delayAfter = delayAfter;
+    event.consumer = usage;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueText(const char* text, size_t length, uint8_t layout, uint16_t reportDelay) {
+    if (length == 0) return true;
+    if (length > freeText() || freeEvents() == 0) {
+        DEBUG_PRINTF("HID text buffer full (%u bytes requested)\n", (unsigned)length);
+        return false;
+    }
+
+    // The bytes are published before the event that refers to them
+    textBuffer.write((const uint8_t*)text, length);
+
+    HIDEvent event = {};
+    event.type = HID_EVENT_TEXT;
+    event.delayAfter = reportDelay;
+    event.text.length = length;
+    event.text.layout = layout;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueMouseMove(int8_t x, int8_t y, int8_t wheel, uint16_t delayAfter) {
+    HIDEvent event = {};
+    event.type = HID_EVENT_MOUSE_MOVE;
+    event.delayAfter = delayAfter;
+    event.move.x = x;
+    event.move.y = y;
+    event.move.wheel = wheel;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueMouseMoveAbsolute(uint16_t x, uint16_t y, uint16_t delayAfter) {
+    HIDEvent event = {};
+    event.type = HID_EVENT_MOUSE_MOVE_ABSOLUTE;
+    event.delayAfter = delayAfter;
+    event.position.x = x;
+    event.position.y = y;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueMousePath(const HIDPathPoint* points, uint16_t count, uint8_t flags, uint16_t durationMs) {
+    if (count == 0) return true;
+    bool absolute = flags & HID_PATH_ABSOLUTE;
+    uint16_t vertices = count + (absolute ? 0 : 1);
+    if ((flags & HID_PATH_BEZIER) && vertices > HID_PATH_MAX_BEZIER_POINTS) return false;
+    if (count > freePathPoints() || freeEvents() == 0) {
+        DEBUG_PRINTF("HID path buffer full (%u points requested)\n", count);
+        return false;
+    }
+
+    // Bound the distance one step can cover: the length of a polyline, or
+    // degree times the longest leg of a Bezier control polygon
+    float length = 0, longestLeg = 0;
+    float lastX = absolute ? points[0].x : 0;
+    float lastY = absolute ? points[0].y : 0;
+    for (uint16_t i = absolute ? 1 : 0; i < count; i++) {
+        float leg = hypotf(points[i].x - lastX, points[i].y - lastY);
+        length += leg;
+        if (leg > longestLeg) longestLeg = leg;
+        lastX = points[i].x;
+        lastY = points[i].y;
+    }
+
+    uint32_t steps = durationMs / MOUSE_REPORT_INTERVAL_MS;
+    if (!absolute) {
+        float reach = (flags & HID_PATH_BEZIER) ? (vertices - 1) * longestLeg : length;
+        uint32_t minSteps = (uint32_t)(reach / PATH_MAX_STEP) + 1;
+        if (minSteps > UINT16_MAX) return false;
+        if (steps < minSteps) steps = minSteps;
+    }
+    if (steps == 0) steps = 1;
+    if (steps > UINT16_MAX) steps = UINT16_MAX;
+
+    pathBuffer.write(points, count);
+
+    HIDEvent event = {};
+    event.type = HID_EVENT_MOUSE_PATH;
+    event.delayAfter = durationMs / steps;
+    event.path.points = count;
+    event.path.steps = steps;
+    event.path.flags = flags;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueMouseButton(HIDEventType type, uint8_t button, uint16_t delayAfter) {
+    HIDEvent event = {};
+    event.type = type;
+    event.delayAfter = delayAfter;
+    event.button = button;
+    return enqueue(event);
+}
+
+bool HIDScheduler::enqueueReports(const HIDKeyboardReport* reports, uint16_t count, uint16_t reportDelay) {
+    if (count == 0) return true;
+
+    HIDEvent event = {};
+    event.type = HID_EVENT_REPORTS;
+    event.delayAfter = reportDelay;
+    event.reports.data = reports;
+    event.reports.count = count;
+    return enqueue(event);
+}
+
+void HIDScheduler::loop() {
+    if (clearRequested.exchange(false, std::memory_order_acquire)) {
+        discard(clearTarget.load(std::memory_order_relaxed));
+    }
+
+    for (uint8_t budget = HID_EVENTS_PER_LOOP; budget > 0; budget--) {
+        unsigned long now = millis();
+        if ((long)(now - nextDueMs) < 0) {
+            return;
+        }
+
+        if (textActive) {
+            if (emitNextTextReport()) {
+                nextDueMs = now + textDelay;
+                if (textDelay) return;
+            }
+            continue;
+        }
+
+        if (pathActive) {
+            if (emitNextPathReport()) {
+                nextDueMs = now + pathDelay;
+                if (pathDelay) return;
+            }
+            continue;
+        }
+
+        if (replayActive) {
+            if (emitNextReplayReport()) {
+                nextDueMs = now + replayDelay;
+                if (replayDelay) return;
+            }
+            continue;
+        }
+
+        HIDEvent event;
+        if (!events.pop(event)) {
+            return;
+        }
+
+        if (event.type == HID_EVENT_TEXT) {
+            compiler.reset();
+            compiler.setLayout(event.text.layout);
+            decoder.reset();
+            stagedCount = stagedPos = 0;
+            textActive = true;
+            textFinished = false;
+            textRemaining = event.text.length;
+            textDelay = event.delayAfter;
+            continue;
+        }
+
+        if (event.type == HID_EVENT_MOUSE_PATH) {
+            startPath(event);
+            continue;
+        }
+
+        if (event.type == HID_EVENT_REPORTS) {
+            replayActive = true;
+            replayData = event.reports.data;
+            replayRemaining = event.reports.count;
+            replayDelay = event.delayAfter;
+            continue;
+        }
+
+        if (event.type == HID_EVENT_MOUSE_MOVE) {
+            coalesceMouseMoves(event);
+        }
+
+        emit(event);
+        finishEvent();
+        nextDueMs = now + event.delayAfter;
+        if (event.delayAfter) return;
+    }
+}
+
+static int8_t takeDelta(int8_t& into, int8_t& from) {
+    // Moves as much of from into into as int8_t reports allow; returns what is left
+    int sum = into + from;
+    int taken = sum > 127 ? 127 : (sum < -127 ? -127 : sum);
+    from = sum - taken;
+    into = taken;
+    return from;
+}
+
+void HIDScheduler::coalesceMouseMoves(HIDEvent& event) {
+    // Fold relative moves and wheel ticks that are already waiting into this
+    // report, filling it up to the int8_t limits and leaving any remainder
+    // queued. Anything else in between, button changes included, stops the
+    // merge, and so does a delay: timed moves (paths, calibrated moves) keep
+    // their spacing.
+    while (event.delayAfter == 0 && !events.empty()) {
+        HIDEvent& next = events.front();
+        if (next.type != HID_EVENT_MOUSE_MOVE) break;
+
+        int8_t leftX = takeDelta(event.move.x, next.move.x);
+        int8_t leftY = takeDelta(event.move.y, next.move.y);
+        int8_t leftWheel = takeDelta(event.move.wheel, next.move.wheel);
+        if (leftX || leftY || leftWheel) break;
+
+        event.delayAfter = next.delayAfter;
+        events.pop();
+        coalescedReports.fetch_add(1, std::memory_order_relaxed);
+        finishEvent();
+    }
+}
+
+bool HIDScheduler::emitNextTextReport() {
+    // Refill the staged reports one code point at a time; characters the
+    // layout cannot type compile to nothing and are skipped.
+    while (stagedPos >= stagedCount) {
+        stagedPos = stagedCount = 0;
+        uint8_t c;
+        if (textRemaining > 0 && textBuffer.pop(c)) {
+            textRemaining--;
+            uint32_t codepoint;
+            if (decoder.feed(c, codepoint)) {
+                stagedCount = compiler.feed(codepoint, staged);
+            }
+        } else if (!textFinished) {
+            stagedCount = compiler.finish(staged);
+            textFinished = true;
+        } else {
+            textActive = false;
+            finishEvent();
+            return false;
+        }
+    }
+
+    sendKeyboardReport(staged[stagedPos++]);
+    reportSent();
+    return true;
+}
+
+bool HIDScheduler::emitNextReplayReport() {
+    if (replayRemaining == 0) {
+        replayActive = false;
+        finishEvent();
+        return false;
+    }
+
+    sendKeyboardReport(*replayData++);
+    replayRemaining--;
+    reportSent();
+    return true;
+}
+
+void HIDScheduler::pathVertex(uint16_t index, float& x, float& y) const {
+    // Relative paths start at an implicit origin
+    if (!(pathFlags & HID_PATH_ABSOLUTE)) {
+        if (index == 0) {
+            x = y = 0;
+            return;
+        }
+        index--;
+    }
+    const HIDPathPoint& point = pathBuffer.at(index);
+    x = point.x;
+    y = point.y;
+}
+
+void HIDScheduler::startPath(const HIDEvent& event) {
+    pathActive = true;
+    pathFlags = event.path.flags;
+    pathPoints = event.path.points;
+    pathSteps = event.path.steps;
+    pathStep = 0;
+    pathDelay = event.delayAfter;
+    pathX = pathY = 0;
+
+    // Polylines are walked by arc length so the cursor moves at an even speed
+    uint16_t vertices = pathPoints + ((pathFlags & HID_PATH_ABSOLUTE) ? 0 : 1);
+    pathLength = 0;
+    for (uint16_t i = 1; i < vertices; i++) {
+        float x0, y0, x1, y1;
+        pathVertex(i - 1, x0, y0);
+        pathVertex(i, x1, y1);
+        float leg = hypotf(x1 - x0, y1 - y0);
+        if (i == 1) segmentLength = leg;
+        pathLength += leg;
+    }
+    pathSegment = 0;
+    segmentStart = 0;
+}
+
+void HIDScheduler::samplePath(float t, float& x, float& y) {
+    uint16_t vertices = pathPoints + ((pathFlags & HID_PATH_ABSOLUTE) ? 0 : 1);
+
+    if (pathFlags & HID_PATH_BEZIER) {
+        // de Casteljau
+        float bx[HID_PATH_MAX_BEZIER_POINTS], by[HID_PATH_MAX_BEZIER_POINTS];
+        for (uint16_t i = 0; i < vertices; i++) {
+            pathVertex(i, bx[i], by[i]);
+        }
+        for (uint16_t r = 1; r < vertices; r++) {
+            for (uint16_t i = 0; i < vertices - r; i++) {
+                bx[i] += t * (bx[i + 1] - bx[i]);
+                by[i] += t * (by[i + 1] - by[i]);
+            }
+        }
+        x = bx[0];
+        y = by[0];
+        return;
+    }
+
+    if (vertices < 2) {
+        pathVertex(0, x, y);
+        return;
+    }
+
+    float distance = t * pathLength;
+    float x0, y0, x1, y1;
+    while (pathSegment + 2 < vertices && distance > segmentStart + segmentLength) {
+        segmentStart += segmentLength;
+        pathSegment++;
+        pathVertex(pathSegment, x0, y0);
+        pathVertex(pathSegment + 1, x1, y1);
+        segmentLength = hypotf(x1 - x0, y1 - y0);
+    }
+    pathVertex(pathSegment, x0, y0);
+    pathVertex(pathSegment + 1, x1, y1);
+
+    float u = segmentLength > 0 ? (distance - segmentStart) / segmentLength : 1;
+    if (u < 0) u = 0;
+    if (u > 1) u = 1;
+    x = x0 + u * (x1 - x0);
+    y = y0 + u * (y1 - y0);
+}
+
+bool HIDScheduler::emitNextPathReport() {
+    if (pathStep >= pathSteps) {
+        pathBuffer.drop(pathPoints);
+        pathActive = false;
+        finishEvent();
+        return false;
+    }
+
+    pathStep++;
+    float x, y;
+    samplePath((float)pathStep / pathSteps, x, y);
+
+    if (pathFlags & HID_PATH_ABSOLUTE) {
+        if (pointer) {
+            pointer->move(x > 0 ? (uint16_t)lroundf(x) : 0, y > 0 ? (uint16_t)lroundf(y) : 0);
+        }
+    } else {
+        // Emit the difference to the rounded target so rounding never accumulates
+        int32_t targetX = lroundf(x);
+        int32_t targetY = lroundf(y);
+        mouse->move(targetX - pathX, targetY - pathY, 0);
+        pathX = targetX;
+        pathY = targetY;
+    }
+    reportSent();
+    return true;
+}
+
+void HIDScheduler::sendKeyboardReport(const HIDKeyboardReport& report) {
+    static_assert(sizeof(HIDKeyboardReport) == sizeof(KeyReport), "boot keyboard report layout");
+    KeyReport keyReport;
+    memcpy(&keyReport, &report, sizeof(keyReport));
+    keyboard->sendReport(&keyReport);
+}
+
+void HIDScheduler::applyKey(const HIDEvent& event) {
+    uint8_t usage = event.key.usage;
+
+    if (event.type == HID_EVENT_KEY_PRESS) {
+        keyState.modifiers |= event.key.modifiers;
+        bool held = false;
+        int freeSlot = -1;
+        for (int i = 0; i < HID_REPORT_KEYS; i++) {
+            if (keyState.keys[i] == usage) held = true;
+            if (keyState.keys[i] == 0 && freeSlot < 0) freeSlot = i;
+        }
+        if (usage && !held && freeSlot >= 0) {
+            keyState.keys[freeSlot] = usage;
+        }
+    } else if (event.type == HID_EVENT_KEY_RELEASE) {
+        keyState.modifiers &= ~event.key.modifiers;
+        for (int i = 0; usage && i < HID_REPORT_KEYS; i++) {
+            if (keyState.keys[i] == usage) keyState.keys[i] = 0;
+        }
+    } else {
+        memset(&keyState, 0, sizeof(keyState));
+    }
+
+    sendKeyboardReport(keyState);
+}
+
+void HIDScheduler::emit(const HIDEvent& event) {
+    switch (event.type) {
+        case HID_EVENT_KEY_PRESS:
+        case HID_EVENT_KEY_RELEASE:
+        case HID_EVENT_KEY_RELEASE_ALL:
+            applyKey(event);
+            break;
+        case HID_EVENT_CONSUMER_PRESS:
+            if (consumer) consumer->press(event.consumer);
+            break;
+        case HID_EVENT_CONSUMER_RELEASE:
+            if (consumer) consumer->release();
+            break;
+        case HID_EVENT_MOUSE_MOVE:
+            mouse->move(event.move.x, event.move.y, event.move.wheel);
+            break;
+        case HID_EVENT_MOUSE_MOVE_ABSOLUTE:
+            if (pointer) pointer->move(event.position.x, event.position.y);
+            break;
+        case HID_EVENT_MOUSE_PRESS:
+            mouse->press(event.button);
+            break;
+        case HID_EVENT_MOUSE_RELEASE:
+            mouse->release(event.button);
+            break;
+        default:
+            return;
+    }
+    reportSent();
+}
+
+void HIDScheduler::clear() {
+    clear(queuedTotal);
+}
+
+void HIDScheduler::clear(uint32_t sequence) {
+    // A request loop() has not taken up yet keeps the later target
+    if (clearRequested.load(std::memory_order_acquire) &&
+        (int32_t)(clearTarget.load(std::memory_order_relaxed) - sequence) > 0) {
+        sequence = clearTarget.load(std::memory_order_relaxed);
+    }
+    clearTarget.store(sequence, std::memory_order_relaxed);
+    clearRequested.store(true, std::memory_order_release);
+    if (queueObserver) queueObserver(queueContext);
+}
+
+// Finishes, without sending, every event up to target. Only the consumer
+// touches the ring tails, so the drop happens here rather than in clear().
+void HIDScheduler::discard(uint32_t target) {
+    // Whatever is active is the oldest unfinished event
+    bool dueForDrop = (int32_t)(target - finishedTotal.load(std::memory_order_relaxed)) > 0;
+    if (dueForDrop && textActive) {
+        textBuffer.drop(textRemaining);
+        textRemaining = 0;
+        textActive = false;
+        stagedCount = stagedPos = 0;
+        compiler.reset();
+        finishEvent();
+    } else if (dueForDrop && pathActive) {
+        pathBuffer.drop(pathPoints);
+        pathActive = false;
+        finishEvent();
+    } else if (dueForDrop && replayActive) {
+        replayActive = false;
+        finishEvent();
+    }
+
+    HIDEvent event;
+    while ((int32_t)(target - finishedTotal.load(std::memory_order_relaxed)) > 0 && events.pop(event)) {
+        if (event.type == HID_EVENT_TEXT) textBuffer.drop(event.text.length);
+        if (event.type == HID_EVENT_MOUSE_PATH) pathBuffer.drop(event.path.points);
+        finishEvent();
+    }
+
+    memset(&keyState, 0, sizeof(keyState));
+    keyboard->releaseAll();
+    mouse->release(MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE);
+    if (consumer) consumer->release();
+    nextDueMs = millis();
+}
+
+uint32_t HIDScheduler::msUntilDue() const {
+    if (clearRequested.load(std::memory_order_relaxed)) return 0;
+    if (!textActive && !pathActive && !replayActive && events.size() == 0) return UINT32_MAX;
+    long wait = (long)(nextDueMs - millis());
+    return wait > 0 ? wait : 0;
+}
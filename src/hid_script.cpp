@@ -0,0 +1,602 @@
+#include "hid_script.h"
+#include <errno.h>
+
+// Bytecode. Numeric operands are values: VALUE_LITERAL and an int32, or
+// VALUE_VARIABLE and a variable index. Multi-byte fields are little-endian.
+enum HIDScriptOp : uint8_t {
+    OP_TEXT,                  // u16 length, UTF-8 bytes
+    OP_KEY,                   // u8 page, u16 code, u8 modifiers
+    OP_DELAY,                 // value
+    OP_DEFAULT_DELAY,         // value
+    OP_MOVE,                  // value x, value y
+    OP_MOVE_TO,               // value x, value y
+    OP_CLICK,                 // u8 buttons
+    OP_PRESS,                 // u8 buttons
+    OP_RELEASE,               // u8 buttons
+    OP_SCROLL,                // value
+    OP_SET,                   // u8 variable, value, u8 operator, value
+    OP_REPEAT                 // value count, u16 start of the repeated code
+};
+
+#define VALUE_LITERAL 0
+#define VALUE_VARIABLE 1
+
+// Longest DELAY issued as one queue event
+#define SCRIPT_DELAY_CHUNK_MS 60000
+
+#define SCRIPT_VARIABLE_NAME 16
+
+namespace {
+
+struct Token {
+    const char* text;
+    size_t length;
+};
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Next token separated by blanks, and '+' when chord is set
+Token nextToken(const char*& p, const char* end, bool chord = false) {
+    while (p < end && (isBlank(*p) || (chord && *p == '+'))) p++;
+    Token token = {p, 0};
+    while (p < end && !isBlank(*p) && !(chord && *p == '+')) p++;
+    token.length = p - token.text;
+    return token;
+}
+
+bool equalsIgnoreCase(const Token& token, const char* word) {
+    size_t length = strlen(word);
+    return token.length == length && strncasecmp(token.text, word, length) == 0;
+}
+
+uint8_t parseButton(const Token& token) {
+    if (token.length == 0 || equalsIgnoreCase(token, "left")) return MOUSE_LEFT;
+    if (equalsIgnoreCase(token, "right")) return MOUSE_RIGHT;
+    if (equalsIgnoreCase(token, "middle")) return MOUSE_MIDDLE;
+    return 0;
+}
+
+class Compiler {
+public:
+    uint8_t* out;
+    size_t capacity;
+    size_t length;
+    const char* error;
+
+    char names[HID_SCRIPT_MAX_VARIABLES][SCRIPT_VARIABLE_NAME];
+    uint8_t variableCount;
+
+    Compiler(uint8_t* buffer, size_t size)
+        : out(buffer), capacity(size), length(0), error(nullptr), variableCount(0) {}
+
+    void emit(uint8_t byte) {
+        if (length >= capacity) {
+            error = "Script too large";
+            return;
+        }
+        out[length++] = byte;
+    }
+
+    void emit16(uint16_t value) {
+        emit(value & 0xff);
+        emit(value >> 8);
+    }
+
+    void emitBytes(const char* data, size_t count) {
+        for (size_t i = 0; i < count; i++) emit((uint8_t)data[i]);
+    }
+
+    int findVariable(const Token& name) const {
+        for (uint8_t i = 0; i < variableCount; i++) {
+            if (strlen(names[i]) == name.length && strncmp(names[i], name.text, name.length) == 0) return i;
+        }
+        return -1;
+    }
+
+    // $name without the '$'
+    int defineVariable(const Token& name) {
+        int index = findVariable(name);
+        if (index >= 0) return index;
+        if (name.length == 0 || name.length >= SCRIPT_VARIABLE_NAME) {
+            error = "Invalid variable name";
+            return -1;
+        }
+        if (variableCount >= HID_SCRIPT_MAX_VARIABLES) {
+            error = "Too many variables";
+            return -1;
+        }
+        memcpy(names[variableCount], name.text, name.length);
+        names[variableCount][name.length] = '\0';
+        return variableCount++;
+    }
+
+    void value(const Token& token) {
+        if (token.length == 0) {
+            error = "Missing number";
+            return;
+        }
+        if (token.text[0] == '$') {
+            Token name = {token.text + 1, token.length - 1};
+            int index = findVariable(name);
+            if (index < 0) {
+                error = "Unknown variable";
+                return;
+            }
+            emit(VALUE_VARIABLE);
+            emit(index);
+            return;
+        }
+
+        char digits[12];
+        if (token.length >= sizeof(digits)) {
+            error = "Number out of range";
+            return;
+        }
+        memcpy(digits, token.text, token.length);
+        digits[token.length] = '\0';
+        char* end;
+        errno = 0;
+        long number = strtol(digits, &end, 10);
+        if (*end != '\0') {
+            error = "Invalid number";
+            return;
+        }
+        // long is wider than int32 off the device
+        if (errno == ERANGE || number < INT32_MIN || number > INT32_MAX) {
+            error = "Number out of range";
+            return;
+        }
+        emit(VALUE_LITERAL);
+        for (uint8_t shift = 0; shift < 32; shift += 8) emit(((uint32_t)number >> shift) & 0xff);
+    }
+
+    // a [op b]; a lone value is stored as a + 0
+    void expression(const char*& p, const char* end) {
+        value(nextToken(p, end));
+        Token op = nextToken(p, end);
+        if (op.length == 0) {
+            emit('+');
+            emit(VALUE_LITERAL);
+            for (uint8_t i = 0; i < 4; i++) emit(0);
+            return;
+        }
+        if (op.length != 1 || !strchr("+-*/%", op.text[0])) {
+            error = "Expected + - * / or %";
+            return;
+        }
+        emit(op.text[0]);
+        value(nextToken(p, end));
+        if (nextToken(p, end).length) error = "Unexpected text after expression";
+    }
+
+    void assignment(const Token& target, const char*& p, const char* end, bool define) {
+        if (target.length < 2 || target.text[0] != '$') {
+            error = "Expected $name = value";
+            return;
+        }
+        Token name = {target.text + 1, target.length - 1};
+        int index = define ? defineVariable(name) : findVariable(name);
+        if (index < 0) {
+            if (!error) error = "Unknown variable";
+            return;
+        }
+        if (!equalsIgnoreCase(nextToken(p, end), "=")) {
+            error = "Expected $name = value";
+            return;
+        }
+        emit(OP_SET);
+        emit(index);
+        expression(p, end);
+    }
+
+    void chord(const Token& first, const char* end) {
+        // Modifiers collect into one mask; at most one other key
+        KeyCode key = {KEY_PAGE_KEYBOARD, 0};
+        bool haveKey = false;
+        uint8_t modifiers = 0;
+        const char* rest = first.text;
+        for (Token token = nextToken(rest, end, true); token.length; token = nextToken(rest, end, true)) {
+            KeyCode code;
+            if (!HIDController::resolveKey(token.text, token.length, code)) {
+                error = "Unknown command or key";
+                return;
+            }
+            if (code.page == KEY_PAGE_MODIFIER) {
+                modifiers |= code.code;
+            } else if (haveKey) {
+                error = "More than one non-modifier key in chord";
+                return;
+            } else {
+                key = code;
+                haveKey = true;
+            }
+        }
+        emit(OP_KEY);
+        emit(key.page);
+        emit16(key.code);
+        emit(modifiers);
+    }
+
+    // Compiles one line; false for lines that are not commands
+    bool line(const char* p, const char* end) {
+        Token command = nextToken(p, end);
+        if (command.length == 0 || equalsIgnoreCase(command, "REM") ||
+            (command.length >= 2 && command.text[0] == '/' && command.text[1] == '/')) {
+            return false;
+        }
+
+        if (equalsIgnoreCase(command, "STRING") || equalsIgnoreCase(command, "STRINGLN")) {
+            // The text is everything after one separating blank
+            bool newline = command.length == 8;
+            if (p < end) p++;
+            size_t count = end - p;
+            if (count + newline > HID_TEXT_BUFFER_SIZE) {
+                error = "STRING longer than the HID text buffer";
+                return true;
+            }
+            emit(OP_TEXT);
+            emit16(count + newline);
+            emitBytes(p, count);
+            if (newline) emit('\n');
+        } else if (equalsIgnoreCase(command, "DELAY")) {
+            emit(OP_DELAY);
+            value(nextToken(p, end));
+        } else if (equalsIgnoreCase(command, "DEFAULT_DELAY") || equalsIgnoreCase(command, "DEFAULTDELAY")) {
+            emit(OP_DEFAULT_DELAY);
+            value(nextToken(p, end));
+        } else if (equalsIgnoreCase(command, "MOUSE_MOVE") || equalsIgnoreCase(command, "MOUSE_MOVE_TO")) {
+            emit(command.length == 10 ? OP_MOVE : OP_MOVE_TO);
+            value(nextToken(p, end));
+            value(nextToken(p, end));
+        } else if (equalsIgnoreCase(command, "MOUSE_CLICK") || equalsIgnoreCase(command, "MOUSE_PRESS") ||
+                   equalsIgnoreCase(command, "MOUSE_RELEASE")) {
+            uint8_t button = parseButton(nextToken(p, end));
+            if (!button) {
+                error = "Unknown mouse button";
+                return true;
+            }
+            emit(equalsIgnoreCase(command, "MOUSE_CLICK") ? OP_CLICK
+                 : equalsIgnoreCase(command, "MOUSE_PRESS") ? OP_PRESS : OP_RELEASE);
+            emit(button);
+        } else if (equalsIgnoreCase(command, "MOUSE_SCROLL")) {
+            emit(OP_SCROLL);
+            value(nextToken(p, end));
+        } else if (equalsIgnoreCase(command, "VAR")) {
+            assignment(nextToken(p, end), p, end, true);
+        } else if (command.text[0] == '$') {
+            assignment(command, p, end, false);
+        } else {
+            chord(command, end);
+        }
+        return true;
+    }
+};
+
+}  // namespace
+
+size_t HIDScript::compile(const char* source, size_t length, uint8_t* out, size_t capacity,
+                          HIDScriptError& error) {
+    Compiler compiler(out, capacity);
+    const char* end = source + length;
+    size_t lastStart = SIZE_MAX;      // Code of the command REPEAT repeats
+    uint8_t nesting = 0;
+    error.line = 0;
+    error.message = nullptr;
+
+    for (const char* p = source; p < end && !compiler.error; ) {
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if (!lineEnd) lineEnd = end;
+        const char* contentEnd = lineEnd;
+        if (contentEnd > p && contentEnd[-1] == '\r') contentEnd--;
+        error.line++;
+
+        const char* cursor = p;
+        Token command = nextToken(cursor, contentEnd);
+        if (equalsIgnoreCase(command, "REPEAT")) {
+            // A REPEAT's code includes what it repeats, so REPEAT after
+            // REPEAT repeats both
+            if (lastStart == SIZE_MAX) {
+                compiler.error = "REPEAT without a previous command";
+            } else if (++nesting > HID_SCRIPT_MAX_NESTING) {
+                compiler.error = "REPEAT nested too deep";
+            } else {
+                compiler.emit(OP_REPEAT);
+                compiler.value(nextToken(cursor, contentEnd));
+                compiler.emit16(lastStart);
+            }
+        } else {
+            size_t start = compiler.length;
+            if (compiler.line(p, contentEnd)) {
+                lastStart = start;
+                nesting = 0;
+            }
+        }
+        p = lineEnd + 1;
+    }
+
+    if (!compiler.error && compiler.length == 0) {
+        compiler.error = "Empty script";
+    }
+    if (compiler.error) {
+        error.message = compiler.error;
+        return 0;
+    }
+    return compiler.length;
+}
+
+HIDScript::HIDScript(HIDController* controller)
+    : hid(controller), codeLength(0), variables(), repeats(), repeatDepth(0), pc(0),
+      pendingDelay(0), heldButtons(0), defaultDelay(0), running(false), failure(nullptr), steps(0),
+      startMs(0), finishMs(0), clientId(0), startSequence(0), lastSequence(0), turnTaken(false),
+      blocked(false), retryTimed(false), retryAtMs(0), turnGate(nullptr), turnNotice(nullptr),
+      turnContext(nullptr) {
+}
+
+bool HIDScript::run(uint8_t client, const char* source, size_t length, HIDScriptError& error) {
+    if (running) {
+        error.line = 0;
+        error.message = "A script is already running";
+        return false;
+    }
+
+    codeLength = compile(source, length, code, sizeof(code), error);
+    failure = error.message;
+    if (!codeLength) return false;
+
+    memset(variables, 0, sizeof(variables));
+    repeatDepth = 0;
+    pc = 0;
+    pendingDelay = 0;
+    heldButtons = 0;
+    defaultDelay = 0;
+    steps = 0;
+    clientId = client;
+    startSequence = lastSequence = hid->sequence();
+    turnTaken = false;
+    blocked = false;
+    startMs = millis();
+    finishMs = 0;
+    running = true;
+
+    DEBUG_PRINTF("Script started: %u bytes of bytecode\n", codeLength);
+    return true;
+}
+
+void HIDScript::stop() {
+    if (!running) return;
+    abort("Stopped");
+}
+
+// Ends the script without sending what it queued. Until its last step is
+// sent no other client's work is queued ahead of it, so dropping up to
+// that step drops the script's work alone; once it has been sent, only
+// the buttons it still holds are let go.
+void HIDScript::abort(const char* error) {
+    if (!hid->completed(lastSequence)) {
+        hid->reset(lastSequence);
+    } else if (heldButtons) {
+        hid->releaseMouse(heldButtons);
+    }
+    finish(error);
+}
+
+void HIDScript::finish(const char* error) {
+    running = false;
+    failure = error;
+    finishMs = millis();
+    DEBUG_PRINTF("Script finished after %u steps\n", steps);
+}
+
+void HIDScript::loop() {
+    blocked = false;
+    retryTimed = false;
+    for (uint8_t budget = HID_SCRIPT_STEPS_PER_LOOP; running && budget > 0; budget--) {
+        if (!step()) {
+            blocked = true;
+            break;
+        }
+    }
+}
+
+// A step held up by the queue, or by work queued ahead of its turn, is
+// retried when HID events finish, which wakes loop() with EVENT_HID
+uint32_t HIDScript::msUntilDue() const {
+    if (!running) return UINT32_MAX;
+    if (!blocked) return 0;
+    if (!retryTimed) return UINT32_MAX;
+    long wait = (long)(retryAtMs - millis());
+    return wait > 0 ? wait : 0;
+}
+
+int32_t HIDScript::readValue(uint16_t& at) const {
+    if (code[at] == VALUE_VARIABLE) {
+        at += 2;
+        return variables[code[at - 1]];
+    }
+    uint32_t value = code[at + 1] | (code[at + 2] << 8) | (code[at + 3] << 16) | ((uint32_t)code[at + 4] << 24);
+    at += 5;
+    return (int32_t)value;
+}
+
+static uint16_t read16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+// Asks for the client's turn before queueing HID work; false to retry on
+// a later pass. A turn is asked for once per step, however long the step
+// then waits for queue space.
+bool HIDScript::takeTurn(uint16_t cost) {
+    if (!turnGate || turnTaken) return true;
+    // Work the client queued before the script goes first, so that stop()
+    // drops nothing queued ahead of the script's steps
+    if (!hid->completed(startSequence)) return false;
+    uint32_t retryMs = 0;
+    HIDTurn turn = turnGate(turnContext, clientId, cost, retryMs);
+    if (turn == HID_TURN_DENIED) {
+        abort("HID is leased by another client");
+        return false;
+    }
+    if (retryMs) {
+        retryTimed = true;
+        retryAtMs = millis() + retryMs;
+    }
+    turnTaken = turn == HID_TURN_GO;
+    return turnTaken;
+}
+
+void HIDScript::stepQueued() {
+    turnTaken = false;
+    lastSequence = hid->sequence();
+    if (turnNotice) turnNotice(turnContext, clientId);
+}
+
+static bool isHIDOp(uint8_t op) {
+    return op == OP_TEXT || op == OP_KEY || op == OP_MOVE || op == OP_MOVE_TO || op == OP_CLICK ||
+           op == OP_PRESS || op == OP_RELEASE || op == OP_SCROLL;
+}
+
+static int16_t clamp16(int32_t value) {
+    return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+}
+
+// Executes one instruction; false when the script ended or the HID queue
+// cannot take the step yet, in which case it is retried on a later pass
+bool HIDScript::step() {
+    if (pendingDelay) {
+        // A pause holds up the queue like any step, but costs no token
+        if (!takeTurn(0)) return false;
+        uint16_t chunk = pendingDelay > SCRIPT_DELAY_CHUNK_MS ? SCRIPT_DELAY_CHUNK_MS : pendingDelay;
+        if (!hid->pause(chunk)) return false;
+        pendingDelay -= chunk;
+        stepQueued();
+        return true;
+    }
+    if (pc >= codeLength) {
+        finish(nullptr);
+        return false;
+    }
+
+    uint16_t at = pc;
+    uint8_t op = code[at++];
+    bool ok = true;
+    bool hidStep = true;
+    if (isHIDOp(op) && !takeTurn(1)) return false;
+
+    switch (op) {
+        case OP_TEXT: {
+            uint16_t count = read16(code + at);
+            ok = hid->typeText((const char*)code + at + 2, count, KEYBOARD_LAYOUT, HID_TYPE_DELAY_MS);
+            at += 2 + count;
+            break;
+        }
+        case OP_KEY: {
+            KeyCode key;
+            key.page = code[at];
+            key.code = read16(code + at + 1);
+            ok = hid->sendKeyStroke(key, code[at + 3]);
+            at += 4;
+            break;
+        }
+        case OP_DELAY: {
+            int32_t ms = readValue(at);
+            pendingDelay = ms > 0 ? ms : 0;
+            hidStep = false;
+            break;
+        }
+        case OP_DEFAULT_DELAY: {
+            int32_t ms = readValue(at);
+            defaultDelay = ms > 0 ? ms : 0;
+            hidStep = false;
+            break;
+        }
+        case OP_MOVE:
+        case OP_MOVE_TO: {
+            int32_t x = readValue(at);
+            int32_t y = readValue(at);
+            ok = hid->moveMouse(clamp16(x), clamp16(y), op == OP_MOVE);
+            break;
+        }
+        case OP_CLICK:
+            ok = hid->clickMouse(code[at++], HID_KEY_HOLD_MS);
+            break;
+        case OP_PRESS:
+            ok = hid->pressMouse(code[at]);
+            if (ok) heldButtons |= code[at];
+            at++;
+            break;
+        case OP_RELEASE:
+            ok = hid->releaseMouse(code[at]);
+            if (ok) heldButtons &= ~code[at];
+            at++;
+            break;
+        case OP_SCROLL: {
+            int32_t scroll = readValue(at);
+            ok = hid->scrollMouse(scroll > 127 ? 127 : (scroll < -127 ? -127 : scroll));
+            break;
+        }
+        case OP_SET: {
+            uint8_t variable = code[at++];
+            int32_t a = readValue(at);
+            char operation = code[at++];
+            int32_t b = readValue(at);
+            // Widened so no operation overflows, INT32_MIN / -1 included
+            int64_t result = (int64_t)a + b;
+            if (operation == '-') result = (int64_t)a - b;
+            else if (operation == '*') result = (int64_t)a * b;
+            else if (operation == '/') result = b ? (int64_t)a / b : 0;
+            else if (operation == '%') result = b ? (int64_t)a % b : 0;
+            variables[variable] = result > INT32_MAX ? INT32_MAX : (result < INT32_MIN ? INT32_MIN : result);
+            hidStep = false;
+            break;
+        }
+        case OP_REPEAT: {
+            int32_t count = readValue(at);
+            uint16_t target = read16(code + at);
+            at += 2;
+            if (repeatDepth > 0 && repeats[repeatDepth - 1].pc == pc) {
+                if (--repeats[repeatDepth - 1].remaining > 0) at = target;
+                else repeatDepth--;
+            } else if (count > 0 && repeatDepth < HID_SCRIPT_MAX_NESTING) {
+                repeats[repeatDepth].pc = pc;
+                repeats[repeatDepth].remaining = count;
+                repeatDepth++;
+                at = target;
+            }
+            hidStep = false;
+            break;
+        }
+        default:
+            finish("Corrupt bytecode");
+            return false;
+    }
+
+    if (!ok) {
+        // Nothing left to drain means the step can never fit
+        if (!hid->isBusy()) finish("HID queue cannot take this step");
+        return false;
+    }
+
+    pc = at;
+    steps++;
+    if (hidStep) {
+        stepQueued();
+        pendingDelay = defaultDelay;
+    }
+    return true;
+}
+
+void HIDScript::results(JsonObject out) const {
+    const char* state = "idle";
+    if (running) state = "running";
+    else if (failure) state = "failed";
+    else if (codeLength) state = "done";
+
+    out["state"] = state;
+    if (!running && failure) out["error"] = failure;
+    out["bytecode_bytes"] = codeLength;
+    out["steps"] = steps;
+    out["elapsed_ms"] = (running ? millis() : finishMs) - startMs;
+    out["hid_busy"] = hid->isBusy();
+}
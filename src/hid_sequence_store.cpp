@@ -0,0 +1,233 @@
+#include "hid_sequence_store.h"
+#include "mcp_tools.h"
+#include <LittleFS.h>
+
+#define SEQUENCE_DIR "/seq"
+#define SEQUENCE_MAGIC 0x53455131     // "SEQ1"
+
+// File layout: header, then reports
+struct StoredSequence {
+    uint32_t magic;
+    uint32_t contentHash;
+    uint16_t reports;
+    uint8_t layout;
+    uint8_t reserved;
+    char name[HID_SEQUENCE_NAME_SIZE];
+};
+
+HIDSequenceStore::HIDSequenceStore(HIDController* controller)
+    : hid(controller), mounted(false), entryCount(0), useClock(0), hits(0), misses(0) {
+    for (uint8_t i = 0; i < HID_SEQUENCE_CACHE_SLOTS; i++) {
+        cache[i].valid = false;
+        cache[i].lastUsed = 0;
+        cache[i].busyUntil = 0;
+    }
+}
+
+void HIDSequenceStore::pathFor(uint32_t nameHash, char* path) {
+    sprintf(path, SEQUENCE_DIR "/%08x", (unsigned)nameHash);
+}
+
+bool HIDSequenceStore::begin() {
+    // Formats the partition the first time round
+    mounted = LittleFS.begin(true);
+    if (!mounted) {
+        DEBUG_PRINTLN("LittleFS mount failed; sequences disabled");
+        return false;
+    }
+    if (!LittleFS.exists(SEQUENCE_DIR)) {
+        LittleFS.mkdir(SEQUENCE_DIR);
+    }
+
+    File dir = LittleFS.open(SEQUENCE_DIR);
+    for (File file = dir.openNextFile(); file && entryCount < HID_SEQUENCE_MAX_ENTRIES; file = dir.openNextFile()) {
+        StoredSequence header;
+        if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+            header.magic != SEQUENCE_MAGIC || header.reports > HID_SEQUENCE_MAX_REPORTS) {
+            continue;
+        }
+        HIDSequenceInfo& entry = entries[entryCount++];
+        memcpy(entry.name, header.name, HID_SEQUENCE_NAME_SIZE);
+        entry.name[HID_SEQUENCE_NAME_SIZE - 1] = '\0';
+        entry.nameHash = fnv1a(entry.name, strlen(entry.name));
+        entry.contentHash = header.contentHash;
+        entry.reports = header.reports;
+        entry.layout = header.layout;
+    }
+
+    DEBUG_PRINTF("Loaded %u stored HID sequences\n", entryCount);
+    return true;
+}
+
+int HIDSequenceStore::findByName(const char* name) const {
+    for (uint8_t i = 0; i < entryCount; i++) {
+        if (strcmp(entries[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+int HIDSequenceStore::findByHash(uint32_t contentHash) const {
+    for (uint8_t i = 0; i < entryCount; i++) {
+        if (entries[i].contentHash == contentHash) return i;
+    }
+    return -1;
+}
+
+HIDSequenceStore::CacheSlot* HIDSequenceStore::findSlot(uint32_t nameHash) {
+    for (uint8_t i = 0; i < HID_SEQUENCE_CACHE_SLOTS; i++) {
+        if (cache[i].valid && cache[i].nameHash == nameHash) return &cache[i];
+    }
+    return nullptr;
+}
+
+// Least recently used slot the scheduler is no longer reading from
+HIDSequenceStore::CacheSlot* HIDSequenceStore::acquireSlot() {
+    CacheSlot* victim = nullptr;
+    for (uint8_t i = 0; i < HID_SEQUENCE_CACHE_SLOTS; i++) {
+        CacheSlot& slot = cache[i];
+        if (!hid->completed(slot.busyUntil)) continue;
+        if (!victim || !slot.valid || (victim->valid && slot.lastUsed < victim->lastUsed)) {
+            victim = &slot;
+            if (!slot.valid) break;
+        }
+    }
+    if (victim) victim->valid = false;
+    return victim;
+}
+
+void HIDSequenceStore::invalidate(uint32_t nameHash) {
+    // A slot still being replayed keeps its reports; busyUntil protects it
+    CacheSlot* slot = findSlot(nameHash);
+    if (slot) slot->valid = false;
+}
+
+bool HIDSequenceStore::define(const char* name, const char* text, size_t length, uint8_t layout,
+                              uint32_t& contentHash, const char*& error) {
+    size_t nameLength = strlen(name);
+    if (!mounted) {
+        error = "Sequence storage not available";
+        return false;
+    }
+    if (nameLength == 0 || nameLength >= HID_SEQUENCE_NAME_SIZE) {
+        error = "Name must be 1 to 31 characters";
+        return false;
+    }
+    if (length == 0) {
+        error = "Missing text";
+        return false;
+    }
+
+    int index = findByName(name);
+    if (index < 0 && entryCount >= HID_SEQUENCE_MAX_ENTRIES) {
+        error = "Sequence store full";
+        return false;
+    }
+
+    CacheSlot* slot = acquireSlot();
+    if (!slot) {
+        error = "Sequence cache busy; retry when replays finish";
+        return false;
+    }
+    size_t reports = HIDReportCompiler::compile(text, length, layout, slot->reports, HID_SEQUENCE_MAX_REPORTS);
+    if (reports == 0) {
+        error = "Text compiles to no reports, or to too many";
+        return false;
+    }
+
+    uint32_t nameHash = fnv1a(name, nameLength);
+    StoredSequence header = {};
+    header.magic = SEQUENCE_MAGIC;
+    header.contentHash = fnv1a(text, length);
+    header.reports = reports;
+    header.layout = layout;
+    memcpy(header.name, name, nameLength);
+
+    char path[16];
+    pathFor(nameHash, path);
+    File file = LittleFS.open(path, "w");
+    size_t bytes = reports * sizeof(HIDKeyboardReport);
+    bool written = file && file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                   file.write((const uint8_t*)slot->reports, bytes) == bytes;
+    if (file) file.close();
+    if (!written) {
+        LittleFS.remove(path);
+        error = "Flash write failed";
+        return false;
+    }
+
+    if (index < 0) index = entryCount++;
+    HIDSequenceInfo& entry = entries[index];
+    memcpy(entry.name, header.name, HID_SEQUENCE_NAME_SIZE);
+    entry.nameHash = nameHash;
+    entry.contentHash = header.contentHash;
+    entry.reports = reports;
+    entry.layout = layout;
+
+    // The fresh compile is the hottest copy
+    invalidate(nameHash);
+    slot->valid = true;
+    slot->nameHash = nameHash;
+    slot->count = reports;
+    slot->lastUsed = ++useClock;
+
+    contentHash = header.contentHash;
+    DEBUG_PRINTF("Stored sequence %s: %u reports\n", name, (unsigned)reports);
+    return true;
+}
+
+bool HIDSequenceStore::remove(const char* name) {
+    int index = findByName(name);
+    if (index < 0) return false;
+
+    char path[16];
+    pathFor(entries[index].nameHash, path);
+    LittleFS.remove(path);
+    invalidate(entries[index].nameHash);
+
+    entries[index] = entries[--entryCount];
+    return true;
+}
+
+bool HIDSequenceStore::replay(const char* name, uint32_t contentHash, uint16_t reportDelay, const char*& error) {
+    int index = name[0] ? findByName(name) : findByHash(contentHash);
+    if (index < 0) {
+        error = "Unknown sequence";
+        return false;
+    }
+    const HIDSequenceInfo& entry = entries[index];
+
+    CacheSlot* slot = findSlot(entry.nameHash);
+    if (slot) {
+        hits++;
+    } else {
+        misses++;
+        slot = acquireSlot();
+        if (!slot) {
+            error = "Sequence cache busy; retry when replays finish";
+            return false;
+        }
+
+        char path[16];
+        pathFor(entry.nameHash, path);
+        File file = LittleFS.open(path, "r");
+        size_t bytes = entry.reports * sizeof(HIDKeyboardReport);
+        bool loaded = file && file.seek(sizeof(StoredSequence)) &&
+                      file.read((uint8_t*)slot->reports, bytes) == bytes;
+        if (file) file.close();
+        if (!loaded) {
+            error = "Flash read failed";
+            return false;
+        }
+        slot->valid = true;
+        slot->nameHash = entry.nameHash;
+        slot->count = entry.reports;
+    }
+
+    if (!hid->playReports(slot->reports, slot->count, reportDelay)) {
+        error = "HID queue full";
+        return false;
+    }
+    slot->busyUntil = hid->sequence();
+    slot->lastUsed = ++useClock;
+    return true;
+}
@@ -0,0 +1,95 @@
+#include "hid_wire_protocol.h"
+
+// Payload bytes after the opcode; 0xff marks an unassigned opcode. Text
+// records are listed at their header size; the string follows.
+static const uint8_t PAYLOAD_SIZES[] = {
+    0xff,   // 0x00
+    2,      // key down
+    2,      // key up
+    0,      // release all
+    2,      // text
+    4,      // move
+    4,      // move absolute
+    1,      // button down
+    1,      // button up
+    1,      // scroll
+    2,      // delay
+    4       // replay
+};
+
+static uint16_t readU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+HIDWireDecoder::HIDWireDecoder(const uint8_t* frame, size_t frameLength)
+    : data(frame), length(frameLength), pos(0), state(HID_WIRE_OK) {
+    if (length == 0 || data[0] != HID_WIRE_VERSION) {
+        state = HID_WIRE_BAD_VERSION;
+        return;
+    }
+    pos = 1;
+}
+
+bool HIDWireDecoder::next(HIDWireEvent& event) {
+    if (state != HID_WIRE_OK || pos >= length) return false;
+
+    uint8_t opcode = data[pos];
+    if (opcode >= sizeof(PAYLOAD_SIZES) || PAYLOAD_SIZES[opcode] == 0xff) {
+        state = HID_WIRE_BAD_OPCODE;
+        return false;
+    }
+    size_t size = PAYLOAD_SIZES[opcode];
+    if (length - pos - 1 < size) {
+        state = HID_WIRE_TRUNCATED;
+        return false;
+    }
+
+    const uint8_t* p = data + pos + 1;
+    if (opcode == HID_WIRE_TEXT) {
+        if (length - pos - 1 - size < p[0]) {
+            state = HID_WIRE_TRUNCATED;
+            return false;
+        }
+        size += p[0];
+    }
+
+    event.opcode = (HIDWireOpcode)opcode;
+    switch (event.opcode) {
+        case HID_WIRE_KEY_DOWN:
+        case HID_WIRE_KEY_UP:
+            event.key.usage = p[0];
+            event.key.modifiers = p[1];
+            break;
+        case HID_WIRE_TEXT:
+            event.text.length = p[0];
+            event.text.layout = p[1];
+            event.text.data = (const char*)(p + 2);
+            break;
+        case HID_WIRE_MOVE:
+            event.move.x = (int16_t)readU16(p);
+            event.move.y = (int16_t)readU16(p + 2);
+            break;
+        case HID_WIRE_MOVE_ABSOLUTE:
+            event.position.x = readU16(p);
+            event.position.y = readU16(p + 2);
+            break;
+        case HID_WIRE_BUTTON_DOWN:
+        case HID_WIRE_BUTTON_UP:
+            event.buttons = p[0];
+            break;
+        case HID_WIRE_SCROLL:
+            event.scroll = (int8_t)p[0];
+            break;
+        case HID_WIRE_DELAY:
+            event.delay = readU16(p);
+            break;
+        case HID_WIRE_REPLAY:
+            event.contentHash = readU16(p) | ((uint32_t)readU16(p + 2) << 16);
+            break;
+        default:
+            break;
+    }
+
+    pos += 1 + size;
+    return true;
+}
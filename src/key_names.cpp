@@ -0,0 +1,262 @@
+#include "key_names.h"
+#include "keyboard_layouts.h"
+
+namespace {
+
+struct KeyNameEntry {
+    const char* name;
+    uint8_t page;
+    uint16_t code;
+};
+
+#define KB(name, usage) {name, KEY_PAGE_KEYBOARD, usage}
+#define MOD(name, bit) {name, KEY_PAGE_MODIFIER, bit}
+#define CC(name, usage) {name, KEY_PAGE_CONSUMER, usage}
+
+// Names are stored folded: lowercase, no separators
+constexpr KeyNameEntry KEY_NAMES[] = {
+    // Letters and digits
+    KB("a", 0x04), KB("b", 0x05), KB("c", 0x06), KB("d", 0x07), KB("e", 0x08),
+    KB("f", 0x09), KB("g", 0x0a), KB("h", 0x0b), KB("i", 0x0c), KB("j", 0x0d),
+    KB("k", 0x0e), KB("l", 0x0f), KB("m", 0x10), KB("n", 0x11), KB("o", 0x12),
+    KB("p", 0x13), KB("q", 0x14), KB("r", 0x15), KB("s", 0x16), KB("t", 0x17),
+    KB("u", 0x18), KB("v", 0x19), KB("w", 0x1a), KB("x", 0x1b), KB("y", 0x1c),
+    KB("z", 0x1d),
+    KB("1", 0x1e), KB("2", 0x1f), KB("3", 0x20), KB("4", 0x21), KB("5", 0x22),
+    KB("6", 0x23), KB("7", 0x24), KB("8", 0x25), KB("9", 0x26), KB("0", 0x27),
+
+    // Editing and whitespace
+    KB("enter", 0x28), KB("return", 0x28), KB("ret", 0x28),
+    KB("escape", 0x29), KB("esc", 0x29),
+    KB("backspace", 0x2a), KB("bksp", 0x2a),
+    KB("tab", 0x2b),
+    KB("space", 0x2c), KB("spacebar", 0x2c),
+    KB("minus", 0x2d), KB("hyphen", 0x2d), KB("dash", 0x2d),
+    KB("equal", 0x2e), KB("equals", 0x2e),
+    KB("leftbracket", 0x2f), KB("lbracket", 0x2f), KB("bracketleft", 0x2f),
+    KB("rightbracket", 0x30), KB("rbracket", 0x30), KB("bracketright", 0x30),
+    KB("backslash", 0x31),
+    KB("nonushash", 0x32), KB("europe1", 0x32),
+    KB("semicolon", 0x33),
+    KB("quote", 0x34), KB("apostrophe", 0x34),
+    KB("grave", 0x35), KB("backtick", 0x35),
+    KB("comma", 0x36),
+    KB("period", 0x37), KB("dot", 0x37),
+    KB("slash", 0x38),
+    KB("capslock", 0x39), KB("caps", 0x39),
+
+    // Function keys
+    KB("f1", 0x3a), KB("f2", 0x3b), KB("f3", 0x3c), KB("f4", 0x3d),
+    KB("f5", 0x3e), KB("f6", 0x3f), KB("f7", 0x40), KB("f8", 0x41),
+    KB("f9", 0x42), KB("f10", 0x43), KB("f11", 0x44), KB("f12", 0x45),
+    KB("f13", 0x68), KB("f14", 0x69), KB("f15", 0x6a), KB("f16", 0x6b),
+    KB("f17", 0x6c), KB("f18", 0x6d), KB("f19", 0x6e), KB("f20", 0x6f),
+    KB("f21", 0x70), KB("f22", 0x71), KB("f23", 0x72), KB("f24", 0x73),
+
+    // System and navigation
+    KB("printscreen", 0x46), KB("prtsc", 0x46), KB("prtscr", 0x46), KB("print", 0x46), KB("sysrq", 0x46),
+    KB("scrolllock", 0x47), KB("scrlk", 0x47),
+    KB("pause", 0x48), KB("break", 0x48),
+    KB("insert", 0x49), KB("ins", 0x49),
+    KB("home", 0x4a),
+    KB("pageup", 0x4b), KB("pgup", 0x4b),
+    KB("delete", 0x4c), KB("del", 0x4c),
+    KB("end", 0x4d),
+    KB("pagedown", 0x4e), KB("pgdn", 0x4e),
+    KB("right", 0x4f), KB("rightarrow", 0x4f), KB("arrowright", 0x4f),
+    KB("left", 0x50), KB("leftarrow", 0x50), KB("arrowleft", 0x50),
+    KB("down", 0x51), KB("downarrow", 0x51), KB("arrowdown", 0x51),
+    KB("up", 0x52), KB("uparrow", 0x52), KB("arrowup", 0x52),
+    KB("nonusbackslash", 0x64), KB("europe2", 0x64),
+    KB("menu", 0x65), KB("application", 0x65), KB("apps", 0x65), KB("contextmenu", 0x65),
+    KB("power", 0x66),
+    KB("execute", 0x74), KB("help", 0x75), KB("select", 0x77), KB("again", 0x79),
+    KB("undo", 0x7a), KB("cut", 0x7b), KB("copy", 0x7c), KB("paste", 0x7d), KB("find", 0x7e),
+
+    // Keypad
+    KB("numlock", 0x53),
+    KB("kpslash", 0x54), KB("kpdivide", 0x54),
+    KB("kpasterisk", 0x55), KB("kpmultiply", 0x55),
+    KB("kpminus", 0x56), KB("kpsubtract", 0x56),
+    KB("kpplus", 0x57), KB("kpadd", 0x57),
+    KB("kpenter", 0x58),
+    KB("kp1", 0x59), KB("kp2", 0x5a), KB("kp3", 0x5b), KB("kp4", 0x5c), KB("kp5", 0x5d),
+    KB("kp6", 0x5e), KB("kp7", 0x5f), KB("kp8", 0x60), KB("kp9", 0x61), KB("kp0", 0x62),
+    KB("numpad1", 0x59), KB("numpad2", 0x5a), KB("numpad3", 0x5b), KB("numpad4", 0x5c), KB("numpad5", 0x5d),
+    KB("numpad6", 0x5e), KB("numpad7", 0x5f), KB("numpad8", 0x60), KB("numpad9", 0x61), KB("numpad0", 0x62),
+    KB("kpperiod", 0x63), KB("kpdecimal", 0x63), KB("kpdot", 0x63),
+    KB("kpequal", 0x67), KB("kpcomma", 0x85),
+
+    // International
+    KB("international1", 0x87), KB("ro", 0x87),
+    KB("international2", 0x88), KB("kana", 0x88), KB("katakanahiragana", 0x88),
+    KB("international3", 0x89), KB("yen", 0x89),
+    KB("international4", 0x8a), KB("henkan", 0x8a),
+    KB("international5", 0x8b), KB("muhenkan", 0x8b),
+    KB("lang1", 0x90), KB("hangul", 0x90),
+    KB("lang2", 0x91), KB("hanja", 0x91),
+
+    // Modifiers pressed as keys
+    MOD("ctrl", HID_MOD_LEFT_CTRL), MOD("control", HID_MOD_LEFT_CTRL),
+    MOD("lctrl", HID_MOD_LEFT_CTRL), MOD("leftctrl", HID_MOD_LEFT_CTRL),
+    MOD("shift", HID_MOD_LEFT_SHIFT), MOD("lshift", HID_MOD_LEFT_SHIFT), MOD("leftshift", HID_MOD_LEFT_SHIFT),
+    MOD("alt", HID_MOD_LEFT_ALT), MOD("lalt", HID_MOD_LEFT_ALT), MOD("leftalt", HID_MOD_LEFT_ALT), MOD("option", HID_MOD_LEFT_ALT),
+    MOD("gui", HID_MOD_LEFT_GUI), MOD("lgui", HID_MOD_LEFT_GUI), MOD("win", HID_MOD_LEFT_GUI),
+    MOD("windows", HID_MOD_LEFT_GUI), MOD("cmd", HID_MOD_LEFT_GUI), MOD("command", HID_MOD_LEFT_GUI),
+    MOD("meta", HID_MOD_LEFT_GUI), MOD("super", HID_MOD_LEFT_GUI),
+    MOD("rctrl", HID_MOD_RIGHT_CTRL), MOD("rightctrl", HID_MOD_RIGHT_CTRL),
+    MOD("rshift", HID_MOD_RIGHT_SHIFT), MOD("rightshift", HID_MOD_RIGHT_SHIFT),
+    MOD("ralt", HID_MOD_RIGHT_ALT), MOD("rightalt", HID_MOD_RIGHT_ALT), MOD("altgr", HID_MOD_RIGHT_ALT),
+    MOD("rgui", HID_MOD_RIGHT_GUI), MOD("rightgui", HID_MOD_RIGHT_GUI),
+
+    // Consumer control (media) keys
+    CC("volumeup", 0x0e9), CC("volup", 0x0e9),
+    CC("volumedown", 0x0ea), CC("voldown", 0x0ea),
+    CC("mute", 0x0e2), CC("volumemute", 0x0e2),
+    CC("playpause", 0x0cd), CC("mediaplaypause", 0x0cd), CC("play", 0x0cd),
+    CC("nexttrack", 0x0b5), CC("medianext", 0x0b5), CC("next", 0x0b5),
+    CC("prevtrack", 0x0b6), CC("previoustrack", 0x0b6), CC("mediaprev", 0x0b6), CC("prev", 0x0b6),
+    CC("stop", 0x0b7), CC("mediastop", 0x0b7),
+    CC("eject", 0x0b8),
+    CC("brightnessup", 0x06f), CC("brightnessdown", 0x070),
+    CC("mail", 0x18a), CC("calculator", 0x192), CC("calc", 0x192),
+    CC("mycomputer", 0x194), CC("explorer", 0x194),
+    CC("browsersearch", 0x221), CC("browserhome", 0x223),
+    CC("browserback", 0x224), CC("browserforward", 0x225),
+    CC("browserstop", 0x226), CC("browserrefresh", 0x227),
+    CC("browserfavorites", 0x22a), CC("bookmarks", 0x22a),
+};
+
+#undef KB
+#undef MOD
+#undef CC
+
+constexpr size_t KEY_NAME_COUNT = sizeof(KEY_NAMES) / sizeof(KEY_NAMES[0]);
+constexpr uint8_t BUCKET_BITS = 7;
+constexpr size_t BUCKETS = 1 << BUCKET_BITS;
+constexpr size_t SLOTS = 512;
+constexpr size_t MAX_BUCKET = 16;
+static_assert(KEY_NAME_COUNT < SLOTS / 2, "grow SLOTS to keep the perfect hash sparse");
+
+constexpr bool isSeparator(char c) {
+    return c == '_' || c == '-' || c == ' ';
+}
+
+constexpr char foldCase(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// FNV-1a over the folded name
+constexpr uint32_t hashName(const char* name, size_t length) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length && name[i]; i++) {
+        if (isSeparator(name[i])) continue;
+        h ^= (uint8_t)foldCase(name[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr uint32_t bucketOf(uint32_t h) {
+    return (h * 0x9e3779b1u) >> (32 - BUCKET_BITS);
+}
+
+constexpr uint32_t slotOf(uint32_t h, uint16_t seed) {
+    uint32_t x = h ^ (seed * 0x85ebca6bu);
+    x ^= x >> 16;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 13;
+    return x & (SLOTS - 1);
+}
+
+struct KeyNameTable {
+    uint16_t seeds[BUCKETS];
+    int16_t slots[SLOTS];
+    bool ok;
+};
+
+// Hash-and-displace construction: buckets are placed largest first, each
+// searching for a seed that sends all of its names to free slots.
+constexpr KeyNameTable buildKeyNameTable() {
+    KeyNameTable t{};
+    for (size_t i = 0; i < SLOTS; i++) t.slots[i] = -1;
+
+    uint32_t hashes[KEY_NAME_COUNT] = {};
+    uint16_t bucketSize[BUCKETS] = {};
+    for (size_t i = 0; i < KEY_NAME_COUNT; i++) {
+        hashes[i] = hashName(KEY_NAMES[i].name, SIZE_MAX);
+        bucketSize[bucketOf(hashes[i])]++;
+    }
+
+    // Group entry indices by bucket
+    uint16_t bucketStart[BUCKETS + 1] = {};
+    for (size_t b = 0; b < BUCKETS; b++) bucketStart[b + 1] = bucketStart[b] + bucketSize[b];
+    uint16_t fill[BUCKETS] = {};
+    uint16_t members[KEY_NAME_COUNT] = {};
+    for (size_t i = 0; i < KEY_NAME_COUNT; i++) {
+        uint32_t b = bucketOf(hashes[i]);
+        members[bucketStart[b] + fill[b]++] = i;
+    }
+
+    uint16_t largest = 0;
+    for (size_t b = 0; b < BUCKETS; b++) largest = bucketSize[b] > largest ? bucketSize[b] : largest;
+    if (largest > MAX_BUCKET) return t;
+
+    for (uint16_t size = largest; size > 0; size--) {
+        for (size_t b = 0; b < BUCKETS; b++) {
+            if (bucketSize[b] != size) continue;
+
+            bool placed = false;
+            for (uint32_t seed = 0; seed < 0x10000 && !placed; seed++) {
+                uint32_t slots[MAX_BUCKET] = {};
+                placed = true;
+                for (uint16_t m = 0; m < size && placed; m++) {
+                    uint32_t s = slotOf(hashes[members[bucketStart[b] + m]], seed);
+                    if (t.slots[s] != -1) placed = false;
+                    for (uint16_t prev = 0; prev < m && placed; prev++) {
+                        if (slots[prev] == s) placed = false;
+                    }
+                    slots[m] = s;
+                }
+                if (placed) {
+                    t.seeds[b] = seed;
+                    for (uint16_t m = 0; m < size; m++) {
+                        t.slots[slots[m]] = members[bucketStart[b] + m];
+                    }
+                }
+            }
+            // Only fails if two entries fold to the same name
+            if (!placed) return t;
+        }
+    }
+
+    t.ok = true;
+    return t;
+}
+
+constexpr KeyNameTable KEY_NAME_TABLE = buildKeyNameTable();
+static_assert(KEY_NAME_TABLE.ok, "KEY_NAMES has a duplicate entry or an oversized bucket");
+
+// Compares a request name against a folded table entry
+bool namesEqual(const char* entry, const char* name, size_t length) {
+    size_t i = 0;
+    for (; i < length && name[i]; i++) {
+        if (isSeparator(name[i])) continue;
+        if (*entry++ != foldCase(name[i])) return false;
+    }
+    return *entry == '\0';
+}
+
+} // namespace
+
+bool lookupKeyName(const char* name, size_t length, KeyCode& out) {
+    uint32_t h = hashName(name, length);
+    int16_t index = KEY_NAME_TABLE.slots[slotOf(h, KEY_NAME_TABLE.seeds[bucketOf(h)])];
+    if (index < 0 || !namesEqual(KEY_NAMES[index].name, name, length)) {
+        return false;
+    }
+
+    out.page = KEY_NAMES[index].page;
+    out.code = KEY_NAMES[index].code;
+    return true;
+}
@@ -0,0 +1,376 @@
+#include "keyboard_layouts.h"
+#include <string.h>
+#include <strings.h>
+
+namespace {
+
+constexpr uint8_t S = HID_MOD_LEFT_SHIFT;
+constexpr uint8_t AG = HID_MOD_RIGHT_ALT;   // AltGr
+
+// Usage ids of the keys whose legends change between layouts, named after
+// their US legend
+enum : uint8_t {
+    K_1 = 0x1e, K_2, K_3, K_4, K_5, K_6, K_7, K_8, K_9, K_0,
+    K_MINUS = 0x2d, K_EQUAL, K_LBRACKET, K_RBRACKET, K_BACKSLASH, K_NONUS_HASH,
+    K_SEMICOLON, K_QUOTE, K_GRAVE, K_COMMA, K_PERIOD, K_SLASH,
+    K_NONUS_BACKSLASH = 0x64
+};
+
+constexpr uint8_t letter(char c) {
+    return 0x04 + (c - 'a');
+}
+
+// Letters, whitespace and control keys shared by every layout
+constexpr KeyboardLayout baseLayout() {
+    KeyboardLayout t{};
+    for (uint8_t i = 0; i < 26; i++) {
+        t.map('a' + i, 0x04 + i);
+        t.map('A' + i, 0x04 + i, S);
+    }
+    t.map('\b', 0x2a);
+    t.map('\t', 0x2b);
+    t.map('\n', 0x28);
+    t.map(0x1b, 0x29);
+    t.map(' ', 0x2c);
+    return t;
+}
+
+constexpr void mapDigits(KeyboardLayout& t, uint8_t modifiers) {
+    for (uint8_t i = 0; i < 9; i++) {
+        t.map('1' + i, K_1 + i, modifiers);
+    }
+    t.map('0', K_0, modifiers);
+}
+
+// Accented letters reachable through a dead key. bases and codepoints are
+// parallel lists of lowercase letters; uppercase forms sit 0x20 lower in
+// Latin-1. Characters the layout already types directly are left alone.
+constexpr void composeSet(KeyboardLayout& t, DeadKey deadKey, const char* bases, const char* codepoints) {
+    for (size_t i = 0; bases[i]; i++) {
+        uint8_t base = (uint8_t)bases[i];
+        uint8_t cp = (uint8_t)codepoints[i];
+        if (t.latin1[cp].usage == 0) {
+            t.compose(cp, deadKey, base);
+        }
+        // U+00FF has no Latin-1 uppercase form
+        if (cp != 0xff && t.latin1[cp - 0x20].usage == 0) {
+            t.compose(cp - 0x20, deadKey, base - 0x20);
+        }
+    }
+}
+
+constexpr KeyboardLayout usLayout() {
+    KeyboardLayout t = baseLayout();
+    mapDigits(t, 0);
+    t.map('!', K_1, S);
+    t.map('@', K_2, S);
+    t.map('#', K_3, S);
+    t.map('$', K_4, S);
+    t.map('%', K_5, S);
+    t.map('^', K_6, S);
+    t.map('&', K_7, S);
+    t.map('*', K_8, S);
+    t.map('(', K_9, S);
+    t.map(')', K_0, S);
+    t.map('-', K_MINUS);
+    t.map('_', K_MINUS, S);
+    t.map('=', K_EQUAL);
+    t.map('+', K_EQUAL, S);
+    t.map('[', K_LBRACKET);
+    t.map('{', K_LBRACKET, S);
+    t.map(']', K_RBRACKET);
+    t.map('}', K_RBRACKET, S);
+    t.map('\\', K_BACKSLASH);
+    t.map('|', K_BACKSLASH, S);
+    t.map(';', K_SEMICOLON);
+    t.map(':', K_SEMICOLON, S);
+    t.map('\'', K_QUOTE);
+    t.map('"', K_QUOTE, S);
+    t.map('`', K_GRAVE);
+    t.map('~', K_GRAVE, S);
+    t.map(',', K_COMMA);
+    t.map('<', K_COMMA, S);
+    t.map('.', K_PERIOD);
+    t.map('>', K_PERIOD, S);
+    t.map('/', K_SLASH);
+    t.map('?', K_SLASH, S);
+    return t;
+}
+
+constexpr KeyboardLayout ukLayout() {
+    KeyboardLayout t = baseLayout();
+    mapDigits(t, 0);
+    t.map('!', K_1, S);
+    t.map('"', K_2, S);
+    t.map(0xa3, K_3, S);            // £
+    t.map('$', K_4, S);
+    t.map(0x20ac, K_4, AG);         // €
+    t.map('%', K_5, S);
+    t.map('^', K_6, S);
+    t.map('&', K_7, S);
+    t.map('*', K_8, S);
+    t.map('(', K_9, S);
+    t.map(')', K_0, S);
+    t.map('-', K_MINUS);
+    t.map('_', K_MINUS, S);
+    t.map('=', K_EQUAL);
+    t.map('+', K_EQUAL, S);
+    t.map('[', K_LBRACKET);
+    t.map('{', K_LBRACKET, S);
+    t.map(']', K_RBRACKET);
+    t.map('}', K_RBRACKET, S);
+    t.map('#', K_NONUS_HASH);
+    t.map('~', K_NONUS_HASH, S);
+    t.map(';', K_SEMICOLON);
+    t.map(':', K_SEMICOLON, S);
+    t.map('\'', K_QUOTE);
+    t.map('@', K_QUOTE, S);
+    t.map('`', K_GRAVE);
+    t.map(0xac, K_GRAVE, S);        // ¬
+    t.map(0xa6, K_GRAVE, AG);       // ¦
+    t.map(',', K_COMMA);
+    t.map('<', K_COMMA, S);
+    t.map('.', K_PERIOD);
+    t.map('>', K_PERIOD, S);
+    t.map('/', K_SLASH);
+    t.map('?', K_SLASH, S);
+    t.map('\\', K_NONUS_BACKSLASH);
+    t.map('|', K_NONUS_BACKSLASH, S);
+    // AltGr vowels
+    t.map(0xe1, letter('a'), AG);
+    t.map(0xe9, letter('e'), AG);
+    t.map(0xed, letter('i'), AG);
+    t.map(0xf3, letter('o'), AG);
+    t.map(0xfa, letter('u'), AG);
+    t.map(0xc1, letter('a'), AG | S);
+    t.map(0xc9, letter('e'), AG | S);
+    t.map(0xcd, letter('i'), AG | S);
+    t.map(0xd3, letter('o'), AG | S);
+    t.map(0xda, letter('u'), AG | S);
+    return t;
+}
+
+constexpr KeyboardLayout deLayout() {
+    KeyboardLayout t = baseLayout();
+    t.map('z', letter('y'));
+    t.map('Z', letter('y'), S);
+    t.map('y', letter('z'));
+    t.map('Y', letter('z'), S);
+    mapDigits(t, 0);
+    t.map('!', K_1, S);
+    t.map('"', K_2, S);
+    t.map(0xb2, K_2, AG);           // ²
+    t.map(0xa7, K_3, S);            // §
+    t.map(0xb3, K_3, AG);           // ³
+    t.map('$', K_4, S);
+    t.map('%', K_5, S);
+    t.map('&', K_6, S);
+    t.map('/', K_7, S);
+    t.map('{', K_7, AG);
+    t.map('(', K_8, S);
+    t.map('[', K_8, AG);
+    t.map(')', K_9, S);
+    t.map(']', K_9, AG);
+    t.map('=', K_0, S);
+    t.map('}', K_0, AG);
+    t.map(0xdf, K_MINUS);           // ß
+    t.map('?', K_MINUS, S);
+    t.map('\\', K_MINUS, AG);
+    t.dead(DEAD_ACUTE, K_EQUAL);
+    t.dead(DEAD_GRAVE, K_EQUAL, S);
+    t.map(0xfc, K_LBRACKET);        // ü
+    t.map(0xdc, K_LBRACKET, S);     // Ü
+    t.map('+', K_RBRACKET);
+    t.map('*', K_RBRACKET, S);
+    t.map('~', K_RBRACKET, AG);
+    t.map('#', K_NONUS_HASH);
+    t.map('\'', K_NONUS_HASH, S);
+    t.map(0xf6, K_SEMICOLON);       // ö
+    t.map(0xd6, K_SEMICOLON, S);    // Ö
+    t.map(0xe4, K_QUOTE);           // ä
+    t.map(0xc4, K_QUOTE, S);        // Ä
+    t.dead(DEAD_CIRCUMFLEX, K_GRAVE);
+    t.map(0xb0, K_GRAVE, S);        // °
+    t.map(',', K_COMMA);
+    t.map(';', K_COMMA, S);
+    t.map('.', K_PERIOD);
+    t.map(':', K_PERIOD, S);
+    t.map('-', K_SLASH);
+    t.map('_', K_SLASH, S);
+    t.map('<', K_NONUS_BACKSLASH);
+    t.map('>', K_NONUS_BACKSLASH, S);
+    t.map('|', K_NONUS_BACKSLASH, AG);
+    t.map('@', letter('q'), AG);
+    t.map(0x20ac, letter('e'), AG); // €
+    t.map(0xb5, letter('m'), AG);   // µ
+    t.compose('^', DEAD_CIRCUMFLEX, ' ');
+    t.compose('`', DEAD_GRAVE, ' ');
+    t.compose(0xb4, DEAD_ACUTE, ' ');
+    composeSet(t, DEAD_ACUTE, "aeiouy", "\xe1\xe9\xed\xf3\xfa\xfd");
+    composeSet(t, DEAD_GRAVE, "aeiou", "\xe0\xe8\xec\xf2\xf9");
+    composeSet(t, DEAD_CIRCUMFLEX, "aeiou", "\xe2\xea\xee\xf4\xfb");
+    return t;
+}
+
+constexpr KeyboardLayout frLayout() {
+    KeyboardLayout t = baseLayout();
+    t.map('a', letter('q'));
+    t.map('A', letter('q'), S);
+    t.map('q', letter('a'));
+    t.map('Q', letter('a'), S);
+    t.map('z', letter('w'));
+    t.map('Z', letter('w'), S);
+    t.map('w', letter('z'));
+    t.map('W', letter('z'), S);
+    t.map('m', K_SEMICOLON);
+    t.map('M', K_SEMICOLON, S);
+    mapDigits(t, S);
+    t.map('&', K_1);
+    t.map(0xe9, K_2);               // é
+    t.dead(DEAD_TILDE, K_2, AG);
+    t.map('"', K_3);
+    t.map('#', K_3, AG);
+    t.map('\'', K_4);
+    t.map('{', K_4, AG);
+    t.map('(', K_5);
+    t.map('[', K_5, AG);
+    t.map('-', K_6);
+    t.map('|', K_6, AG);
+    t.map(0xe8, K_7);               // è
+    t.dead(DEAD_GRAVE, K_7, AG);
+    t.map('_', K_8);
+    t.map('\\', K_8, AG);
+    t.map(0xe7, K_9);               // ç
+    t.map('^', K_9, AG);
+    t.map(0xe0, K_0);               // à
+    t.map('@', K_0, AG);
+    t.map(')', K_MINUS);
+    t.map(0xb0, K_MINUS, S);        // °
+    t.map(']', K_MINUS, AG);
+    t.map('=', K_EQUAL);
+    t.map('+', K_EQUAL, S);
+    t.map('}', K_EQUAL, AG);
+    t.dead(DEAD_CIRCUMFLEX, K_LBRACKET);
+    t.dead(DEAD_DIAERESIS, K_LBRACKET, S);
+    t.map('$', K_RBRACKET);
+    t.map(0xa3, K_RBRACKET, S);     // £
+    t.map(0xa4, K_RBRACKET, AG);    // ¤
+    t.map('*', K_NONUS_HASH);
+    t.map(0xb5, K_NONUS_HASH, S);   // µ
+    t.map(0xf9, K_QUOTE);           // ù
+    t.map('%', K_QUOTE, S);
+    t.map(0xb2, K_GRAVE);           // ²
+    t.map(',', letter('m'));
+    t.map('?', letter('m'), S);
+    t.map(';', K_COMMA);
+    t.map('.', K_COMMA, S);
+    t.map(':', K_PERIOD);
+    t.map('/', K_PERIOD, S);
+    t.map('!', K_SLASH);
+    t.map(0xa7, K_SLASH, S);        // §
+    t.map('<', K_NONUS_BACKSLASH);
+    t.map('>', K_NONUS_BACKSLASH, S);
+    t.map(0x20ac, letter('e'), AG); // €
+    t.compose('~', DEAD_TILDE, ' ');
+    t.compose('`', DEAD_GRAVE, ' ');
+    t.compose(0xa8, DEAD_DIAERESIS, ' ');
+    composeSet(t, DEAD_CIRCUMFLEX, "aeiou", "\xe2\xea\xee\xf4\xfb");
+    composeSet(t, DEAD_DIAERESIS, "aeiouy", "\xe4\xeb\xef\xf6\xfc\xff");
+    composeSet(t, DEAD_GRAVE, "aeiou", "\xe0\xe8\xec\xf2\xf9");
+    composeSet(t, DEAD_TILDE, "aon", "\xe3\xf5\xf1");
+    return t;
+}
+
+// Swedish/Finnish
+constexpr KeyboardLayout nordicLayout() {
+    KeyboardLayout t = baseLayout();
+    mapDigits(t, 0);
+    t.map('!', K_1, S);
+    t.map('"', K_2, S);
+    t.map('@', K_2, AG);
+    t.map('#', K_3, S);
+    t.map(0xa3, K_3, AG);           // £
+    t.map(0xa4, K_4, S);            // ¤
+    t.map('$', K_4, AG);
+    t.map('%', K_5, S);
+    t.map(0x20ac, K_5, AG);         // €
+    t.map('&', K_6, S);
+    t.map('/', K_7, S);
+    t.map('{', K_7, AG);
+    t.map('(', K_8, S);
+    t.map('[', K_8, AG);
+    t.map(')', K_9, S);
+    t.map(']', K_9, AG);
+    t.map('=', K_0, S);
+    t.map('}', K_0, AG);
+    t.map('+', K_MINUS);
+    t.map('?', K_MINUS, S);
+    t.map('\\', K_MINUS, AG);
+    t.dead(DEAD_ACUTE, K_EQUAL);
+    t.dead(DEAD_GRAVE, K_EQUAL, S);
+    t.map(0xe5, K_LBRACKET);        // å
+    t.map(0xc5, K_LBRACKET, S);     // Å
+    t.dead(DEAD_DIAERESIS, K_RBRACKET);
+    t.dead(DEAD_CIRCUMFLEX, K_RBRACKET, S);
+    t.dead(DEAD_TILDE, K_RBRACKET, AG);
+    t.map('\'', K_NONUS_HASH);
+    t.map('*', K_NONUS_HASH, S);
+    t.map(0xf6, K_SEMICOLON);       // ö
+    t.map(0xd6, K_SEMICOLON, S);    // Ö
+    t.map(0xe4, K_QUOTE);           // ä
+    t.map(0xc4, K_QUOTE, S);        // Ä
+    t.map(0xa7, K_GRAVE);           // §
+    t.map(0xbd, K_GRAVE, S);        // ½
+    t.map(',', K_COMMA);
+    t.map(';', K_COMMA, S);
+    t.map('.', K_PERIOD);
+    t.map(':', K_PERIOD, S);
+    t.map('-', K_SLASH);
+    t.map('_', K_SLASH, S);
+    t.map('<', K_NONUS_BACKSLASH);
+    t.map('>', K_NONUS_BACKSLASH, S);
+    t.map('|', K_NONUS_BACKSLASH, AG);
+    t.map(0xb5, letter('m'), AG);   // µ
+    t.compose('~', DEAD_TILDE, ' ');
+    t.compose('^', DEAD_CIRCUMFLEX, ' ');
+    t.compose('`', DEAD_GRAVE, ' ');
+    t.compose(0xb4, DEAD_ACUTE, ' ');
+    t.compose(0xa8, DEAD_DIAERESIS, ' ');
+    composeSet(t, DEAD_ACUTE, "aeiouy", "\xe1\xe9\xed\xf3\xfa\xfd");
+    composeSet(t, DEAD_GRAVE, "aeiou", "\xe0\xe8\xec\xf2\xf9");
+    composeSet(t, DEAD_CIRCUMFLEX, "aeiou", "\xe2\xea\xee\xf4\xfb");
+    composeSet(t, DEAD_TILDE, "aon", "\xe3\xf5\xf1");
+    composeSet(t, DEAD_DIAERESIS, "eiuy", "\xeb\xef\xfc\xff");
+    return t;
+}
+
+// Evaluated by the compiler; ends up in flash as plain tables
+constexpr KeyboardLayout LAYOUTS[KEYBOARD_LAYOUT_COUNT] = {
+    usLayout(),
+    ukLayout(),
+    deLayout(),
+    frLayout(),
+    nordicLayout()
+};
+
+const char* const LAYOUT_NAMES[KEYBOARD_LAYOUT_COUNT] = {
+    "us", "uk", "de", "fr", "nordic"
+};
+
+} // namespace
+
+const KeyboardLayout& keyboardLayout(uint8_t id) {
+    return LAYOUTS[id < KEYBOARD_LAYOUT_COUNT ? id : KEYBOARD_LAYOUT_US];
+}
+
+int keyboardLayoutFromName(const char* name) {
+    if (!name) return -1;
+    for (uint8_t i = 0; i < KEYBOARD_LAYOUT_COUNT; i++) {
+        if (strcasecmp(name, LAYOUT_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char* keyboardLayoutName(uint8_t id) {
+    return id < KEYBOARD_LAYOUT_COUNT ? LAYOUT_NAMES[id] : "unknown";
+}
@@ -61,22 +61,50 @@ psAI-Ducky — ESP32-S2 HID MCP Bridge
 #include "USB.h"
 #include "USBHIDKeyboard.h"
 #include "USBHIDMouse.h"
+#include "USBHIDConsumerControl.h"
+#include "usb_hid_absolute_mouse.h"
 
 #include "config.h"
+#include "event_loop.h"
+#include "network_watcher.h"
 #include "mcp_server.h"
 #include "hid_controller.h"
+#include "hid_benchmark.h"
+#include "hid_script.h"
+#include "hid_sequence_store.h"
 #include "wifi_manager.h"
 
 // Global objects
-WebSocketsServer webSocket(MCP_SERVER_PORT);
+WatchedWebSocketsServer webSocket(MCP_SERVER_PORT);
 USBHIDKeyboard keyboard;
 USBHIDMouse mouse;
+USBHIDConsumerControl consumerControl;
+USBHIDAbsoluteMouse absoluteMouse;
 
 // MCP and HID controllers
 MCPServer mcpServer(&webSocket);
-HIDController hidController(&keyboard, &mouse);
+HIDController hidController(&keyboard, &mouse, &consumerControl, &absoluteMouse);
+HIDBenchmark hidBenchmark(&hidController);
+HIDScript hidScript(&hidController);
+HIDSequenceStore hidSequences(&hidController);
 WiFiManager wifiManager;
 
+// loop() sleeps here until something has work for it
+EventLoop eventLoop;
+NetworkWatcher networkWatcher(&webSocket, &eventLoop);
+
+static void wakeOnHIDProgress(void* context) {
+    static_cast<EventLoop*>(context)->notify(EVENT_HID);
+}
+
+static void wakeOnUSBEvent(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    eventLoop.notify(EVENT_USB);
+}
+
+static void wakeOnWiFiEvent(arduino_event_id_t event) {
+    eventLoop.notify(EVENT_WIFI);
+}
+
 void setup() {
     // Initialize Serial for debugging
     Serial.begin(115200);
@@ -84,14 +112,21 @@ void setup() {
     Serial.println("ESP32 MCP Server MINIMAL TEST starting...");
     Serial.flush();
     
+    // setup() and loop() run on the same task, which the event loop blocks
+    eventLoop.begin();
+    
     // Initialize native USB and HID
     Serial.println("Initializing USB HID...");
+    USB.onEvent(wakeOnUSBEvent);
     USB.begin();
     keyboard.begin();
     mouse.begin();
+    consumerControl.begin();
+    absoluteMouse.begin();
 
     // Initialize WiFi Manager
     Serial.println("Initializing WiFi Manager...");
+    WiFi.onEvent(wakeOnWiFiEvent);
     wifiManager.begin();
     Serial.println("WiFi Manager initialized");
     
@@ -112,13 +147,21 @@ void setup() {
     }
     
     // Initialize HID controller
+    hidController.setProgressObserver(wakeOnHIDProgress, &eventLoop);
     hidController.begin();
+    hidBenchmark.begin();
+    hidSequences.begin();
     mcpServer.setHIDController(&hidController);
+    mcpServer.setHIDBenchmark(&hidBenchmark);
+    mcpServer.setHIDScript(&hidScript);
+    mcpServer.setHIDSequences(&hidSequences);
+    mcpServer.setEventLoop(&eventLoop);
 
     // Initialize MCP Server
     Serial.println("Initializing MCP Server...");
     mcpServer.begin();
     Serial.println("MCP Server initialized");
+    networkWatcher.begin();
     Serial.printf("WebSocket server listening on port %d\n", MCP_SERVER_PORT);
     if (WiFi.status() == WL_CONNECTED) {
         Serial.printf("WebSocket URL: ws://%s:%d\n", WiFi.localIP().toString().c_str(), MCP_SERVER_PORT);
@@ -126,16 +169,43 @@ void setup() {
     Serial.println("MINIMAL SETUP COMPLETE!");
 }
 
+// Wake sources still to be serviced, e.g. a client whose bytes were
+// buffered but not yet read
+static uint32_t pendingEvents = 0;
+
 void loop() {
-    // Handle WebSocket connections
-    webSocket.loop();
+    // Sleep until a socket is readable, the HID task makes progress, USB or
+    // WiFi state changes, or queued reports or a benchmark or script are
+    // due. A script or benchmark held up by the HID queue is woken by its
+    // progress, so one parked behind a long DELAY sleeps through it.
+    uint32_t timeout = hidController.msUntilDue();
+    uint32_t feedMs = hidBenchmark.msUntilDue();
+    if (feedMs < timeout) timeout = feedMs;
+    feedMs = hidScript.msUntilDue();
+    if (feedMs < timeout) timeout = feedMs;
+    if (pendingEvents) timeout = 0;
+    uint32_t events = pendingEvents | eventLoop.wait(timeout);
+    pendingEvents = 0;
     
-    // Handle WiFi management
-    wifiManager.loop();
+    // Handle WebSocket traffic, then watch the sockets again
+    const uint32_t network = EVENT_BIT(EVENT_NETWORK) | EVENT_BIT(EVENT_NETWORK_POLL);
+    if (events & network) {
+        mcpServer.pollNetwork();
+        if (networkWatcher.rearm()) pendingEvents |= EVENT_BIT(EVENT_NETWORK);
+    }
     
-    // Handle MCP server tasks
-    mcpServer.loop();
+    // WiFi state, and the access point's polled DNS and config portal
+    if (events & (EVENT_BIT(EVENT_WIFI) | EVENT_BIT(EVENT_NETWORK_POLL))) {
+        wifiManager.loop();
+    }
     
-    // Small delay to prevent watchdog issues
-    delay(1);
-}
\ No newline at end of file
+    // Drain queued HID events that are due
+    hidController.loop();
+    hidBenchmark.loop();
+    hidScript.loop();
+    
+    // Job completions and parked calls
+    if (mcpServer.hasPendingWork()) {
+        mcpServer.pollWork();
+    }
+}
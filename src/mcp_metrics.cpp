@@ -0,0 +1,167 @@
+#include "mcp_metrics.h"
+
+const uint32_t MCPMetrics::BOUNDS_US[MCP_METRICS_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000
+};
+
+#define MCP_COUNTER_NAME(id, name, help) name,
+#define MCP_COUNTER_HELP(id, name, help) help,
+static const char* const COUNTER_NAMES[MCP_COUNTER_COUNT] = { MCP_COUNTERS(MCP_COUNTER_NAME) };
+static const char* const COUNTER_HELP[MCP_COUNTER_COUNT] = { MCP_COUNTERS(MCP_COUNTER_HELP) };
+#undef MCP_COUNTER_NAME
+#undef MCP_COUNTER_HELP
+
+#define MCP_GAUGE_NAME(id, name, help) name,
+#define MCP_GAUGE_HELP(id, name, help) help,
+static const char* const GAUGE_NAMES[MCP_GAUGE_COUNT] = { MCP_GAUGES(MCP_GAUGE_NAME) };
+static const char* const GAUGE_HELP[MCP_GAUGE_COUNT] = { MCP_GAUGES(MCP_GAUGE_HELP) };
+#undef MCP_GAUGE_NAME
+#undef MCP_GAUGE_HELP
+
+static const char* const METHOD_NAMES[MCP_METHOD_COUNT - MCP_TOOL_COUNT] = {
+    "initialize", "tools/list", "batch", "notification", "other"
+};
+
+static const char* const PHASE_NAMES[MCP_PHASE_COUNT] = { "parse", "execute", "send" };
+
+MCPMetrics::MCPMetrics() {
+    reset();
+}
+
+void MCPMetrics::reset() {
+    memset(histograms, 0, sizeof(histograms));
+    memset(counters, 0, sizeof(counters));
+    memset(gauges, 0, sizeof(gauges));
+}
+
+void MCPMetrics::record(uint8_t method, MCPMetricPhase phase, uint32_t us) {
+    if (method >= MCP_METHOD_COUNT) return;
+
+    Histogram& histogram = histograms[method][phase];
+    uint8_t bucket = 0;
+    while (bucket < MCP_METRICS_BUCKETS - 1 && us > BOUNDS_US[bucket]) bucket++;
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.sumUs += us;
+    if (us > histogram.maxUs) histogram.maxUs = us;
+}
+
+const char* MCPMetrics::methodName(uint8_t method) {
+    if (method < MCP_TOOL_COUNT) return toolName(method);
+    return method < MCP_METHOD_COUNT ? METHOD_NAMES[method - MCP_TOOL_COUNT] : "";
+}
+
+int MCPMetrics::findMethod(const char* name) {
+    int tool = findTool(name);
+    if (tool >= 0) return tool;
+    for (uint8_t method = MCP_TOOL_COUNT; method < MCP_METHOD_COUNT; method++) {
+        if (strcmp(METHOD_NAMES[method - MCP_TOOL_COUNT], name) == 0) return method;
+    }
+    return -1;
+}
+
+// Upper bound of the bucket holding the q-th sample, capped by the largest
+// sample seen
+uint32_t MCPMetrics::quantile(const Histogram& histogram, float q) {
+    if (histogram.count == 0) return 0;
+
+    uint32_t target = (uint32_t)(q * histogram.count + 0.5f);
+    if (target == 0) target = 1;
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < MCP_METRICS_BUCKETS - 1; bucket++) {
+        seen += histogram.buckets[bucket];
+        if (seen >= target) return BOUNDS_US[bucket] < histogram.maxUs ? BOUNDS_US[bucket] : histogram.maxUs;
+    }
+    return histogram.maxUs;
+}
+
+void MCPMetrics::describeHistogram(const Histogram& histogram, JsonObject out) {
+    out["count"] = histogram.count;
+    out["sum_us"] = histogram.sumUs;
+    out["max_us"] = histogram.maxUs;
+    out["p50_us"] = quantile(histogram, 0.5f);
+    out["p99_us"] = quantile(histogram, 0.99f);
+    JsonArray buckets = out.createNestedArray("buckets");
+    for (uint8_t bucket = 0; bucket < MCP_METRICS_BUCKETS; bucket++) {
+        buckets.add(histogram.buckets[bucket]);
+    }
+}
+
+void MCPMetrics::report(JsonObject out, int method) const {
+    JsonObject counterOut = out.createNestedObject("counters");
+    for (uint8_t i = 0; i < MCP_COUNTER_COUNT; i++) counterOut[COUNTER_NAMES[i]] = counters[i];
+    JsonObject gaugeOut = out.createNestedObject("gauges");
+    for (uint8_t i = 0; i < MCP_GAUGE_COUNT; i++) gaugeOut[GAUGE_NAMES[i]] = gauges[i];
+
+    if (method >= 0) {
+        JsonArray bounds = out.createNestedArray("bucket_bounds_us");
+        for (uint8_t bucket = 0; bucket < MCP_METRICS_BUCKETS - 1; bucket++) bounds.add(BOUNDS_US[bucket]);
+
+        JsonObject methodOut = out.createNestedObject("latency");
+        methodOut["method"] = methodName(method);
+        for (uint8_t phase = 0; phase < MCP_PHASE_COUNT; phase++) {
+            describeHistogram(histograms[method][phase], methodOut.createNestedObject(PHASE_NAMES[phase]));
+        }
+        return;
+    }
+
+    // p99 per phase of every method that has been called
+    JsonObject latency = out.createNestedObject("latency");
+    for (uint8_t m = 0; m < MCP_METHOD_COUNT; m++) {
+        const Histogram* phases = histograms[m];
+        uint32_t calls = 0;
+        for (uint8_t phase = 0; phase < MCP_PHASE_COUNT; phase++) {
+            if (phases[phase].count > calls) calls = phases[phase].count;
+        }
+        if (calls == 0) continue;
+
+        JsonObject entry = latency.createNestedObject(methodName(m));
+        entry["calls"] = calls;
+        if (phases[MCP_PHASE_PARSE].count) entry["parse_p99_us"] = quantile(phases[MCP_PHASE_PARSE], 0.99f);
+        if (phases[MCP_PHASE_EXECUTE].count) entry["execute_p99_us"] = quantile(phases[MCP_PHASE_EXECUTE], 0.99f);
+        if (phases[MCP_PHASE_SEND].count) entry["send_p99_us"] = quantile(phases[MCP_PHASE_SEND], 0.99f);
+    }
+}
+
+// Microseconds as seconds, the Prometheus base unit
+static void printSeconds(Print& out, uint64_t us) {
+    out.printf("%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+}
+
+void MCPMetrics::writePrometheus(Print& out) const {
+    for (uint8_t i = 0; i < MCP_COUNTER_COUNT; i++) {
+        out.printf("# HELP mcp_%s_total %s\n# TYPE mcp_%s_total counter\nmcp_%s_total %lu\n",
+                   COUNTER_NAMES[i], COUNTER_HELP[i], COUNTER_NAMES[i], COUNTER_NAMES[i],
+                   (unsigned long)counters[i]);
+    }
+    for (uint8_t i = 0; i < MCP_GAUGE_COUNT; i++) {
+        out.printf("# HELP mcp_%s %s\n# TYPE mcp_%s gauge\nmcp_%s %lu\n",
+                   GAUGE_NAMES[i], GAUGE_HELP[i], GAUGE_NAMES[i], GAUGE_NAMES[i],
+                   (unsigned long)gauges[i]);
+    }
+
+    // Series that have never been observed are left out
+    out.print("# HELP mcp_latency_seconds Time to parse, execute and send a request, by method\n"
+              "# TYPE mcp_latency_seconds histogram\n");
+    for (uint8_t m = 0; m < MCP_METHOD_COUNT; m++) {
+        for (uint8_t phase = 0; phase < MCP_PHASE_COUNT; phase++) {
+            const Histogram& histogram = histograms[m][phase];
+            if (histogram.count == 0) continue;
+
+            const char* method = methodName(m);
+            uint32_t cumulative = 0;
+            for (uint8_t bucket = 0; bucket < MCP_METRICS_BUCKETS - 1; bucket++) {
+                cumulative += histogram.buckets[bucket];
+                out.printf("mcp_latency_seconds_bucket{method=\"%s\",phase=\"%s\",le=\"", method, PHASE_NAMES[phase]);
+                printSeconds(out, BOUNDS_US[bucket]);
+                out.printf("\"} %lu\n", (unsigned long)cumulative);
+            }
+            out.printf("mcp_latency_seconds_bucket{method=\"%s\",phase=\"%s\",le=\"+Inf\"} %lu\n",
+                       method, PHASE_NAMES[phase], (unsigned long)histogram.count);
+            out.printf("mcp_latency_seconds_sum{method=\"%s\",phase=\"%s\"} ", method, PHASE_NAMES[phase]);
+            printSeconds(out, histogram.sumUs);
+            out.printf("\nmcp_latency_seconds_count{method=\"%s\",phase=\"%s\"} %lu\n",
+                       method, PHASE_NAMES[phase], (unsigned long)histogram.count);
+        }
+    }
+}
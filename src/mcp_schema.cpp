@@ -0,0 +1,108 @@
+#include "mcp_schema.h"
+#include "mcp_tools.h"
+#include "config.h"
+#include <string.h>
+
+template <size_t N>
+struct SchemaString {
+    char text[N];
+};
+
+// tools/list is generated from the registry in mcp_tools.h. Every property,
+// tool and required name is emitted with a leading comma; the compiler then
+// drops commas that directly follow '{' or '[' outside of strings.
+#define MCP_ARG_SCHEMA(name, type, presence, def, range, desc) \
+    ",\"" #name "\":{" MCP_SCHEMA_##type MCP_SCHEMA_RANGE_##range ",\"description\":\"" desc "\"}"
+#define MCP_REQUIRED_NAME_required(name) ",\"" #name "\""
+#define MCP_REQUIRED_NAME_optional(name) ""
+#define MCP_ARG_REQUIRED_NAME(name, type, presence, def, range, desc) MCP_REQUIRED_NAME_##presence(name)
+#define MCP_TOOL_SCHEMA(id, name, description, ARGS) \
+    ",{\"name\":\"" name "\",\"description\":\"" description "\"," \
+    "\"inputSchema\":{\"type\":\"object\",\"properties\":{" ARGS(MCP_ARG_SCHEMA) "}," \
+    "\"required\":[" ARGS(MCP_ARG_REQUIRED_NAME) "]}}"
+
+template <size_t N>
+constexpr SchemaString<N> dropLeadingCommas(const char (&json)[N]) {
+    SchemaString<N> out = {};
+    size_t n = 0;
+    bool inString = false;
+    for (size_t i = 0; i + 1 < N; i++) {
+        char c = json[i];
+        if (inString) {
+            if (c == '"' && json[i - 1] != '\\') inString = false;
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == ',' && n > 0 && (out.text[n - 1] == '{' || out.text[n - 1] == '[')) {
+            continue;
+        }
+        out.text[n++] = c;
+    }
+    return out;
+}
+
+constexpr size_t schemaLength(const char* text) {
+    size_t length = 0;
+    while (text[length]) length++;
+    return length;
+}
+
+constexpr auto toolsListResult = dropLeadingCommas("{\"tools\":[" MCP_TOOLS(MCP_TOOL_SCHEMA) "]}");
+constexpr size_t toolsListLength = schemaLength(toolsListResult.text);
+
+constexpr uint32_t schemaHash = fnv1a(toolsListResult.text, toolsListLength);
+
+// head + 8 hex digits of hash + tail, evaluated by the compiler
+template <size_t A, size_t B>
+constexpr SchemaString<A + B + 7> spliceHash(const char (&head)[A], uint32_t hash, const char (&tail)[B]) {
+    SchemaString<A + B + 7> out = {};
+    size_t n = 0;
+    for (size_t i = 0; i + 1 < A; i++) out.text[n++] = head[i];
+    for (int shift = 28; shift >= 0; shift -= 4) out.text[n++] = "0123456789abcdef"[(hash >> shift) & 0xf];
+    for (size_t i = 0; i < B; i++) out.text[n++] = tail[i];
+    return out;
+}
+
+// credits is the flow-control allowance of every session (MCPServer)
+#define MCP_INITIALIZE_HEAD \
+    "{\"protocolVersion\":\"" MCP_PROTOCOL_VERSION "\"," \
+    "\"serverInfo\":{\"name\":\"" MCP_IMPLEMENTATION_NAME "\",\"version\":\"" MCP_IMPLEMENTATION_VERSION "\"}," \
+    "\"capabilities\":{\"tools\":true}," \
+    "\"credits\":{\"bytes\":" MCP_NUMBER_TEXT(MCP_CREDIT_BYTES) ",\"jobs\":" MCP_NUMBER_TEXT(MCP_JOB_QUEUE_SIZE) "}," \
+    "\"schemaHash\":\""
+
+#define MCP_INITIALIZE_RESULT_FOR(id, name) \
+    constexpr auto initializeResult_##id = spliceHash(MCP_INITIALIZE_HEAD, schemaHash, \
+                                                      "\",\"verbosity\":\"" name "\"}");
+MCP_VERBOSITY_LEVELS(MCP_INITIALIZE_RESULT_FOR)
+#undef MCP_INITIALIZE_RESULT_FOR
+
+#define MCP_INITIALIZE_TEXT(id, name) initializeResult_##id.text,
+#define MCP_INITIALIZE_LENGTH(id, name) sizeof(initializeResult_##id.text) - 1,
+const char* const MCP_INITIALIZE_RESULTS[MCP_VERBOSITY_COUNT] = { MCP_VERBOSITY_LEVELS(MCP_INITIALIZE_TEXT) };
+const size_t MCP_INITIALIZE_RESULT_LENGTHS[MCP_VERBOSITY_COUNT] = { MCP_VERBOSITY_LEVELS(MCP_INITIALIZE_LENGTH) };
+#undef MCP_INITIALIZE_TEXT
+#undef MCP_INITIALIZE_LENGTH
+// Flash results are sent from MCPServer's send buffer in one piece; a tool
+// schema that outgrows it would make every tools/list fail
+static_assert(toolsListLength + MCP_RESULT_ENVELOPE_SIZE < MCP_SEND_BUFFER_SIZE,
+              "tools/list result does not fit MCP_SEND_BUFFER_SIZE");
+#define MCP_INITIALIZE_FITS(id, name) \
+    static_assert(sizeof(initializeResult_##id.text) + MCP_RESULT_ENVELOPE_SIZE < MCP_SEND_BUFFER_SIZE, \
+                  "initialize result does not fit MCP_SEND_BUFFER_SIZE");
+MCP_VERBOSITY_LEVELS(MCP_INITIALIZE_FITS)
+#undef MCP_INITIALIZE_FITS
+
+const char* const MCP_TOOLS_LIST_RESULT = toolsListResult.text;
+const size_t MCP_TOOLS_LIST_RESULT_LENGTH = toolsListLength;
+const uint32_t MCP_SCHEMA_HASH = schemaHash;
+
+#define MCP_VERBOSITY_NAME(id, name) name,
+static const char* const VERBOSITY_NAMES[MCP_VERBOSITY_COUNT] = { MCP_VERBOSITY_LEVELS(MCP_VERBOSITY_NAME) };
+#undef MCP_VERBOSITY_NAME
+
+int verbosityFromName(const char* name) {
+    for (uint8_t level = 0; level < MCP_VERBOSITY_COUNT; level++) {
+        if (strcmp(VERBOSITY_NAMES[level], name) == 0) return level;
+    }
+    return -1;
+}
@@ -1,15 +1,30 @@
 #include "mcp_server.h"
 #include "config.h"
+#include "mcp_schema.h"
 
 // Static instance for callback
 MCPServer* MCPServer::instance = nullptr;
 
-MCPServer::MCPServer(WebSocketsServer* ws) : webSocket(ws), hidController(nullptr), isInitialized(false) {
+MCPServer::MCPServer(WebSocketsServer* ws)
+    : webSocket(ws), hidController(nullptr), hidBenchmark(nullptr), hidScript(nullptr), hidSequences(nullptr),
+      eventLoop(nullptr), isInitialized(false),
+      nextJobId(1), callingClient(0), callVerbosity(MCP_DEFAULT_VERBOSITY), jsonWire(), binaryWire(),
+      metricMethod(MCP_METHOD_OTHER), metricsHttp(nullptr), hidOwner(0), hidOwnerSequence(0),
+      auth(API_KEY) {
     instance = this;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        parked[i].length = 0;
+        sessionVerbosity[i] = MCP_DEFAULT_VERBOSITY;
+        arenas[i].requestPeak = 0;
+        arenas[i].responsePeak = 0;
+        arenas[i].overflows = 0;
+        resetJobs(i);
+    }
 }
 
 MCPServer::~MCPServer() {
     instance = nullptr;
+    delete metricsHttp;
 }
 
 bool MCPServer::begin() {
@@ -22,21 +37,68 @@ bool MCPServer::begin() {
     webSocket->onEvent(webSocketEventWrapper);
     webSocket->enableHeartbeat(15000, 3000, 2);
     
+    if (MCP_METRICS_PORT) {
+        metricsHttp = new WebServer(MCP_METRICS_PORT);
+        static const char* METRICS_HEADERS[] = {"Authorization"};
+        metricsHttp->collectHeaders(METRICS_HEADERS, 1);
+        metricsHttp->on("/metrics", HTTP_GET, [this]() { handleMetricsHttp(); });
+        metricsHttp->begin();
+        DEBUG_PRINTF("Metrics on port %d\n", MCP_METRICS_PORT);
+    }
+    
     isInitialized = true;
     DEBUG_PRINTLN("MCP Server started");
     return true;
 }
 
 void MCPServer::loop() {
+    pollNetwork();
+    pollWork();
+}
+
+void MCPServer::pollNetwork() {
     if (isInitialized) {
         webSocket->loop();
+        if (metricsHttp) metricsHttp->handleClient();
+    }
+}
+
+void MCPServer::pollWork() {
+    if (isInitialized) {
+        pollJobs();
+        dispatchParked();
+    }
+}
+
+bool MCPServer::hasPendingWork() {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (jobQueues[i].pending > 0 || parked[i].length > 0) return true;
     }
+    return false;
 }
 
 void MCPServer::setHIDController(HIDController* controller) {
     hidController = controller;
 }
 
+void MCPServer::setHIDBenchmark(HIDBenchmark* benchmark) {
+    hidBenchmark = benchmark;
+    if (benchmark) benchmark->setTurnGate(hidTurnGate, hidTurnNotice, this);
+}
+
+void MCPServer::setHIDScript(HIDScript* script) {
+    hidScript = script;
+    if (script) script->setTurnGate(hidTurnGate, hidTurnNotice, this);
+}
+
+void MCPServer::setHIDSequences(HIDSequenceStore* sequences) {
+    hidSequences = sequences;
+}
+
+void MCPServer::setEventLoop(EventLoop* loop) {
+    eventLoop = loop;
+}
+
 void MCPServer::webSocketEventWrapper(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
     if (instance) {
         instance->handleWebSocketEvent(num, type, payload, length);
@@ -47,15 +109,45 @@ void MCPServer::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t* payloa
     switch (type) {
         case WStype_DISCONNECTED:
             DEBUG_PRINTF("Client %d disconnected\n", num);
+            metrics.count(MCP_COUNTER_DISCONNECTS);
+            if (num < MAX_CLIENTS) {
+                resetJobs(num);
+                arbiter.disconnect(num);
+                auth.reset(num);
+                parked[num].length = 0;
+            }
             break;
             
         case WStype_CONNECTED:
             DEBUG_PRINTF("Client %d connected from %s\n", num, webSocket->remoteIP(num).toString().c_str());
+            // The library refuses sockets beyond WEBSOCKETS_SERVER_CLIENT_MAX;
+            // a lower MAX_CLIENTS is enforced here, before any client state
+            if (num >= MAX_CLIENTS) {
+                DEBUG_PRINTF("Client %d over MAX_CLIENTS, refused\n", num);
+                webSocket->disconnect(num);
+                break;
+            }
+            metrics.count(MCP_COUNTER_CONNECTIONS);
+            resetJobs(num);
+            sessionVerbosity[num] = MCP_DEFAULT_VERBOSITY;
+            arbiter.connect(num, millis());
+            auth.reset(num);
+            parked[num].length = 0;
             break;
             
         case WStype_TEXT:
+            if (hidBenchmark) hidBenchmark->frameStarted(micros());
             DEBUG_PRINTF("Received message from client %d: %s\n", num, (char*)payload);
-            handleMCPMessage(num, String((char*)payload));
+            metrics.count(MCP_COUNTER_BYTES_IN, length);
+            handleMCPMessage(num, payload, length);
+            if (hidBenchmark) hidBenchmark->frameFinished();
+            break;
+            
+        case WStype_BIN:
+            if (hidBenchmark) hidBenchmark->frameStarted(micros());
+            metrics.count(MCP_COUNTER_BYTES_IN, length);
+            handleWireFrame(num, payload, length);
+            if (hidBenchmark) hidBenchmark->frameFinished();
             break;
             
         case WStype_ERROR:
@@ -67,243 +159,864 @@ void MCPServer::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t* payloa
     }
 }
 
-void MCPServer::handleMCPMessage(uint8_t clientId, const String& message) {
-    DynamicJsonDocument request(JSON_DOC_SIZE);
-    DeserializationError error = deserializeJson(request, message);
+void MCPServer::handleMCPMessage(uint8_t clientId, uint8_t* payload, size_t length) {
+    if (clientId >= MAX_CLIENTS) {
+        DEBUG_PRINTF("Client %d has no arena slot\n", clientId);
+        webSocket->disconnect(clientId);
+        return;
+    }
+    ClientArena& arena = arenas[clientId];
+    
+    // A frame starting with '[' is a JSON-RPC batch
+    size_t start = 0;
+    while (start < length && isspace(payload[start])) start++;
+    bool batch = start < length && payload[start] == '[';
+    
+    // Only the JSON-RPC envelope is materialised; anything else in the
+    // message is skipped by the parser. For a batch, filter[0] applies to
+    // every element.
+    StaticJsonDocument<96> filter;
+    JsonVariant fields = batch ? filter.add() : filter.to<JsonVariant>();
+    fields["jsonrpc"] = true;
+    fields["id"] = true;
+    fields["method"] = true;
+    fields["params"] = true;
+    fields["session"] = true;
+    
+    // Parsing from a mutable char* is ArduinoJson's zero-copy mode: strings
+    // are terminated in place in the WebSocket payload instead of duplicated
+    JsonDocument& request = arena.request;
+    unsigned long parseStart = micros();
+    DeserializationError error = deserializeJson(request, (char*)payload, length,
+                                                 DeserializationOption::Filter(filter));
+    uint32_t parseUs = micros() - parseStart;
+    jsonWire.parseUs += parseUs;
+    jsonWire.frames++;
+    jsonWire.bytes += length;
+    if (request.memoryUsage() > arena.requestPeak) {
+        arena.requestPeak = request.memoryUsage();
+    }
+    metrics.count(MCP_COUNTER_REQUESTS);
+    metricMethod = MCP_METHOD_OTHER;
     
     if (error) {
+        metrics.record(MCP_METHOD_OTHER, MCP_PHASE_PARSE, parseUs);
         DEBUG_PRINTF("JSON parsing failed: %s\n", error.c_str());
-        sendMCPError(clientId, 0, "Invalid JSON");
+        if (error == DeserializationError::NoMemory) {
+            arena.overflows++;
+            sendMCPError(clientId, JsonVariantConst(), "Request too large");
+        } else {
+            sendMCPError(clientId, JsonVariantConst(), "Invalid JSON");
+        }
+        return;
+    }
+    
+    if (!authorize(clientId, request, batch)) {
+        metrics.record(MCP_METHOD_OTHER, MCP_PHASE_PARSE, parseUs);
+        return;
+    }
+    
+    if (batch) {
+        jsonWire.events += request.size();
+        metricMethod = MCP_METHOD_BATCH;
+        metrics.record(MCP_METHOD_BATCH, MCP_PHASE_PARSE, parseUs);
+        uint32_t credit = 0;
+        if (takeCredit(clientId, request, true, length, credit)) {
+            uint32_t jobsBefore = nextJobId;
+            handleBatch(clientId, request.as<JsonArrayConst>());
+            settleCredit(clientId, jobsBefore, credit);
+        }
         return;
     }
+    jsonWire.events++;
     
-    String method = request["method"];
-    int requestId = request["id"] | 0;
+    const char* method = request["method"] | "";
+    JsonVariantConst requestId = request["id"];
     
-    if (method == "initialize") {
+    if (strcmp(method, "initialize") == 0) {
+        metricMethod = MCP_METHOD_INITIALIZE;
         handleInitialize(clientId, request);
-    } else if (method == "tools/list") {
+    } else if (strcmp(method, "tools/list") == 0) {
+        metricMethod = MCP_METHOD_TOOLS_LIST;
         handleListTools(clientId, request);
-    } else if (method == "tools/call") {
-        handleCallTool(clientId, request);
+    } else if (strcmp(method, "tools/call") == 0) {
+        // handleCallTool sets metricMethod to the tool
+        uint32_t credit = 0;
+        if (takeCredit(clientId, request, false, length, credit) && !parkCall(clientId, request, credit)) {
+            uint32_t jobsBefore = nextJobId;
+            handleCallTool(clientId, beginResponse(clientId, requestId), request.as<JsonObjectConst>());
+            sendMCPResponse(clientId);
+            settleCredit(clientId, jobsBefore, credit);
+        }
     } else {
-        sendMCPError(clientId, requestId, "Unknown method: " + method);
+        sendMCPError(clientId, requestId, String("Unknown method: ") + method);
     }
+    metrics.record(metricMethod, MCP_PHASE_PARSE, parseUs);
 }
 
-void MCPServer::sendMCPResponse(uint8_t clientId, const DynamicJsonDocument& response) {
-    String responseStr;
-    serializeJson(response, responseStr);
-    webSocket->sendTXT(clientId, responseStr);
-    DEBUG_PRINTF("Sent response to client %d: %s\n", clientId, responseStr.c_str());
+// Runs the calls of a batch in order and answers with one array holding
+// an entry per call, successful or not. Notifications (calls without an
+// id) run but get no entry, as JSON-RPC 2.0 requires.
+void MCPServer::handleBatch(uint8_t clientId, JsonArrayConst calls) {
+    if (calls.size() == 0) {
+        sendMCPError(clientId, JsonVariantConst(), "Invalid Request: empty batch", -32600);
+        return;
+    }
+    
+    JsonDocument& response = arenas[clientId].response;
+    response.clear();
+    JsonArray entries = response.to<JsonArray>();
+    
+    for (JsonVariantConst call : calls) {
+        // Stop once the response arena is full; sendMCPResponse reports it
+        if (response.overflowed()) break;
+        
+        JsonObject entry = entries.createNestedObject();
+        entry["jsonrpc"] = "2.0";
+        entry["id"] = call["id"];
+        
+        const char* method = call["method"] | "";
+        if (!call.is<JsonObjectConst>()) {
+            setError(entry, -32600, "Invalid Request");
+        } else if (strcmp(method, "initialize") == 0) {
+            uint8_t level = negotiateVerbosity(clientId, call["params"]);
+            entry["result"] = serialized(MCP_INITIALIZE_RESULTS[level], MCP_INITIALIZE_RESULT_LENGTHS[level]);
+        } else if (strcmp(method, "tools/list") == 0) {
+            entry["result"] = serialized(MCP_TOOLS_LIST_RESULT, MCP_TOOLS_LIST_RESULT_LENGTH);
+        } else if (strcmp(method, "tools/call") == 0) {
+            handleCallTool(clientId, entry, call.as<JsonObjectConst>());
+        } else {
+            setError(entry, -32000, String("Unknown method: ") + method);
+        }
+        
+        if (call.is<JsonObjectConst>() && !call.containsKey("id")) {
+            entries.remove(entries.size() - 1);
+        }
+    }
+    
+    metricMethod = MCP_METHOD_BATCH;
+    if (entries.size() > 0 || response.overflowed()) {
+        sendMCPResponse(clientId);
+    }
 }
 
-void MCPServer::sendMCPError(uint8_t clientId, int requestId, const String& error) {
-    DynamicJsonDocument response(512);
+// Clears the client's response arena and starts the JSON-RPC envelope
+JsonObject MCPServer::beginResponse(uint8_t clientId, JsonVariantConst id) {
+    JsonDocument& response = arenas[clientId].response;
+    response.clear();
     response["jsonrpc"] = "2.0";
-    response["id"] = requestId;
-    response["error"]["code"] = -32000;
-    response["error"]["message"] = error;
-    sendMCPResponse(clientId, response);
+    response["id"] = id;
+    return response.as<JsonObject>();
 }
 
-void MCPServer::handleInitialize(uint8_t clientId, const DynamicJsonDocument& request) {
-    DynamicJsonDocument response(1024);
-    response["jsonrpc"] = "2.0";
-    response["id"] = request["id"];
+void MCPServer::sendMCPResponse(uint8_t clientId) {
+    unsigned long sendStart = micros();
+    ClientArena& arena = arenas[clientId];
+    JsonDocument& response = arena.response;
+    if (response.memoryUsage() > arena.responsePeak) {
+        arena.responsePeak = response.memoryUsage();
+    }
+    if (response.overflowed()) {
+        // Members that did not fit were dropped; never send a partial result
+        arena.overflows++;
+        // The id lives in the arena the error is built in, so copy it out
+        // first; a string id is normally still linked to the request
+        StaticJsonDocument<JSON_STRING_SIZE(MCP_JOB_ID_SIZE)> id;
+        id.set(response["id"]);
+        sendMCPError(clientId, id.as<JsonVariantConst>(), "Response too large");
+        return;
+    }
     
-    JsonObject result = response.createNestedObject("result");
-    result["protocolVersion"] = MCP_PROTOCOL_VERSION;
-    result["serverInfo"]["name"] = MCP_IMPLEMENTATION_NAME;
-    result["serverInfo"]["version"] = MCP_IMPLEMENTATION_VERSION;
+    size_t length = measureJson(response);
+    if (length >= MCP_SEND_BUFFER_SIZE) {
+        // Too big for the send buffer; fall back to a heap String
+        DEBUG_PRINTF("Response of %u bytes exceeds send buffer\n", (unsigned)length);
+        String responseStr;
+        serializeJson(response, responseStr);
+        webSocket->sendTXT(clientId, responseStr);
+        metrics.count(MCP_COUNTER_BYTES_OUT, length);
+        metrics.record(metricMethod, MCP_PHASE_SEND, micros() - sendStart);
+        return;
+    }
     
-    JsonObject capabilities = result.createNestedObject("capabilities");
-    capabilities["tools"] = true;
+    char* payload = (char*)sendBuffer + WEBSOCKETS_MAX_HEADER_SIZE;
+    serializeJson(response, payload, MCP_SEND_BUFFER_SIZE);
+    // headerToPayload: the frame header is written into the reserved bytes
+    // in front of the payload, so the library sends it without copying
+    webSocket->sendTXT(clientId, (uint8_t*)payload, length, true);
+    metrics.count(MCP_COUNTER_BYTES_OUT, length);
+    metrics.record(metricMethod, MCP_PHASE_SEND, micros() - sendStart);
+    DEBUG_PRINTF("Sent response to client %d: %s\n", clientId, payload);
+}
+
+void MCPServer::sendMCPError(uint8_t clientId, JsonVariantConst id, const String& error, int code) {
+    setError(beginResponse(clientId, id), code, error);
+    sendMCPResponse(clientId);
+}
+
+// Replaces whatever result a response holds with a JSON-RPC error
+void MCPServer::setError(JsonObject response, int code, const String& error) {
+    metrics.count(MCP_COUNTER_ERRORS);
+    response.remove("result");
+    JsonObject body = response.createNestedObject("error");
+    body["code"] = code;
+    body["message"] = error;
+}
+
+// Queues the records of a binary frame. The frame is decoded once up front
+// so a malformed one is rejected before any of it reaches the HID queue;
+// only a full queue can stop a frame part way.
+void MCPServer::handleWireFrame(uint8_t clientId, const uint8_t* payload, size_t length) {
+    unsigned long parseStart = micros();
+    HIDWireDecoder check(payload, length);
+    HIDWireEvent event;
+    uint32_t events = 0;
+    while (check.next(event)) events++;
+    binaryWire.parseUs += micros() - parseStart;
+    binaryWire.frames++;
+    binaryWire.bytes += length;
+    binaryWire.events += events;
+    
+    if (check.status() != HID_WIRE_OK) {
+        sendWireError(clientId, check.status(), check.offset());
+        return;
+    }
+    if (!hidController || clientId >= MAX_CLIENTS) {
+        sendWireError(clientId, HID_WIRE_QUEUE_FULL, 0);
+        return;
+    }
+    // Binary frames carry no token; they are accepted on a connection
+    // whose slot completed the handshake, which is what tokens are bound to
+    if (ENABLE_AUTHENTICATION && !auth.isAuthenticated(clientId)) {
+        metrics.count(MCP_COUNTER_AUTH_FAILURES);
+        sendWireError(clientId, HID_WIRE_UNAUTHORIZED, 0);
+        return;
+    }
     
-    sendMCPResponse(clientId, response);
+    // A frame costs a token per event
+    uint32_t retryMs = 0;
+    HIDAccess access = arbiter.admit(clientId, events > UINT16_MAX ? UINT16_MAX : events, millis(), retryMs);
+    if (access != HID_ACCESS_OK) {
+        bool leased = access == HID_ACCESS_LEASED;
+        metrics.count(leased ? MCP_COUNTER_LEASE_DENIED : MCP_COUNTER_RATE_LIMITED);
+        sendWireError(clientId, leased ? HID_WIRE_LEASED : HID_WIRE_RATE_LIMITED, 0);
+        return;
+    }
+    
+    uint32_t before = hidController->sequence();
+    HIDWireDecoder decoder(payload, length);
+    size_t offset = decoder.offset();
+    while (decoder.next(event)) {
+        HIDWireStatus status = applyWireEvent(event);
+        if (status != HID_WIRE_OK) {
+            sendWireError(clientId, status, offset);
+            break;
+        }
+        offset = decoder.offset();
+    }
+    if (hidController->sequence() != before) noteHIDOwner(clientId);
 }
 
-void MCPServer::handleListTools(uint8_t clientId, const DynamicJsonDocument& request) {
-    DynamicJsonDocument response(JSON_DOC_SIZE);
-    response["jsonrpc"] = "2.0";
-    response["id"] = request["id"];
+HIDWireStatus MCPServer::applyWireEvent(const HIDWireEvent& event) {
+    bool ok = false;
+    switch (event.opcode) {
+        case HID_WIRE_KEY_DOWN:
+            ok = hidController->pressKey(event.key.usage, event.key.modifiers);
+            break;
+        case HID_WIRE_KEY_UP:
+            ok = hidController->releaseKey(event.key.usage, event.key.modifiers);
+            break;
+        case HID_WIRE_RELEASE_ALL:
+            ok = hidController->releaseAllKeys();
+            break;
+        case HID_WIRE_TEXT: {
+            uint8_t layout = event.text.layout < KEYBOARD_LAYOUT_COUNT ? event.text.layout : KEYBOARD_LAYOUT;
+            ok = hidController->typeText(event.text.data, event.text.length, layout, HID_TYPE_DELAY_MS);
+            break;
+        }
+        case HID_WIRE_MOVE:
+            ok = hidController->moveMouse(event.move.x, event.move.y, true);
+            break;
+        case HID_WIRE_MOVE_ABSOLUTE:
+            ok = hidController->moveMouse(event.position.x, event.position.y, false);
+            break;
+        case HID_WIRE_BUTTON_DOWN:
+            ok = hidController->pressMouse(event.buttons);
+            break;
+        case HID_WIRE_BUTTON_UP:
+            ok = hidController->releaseMouse(event.buttons);
+            break;
+        case HID_WIRE_SCROLL:
+            ok = hidController->scrollMouse(event.scroll);
+            break;
+        case HID_WIRE_DELAY:
+            ok = hidController->pause(event.delay);
+            break;
+        case HID_WIRE_REPLAY: {
+            const char* error = "";
+            if (!hidSequences || !hidSequences->replay("", event.contentHash, HID_TYPE_DELAY_MS, error)) {
+                return HID_WIRE_REPLAY_FAILED;
+            }
+            ok = true;
+            break;
+        }
+    }
+    return ok ? HID_WIRE_OK : HID_WIRE_QUEUE_FULL;
+}
 
-    JsonObject result = response.createNestedObject("result");
-    JsonArray tools = result.createNestedArray("tools");
-
-    // Keyboard Type Tool
-    JsonObject keyboardType = tools.createNestedObject();
-    keyboardType["name"] = TOOL_KEYBOARD_TYPE;
-    keyboardType["description"] = "Type text using the keyboard";
-    JsonObject keyboardTypeSchema = keyboardType.createNestedObject("inputSchema");
-    keyboardTypeSchema["type"] = "object";
-    JsonObject keyboardTypeProps = keyboardTypeSchema.createNestedObject("properties");
-    JsonObject textProp = keyboardTypeProps.createNestedObject("text");
-    textProp["type"] = "string";
-    textProp["description"] = "Text to type";
-    JsonArray keyboardTypeRequired = keyboardTypeSchema.createNestedArray("required");
-    keyboardTypeRequired.add("text");
-    
-    // Keyboard Key Tool
-    JsonObject keyboardKey = tools.createNestedObject();
-    keyboardKey["name"] = TOOL_KEYBOARD_KEY;
-    keyboardKey["description"] = "Press a specific key or key combination";
-    JsonObject keyboardKeySchema = keyboardKey.createNestedObject("inputSchema");
-    keyboardKeySchema["type"] = "object";
-    JsonObject keyboardKeyProps = keyboardKeySchema.createNestedObject("properties");
-    JsonObject keyProp = keyboardKeyProps.createNestedObject("key");
-    keyProp["type"] = "string";
-    keyProp["description"] = "Key to press (e.g., 'a', 'Enter', 'F1')";
-    JsonObject modifiersProp = keyboardKeyProps.createNestedObject("modifiers");
-    modifiersProp["type"] = "string";
-    modifiersProp["description"] = "Modifier keys (ctrl, shift, alt, gui)";
-    JsonArray keyboardKeyRequired = keyboardKeySchema.createNestedArray("required");
-    keyboardKeyRequired.add("key");
-
-    // Keyboard Shortcut Tool
-    JsonObject keyboardShortcut = tools.createNestedObject();
-    keyboardShortcut["name"] = TOOL_KEYBOARD_SHORTCUT;
-    keyboardShortcut["description"] = "Send a keyboard shortcut combination";
-    JsonObject keyboardShortcutSchema = keyboardShortcut.createNestedObject("inputSchema");
-    keyboardShortcutSchema["type"] = "object";
-    JsonObject keyboardShortcutProps = keyboardShortcutSchema.createNestedObject("properties");
-    JsonObject shortcutProp = keyboardShortcutProps.createNestedObject("shortcut");
-    shortcutProp["type"] = "string";
-    shortcutProp["description"] = "Shortcut in ctrl+alt+delete format";
-    JsonArray keyboardShortcutRequired = keyboardShortcutSchema.createNestedArray("required");
-    keyboardShortcutRequired.add("shortcut");
-    
-    // Mouse Move Tool
-    JsonObject mouseMove = tools.createNestedObject();
-    mouseMove["name"] = TOOL_MOUSE_MOVE;
-    mouseMove["description"] = "Move the mouse cursor";
-    JsonObject mouseMoveSchema = mouseMove.createNestedObject("inputSchema");
-    mouseMoveSchema["type"] = "object";
-    JsonObject mouseMoveProps = mouseMoveSchema.createNestedObject("properties");
-    JsonObject xProp = mouseMoveProps.createNestedObject("x");
-    xProp["type"] = "integer";
-    xProp["description"] = "X coordinate or relative movement";
-    JsonObject yProp = mouseMoveProps.createNestedObject("y");
-    yProp["type"] = "integer";
-    yProp["description"] = "Y coordinate or relative movement";
-    JsonObject relativeProp = mouseMoveProps.createNestedObject("relative");
-    relativeProp["type"] = "boolean";
-    relativeProp["description"] = "Whether movement is relative (default: true)";
-    JsonArray mouseMoveRequired = mouseMoveSchema.createNestedArray("required");
-    mouseMoveRequired.add("x");
-    mouseMoveRequired.add("y");
-    
-    // Mouse Click Tool
-    JsonObject mouseClick = tools.createNestedObject();
-    mouseClick["name"] = TOOL_MOUSE_CLICK;
-    mouseClick["description"] = "Click mouse button";
-    JsonObject mouseClickSchema = mouseClick.createNestedObject("inputSchema");
-    mouseClickSchema["type"] = "object";
-    JsonObject mouseClickProps = mouseClickSchema.createNestedObject("properties");
-    JsonObject buttonProp = mouseClickProps.createNestedObject("button");
-    buttonProp["type"] = "string";
-    buttonProp["description"] = "Mouse button (left, right, middle)";
-    JsonObject durationProp = mouseClickProps.createNestedObject("duration");
-    durationProp["type"] = "integer";
-    durationProp["description"] = "Click duration in milliseconds";
-    
-    // Mouse Scroll Tool
-    JsonObject mouseScroll = tools.createNestedObject();
-    mouseScroll["name"] = TOOL_MOUSE_SCROLL;
-    mouseScroll["description"] = "Scroll the mouse wheel";
-    JsonObject mouseScrollSchema = mouseScroll.createNestedObject("inputSchema");
-    mouseScrollSchema["type"] = "object";
-    JsonObject mouseScrollProps = mouseScrollSchema.createNestedObject("properties");
-    JsonObject scrollProp = mouseScrollProps.createNestedObject("scroll");
-    scrollProp["type"] = "integer";
-    scrollProp["description"] = "Scroll amount (positive = up, negative = down)";
-    JsonArray mouseScrollRequired = mouseScrollSchema.createNestedArray("required");
-    mouseScrollRequired.add("scroll");
-    
-    // System Status Tool
-    JsonObject systemStatus = tools.createNestedObject();
-    systemStatus["name"] = TOOL_SYSTEM_STATUS;
-    systemStatus["description"] = "Get system status information";
-    JsonObject systemStatusSchema = systemStatus.createNestedObject("inputSchema");
-    systemStatusSchema["type"] = "object";
-    systemStatusSchema.createNestedObject("properties");
-    
-    sendMCPResponse(clientId, response);
-}
-
-void MCPServer::handleCallTool(uint8_t clientId, const DynamicJsonDocument& request) {
-    String toolName = request["params"]["name"];
-    JsonVariantConst args = request["params"]["args"];
-    int requestId = request["id"] | 0;
+void MCPServer::sendWireError(uint8_t clientId, HIDWireStatus status, size_t offset) {
+    uint8_t* frame = sendBuffer + WEBSOCKETS_MAX_HEADER_SIZE;
+    frame[0] = HID_WIRE_ERROR;
+    frame[1] = status;
+    frame[2] = offset & 0xff;
+    frame[3] = (offset >> 8) & 0xff;
+    webSocket->sendBIN(clientId, frame, 4, true);
+    metrics.count(MCP_COUNTER_WIRE_ERRORS);
+    metrics.count(MCP_COUNTER_BYTES_OUT, 4);
+}
+
+// Gauges, and counters kept outside MCPMetrics, read just before export
+void MCPServer::sampleMetrics() {
+    uint32_t pendingJobs = 0;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) pendingJobs += jobQueues[i].pending;
+    metrics.setGauge(MCP_GAUGE_CLIENTS, webSocket->connectedClients());
+    metrics.setGauge(MCP_GAUGE_PENDING_JOBS, pendingJobs);
+    metrics.setGauge(MCP_GAUGE_FREE_HEAP, ESP.getFreeHeap());
+    if (hidController) {
+        metrics.setGauge(MCP_GAUGE_HID_QUEUE_DEPTH, hidController->pendingEvents());
+        metrics.setCounter(MCP_COUNTER_HID_REPORTS, hidController->reportsSent());
+    }
+}
+
+// Buffers Prometheus text into chunks of the response, so the exposition
+// is never held in memory whole
+class MetricsChunkWriter : public Print {
+private:
+    WebServer& server;
+    char buffer[512];
+    size_t used;
     
-    if (!hidController) {
-        sendMCPError(clientId, requestId, "HID controller not available");
+public:
+    MetricsChunkWriter(WebServer& http) : server(http), used(0) {}
+    
+    size_t write(uint8_t c) override {
+        if (used == sizeof(buffer)) flush();
+        buffer[used++] = c;
+        return 1;
+    }
+    
+    void flush() override {
+        if (used) server.sendContent(buffer, used);
+        used = 0;
+    }
+};
+
+// With ENABLE_AUTHENTICATION a scrape needs the metrics bearer token
+// (session_auth.h); the counters show how the device is being driven
+void MCPServer::handleMetricsHttp() {
+    if (ENABLE_AUTHENTICATION && !auth.checkMetricsBearer(metricsHttp->header("Authorization").c_str())) {
+        metricsHttp->sendHeader("WWW-Authenticate", "Bearer");
+        metricsHttp->send(401, "text/plain", "Unauthorized\n");
+        return;
+    }
+    sampleMetrics();
+    metricsHttp->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    metricsHttp->send(200, "text/plain; version=0.0.4", "");
+    MetricsChunkWriter writer(*metricsHttp);
+    metrics.writePrometheus(writer);
+    writer.flush();
+    // Zero-length chunk ends the response
+    metricsHttp->sendContent("");
+}
+
+void MCPServer::reportWireStats(const WireStats& stats, JsonObject out) {
+    out["frames"] = stats.frames;
+    out["events"] = stats.events;
+    out["bytes"] = stats.bytes;
+    out["parse_us"] = stats.parseUs;
+    if (stats.events) {
+        out["bytes_per_event"] = (float)stats.bytes / stats.events;
+        out["parse_us_per_event"] = (float)stats.parseUs / stats.events;
+    }
+}
+
+// A session token, when given, is added as the last member of the result
+// object, which is assumed to end with its closing brace
+void MCPServer::sendResultResponse(uint8_t clientId, JsonVariantConst id, const char* result, size_t resultLength,
+                                   const char* session) {
+    unsigned long sendStart = micros();
+    static const char head[] = "{\"jsonrpc\":\"2.0\",\"id\":";
+    static const char middle[] = ",\"result\":";
+    static const char sessionHead[] = ",\"session\":\"";
+    
+    size_t idLength = measureJson(id);
+    size_t sessionLength = session ? strlen(session) : 0;
+    size_t length = sizeof(head) - 1 + idLength + sizeof(middle) - 1 + resultLength + 1;
+    if (session) length += sizeof(sessionHead) - 1 + sessionLength + 1;
+    if (length >= MCP_SEND_BUFFER_SIZE) {
+        DEBUG_PRINTF("Response of %u bytes exceeds send buffer\n", (unsigned)length);
+        sendMCPError(clientId, id, "Response too large");
         return;
     }
     
-    DynamicJsonDocument result(1024);
-    
-    if (toolName == TOOL_KEYBOARD_TYPE) {
-        result = executeKeyboardType(args);
-    } else if (toolName == TOOL_KEYBOARD_KEY) {
-        result = executeKeyboardKey(args);
-    } else if (toolName == TOOL_KEYBOARD_SHORTCUT) {
-        result = executeKeyboardShortcut(args);
-    } else if (toolName == TOOL_MOUSE_MOVE) {
-        result = executeMouseMove(args);
-    } else if (toolName == TOOL_MOUSE_CLICK) {
-        result = executeMouseClick(args);
-    } else if (toolName == TOOL_MOUSE_SCROLL) {
-        result = executeMouseScroll(args);
-    } else if (toolName == TOOL_SYSTEM_STATUS) {
-        result = executeSystemStatus(args);
+    char* payload = (char*)sendBuffer + WEBSOCKETS_MAX_HEADER_SIZE;
+    char* out = payload;
+    memcpy(out, head, sizeof(head) - 1);
+    out += sizeof(head) - 1;
+    out += serializeJson(id, out, idLength + 1);
+    memcpy(out, middle, sizeof(middle) - 1);
+    out += sizeof(middle) - 1;
+    if (session) {
+        memcpy(out, result, resultLength - 1);
+        out += resultLength - 1;
+        memcpy(out, sessionHead, sizeof(sessionHead) - 1);
+        out += sizeof(sessionHead) - 1;
+        memcpy(out, session, sessionLength);
+        out += sessionLength;
+        *out++ = '"';
+        *out++ = '}';
     } else {
-        sendMCPError(clientId, requestId, "Unknown tool: " + toolName);
+        memcpy(out, result, resultLength);
+        out += resultLength;
+    }
+    *out++ = '}';
+    
+    webSocket->sendTXT(clientId, (uint8_t*)payload, out - payload, true);
+    metrics.count(MCP_COUNTER_BYTES_OUT, out - payload);
+    metrics.record(metricMethod, MCP_PHASE_SEND, micros() - sendStart);
+}
+
+void MCPServer::handleInitialize(uint8_t clientId, const JsonDocument& request) {
+    const char* session = nullptr;
+    if (ENABLE_AUTHENTICATION) {
+        // First initialize: refuse with a challenge. Second: check the
+        // answer and hand out the session token with the result.
+        JsonVariantConst answer = request["params"]["auth"]["response"];
+        if (answer.isNull()) {
+            char challenge[AUTH_CHALLENGE_SIZE * 2 + 1];
+            auth.challenge(clientId, challenge);
+            JsonObject response = beginResponse(clientId, request["id"]);
+            setError(response, -32001, "Authentication required");
+            response["error"]["data"]["challenge"] = challenge;
+            sendMCPResponse(clientId);
+            return;
+        }
+        if (!auth.verify(clientId, answer | "", session)) {
+            metrics.count(MCP_COUNTER_AUTH_FAILURES);
+            sendMCPError(clientId, request["id"], "Authentication failed", -32001);
+            return;
+        }
+    }
+    uint8_t level = negotiateVerbosity(clientId, request["params"]);
+    sendResultResponse(clientId, request["id"], MCP_INITIALIZE_RESULTS[level], MCP_INITIALIZE_RESULT_LENGTHS[level],
+                       session);
+}
+
+// With ENABLE_AUTHENTICATION, every message but the initialize handshake
+// must carry the slot's session token; a batch is refused whole if any
+// call lacks it, so the handshake itself cannot be batched. False once the
+// error has been sent.
+bool MCPServer::authorize(uint8_t clientId, const JsonDocument& request, bool batch) {
+    if (!ENABLE_AUTHENTICATION) return true;
+    
+    if (batch) {
+        for (JsonVariantConst call : request.as<JsonArrayConst>()) {
+            if (!auth.check(clientId, call["session"] | "")) {
+                metrics.count(MCP_COUNTER_AUTH_FAILURES);
+                sendMCPError(clientId, call["id"], "Unauthorized", -32001);
+                return false;
+            }
+        }
+        return true;
+    }
+    if (strcmp(request["method"] | "", "initialize") == 0) return true;
+    if (auth.check(clientId, request["session"] | "")) return true;
+    metrics.count(MCP_COUNTER_AUTH_FAILURES);
+    sendMCPError(clientId, request["id"], "Unauthorized", -32001);
+    return false;
+}
+
+// Grants the level initialize asked for, or the default for a missing or
+// unknown one; the result tells the client which it got
+uint8_t MCPServer::negotiateVerbosity(uint8_t clientId, JsonVariantConst params) {
+    int level = verbosityFromName(params["verbosity"] | "");
+    sessionVerbosity[clientId] = level >= 0 ? level : MCP_DEFAULT_VERBOSITY;
+    return sessionVerbosity[clientId];
+}
+
+void MCPServer::handleListTools(uint8_t clientId, const JsonDocument& request) {
+    sendResultResponse(clientId, request["id"], MCP_TOOLS_LIST_RESULT, MCP_TOOLS_LIST_RESULT_LENGTH);
+}
+
+#define MCP_TOOL_INVOKER(id, name, description, ARGS) &MCPServer::invokeTool<id##Args, &MCPServer::execute##id>,
+const MCPServer::ToolInvoker MCPServer::toolInvokers[MCP_TOOL_COUNT] = { MCP_TOOLS(MCP_TOOL_INVOKER) };
+#undef MCP_TOOL_INVOKER
+
+// Fills response, a JSON-RPC response object with its envelope already
+// set, with the tool's result or an error. A call that leaves HID work
+// queued becomes a job: its result says so, and completion is reported
+// separately by pollJobs().
+void MCPServer::handleCallTool(uint8_t clientId, JsonObject response, JsonObjectConst request) {
+    const char* toolName = request["params"]["name"] | "";
+    
+    if (!hidController) {
+        setError(response, -32000, "HID controller not available");
         return;
     }
     
-    DynamicJsonDocument response(JSON_DOC_SIZE);
-    response["jsonrpc"] = "2.0";
-    response["id"] = requestId;
-    response["result"] = result;
+    metrics.count(MCP_COUNTER_TOOL_CALLS);
+    int tool = findTool(toolName);
+    if (tool < 0) {
+        setError(response, -32000, String("Unknown tool: ") + toolName);
+        return;
+    }
+    metricMethod = tool;
     
-    sendMCPResponse(clientId, response);
+    // Status and lease tools, and benchmark and script polls, stay
+    // available while the job queue is full, and are exempt from credits,
+    // leases and rate limits
+    if (toolUsesHID(tool, request["params"]["args"])) {
+        if (jobQueues[clientId].pending >= MCP_JOB_QUEUE_SIZE) {
+            setBusy(response, clientId, "Busy: no job credits left");
+            return;
+        }
+        
+        uint32_t retryMs = 0;
+        HIDAccess access = arbiter.admit(clientId, 1, millis(), retryMs);
+        if (access == HID_ACCESS_LEASED) {
+            metrics.count(MCP_COUNTER_LEASE_DENIED);
+            setError(response, -32000, "HID is leased by another client");
+            return;
+        }
+        if (access == HID_ACCESS_RATE_LIMITED) {
+            metrics.count(MCP_COUNTER_RATE_LIMITED);
+            setError(response, -32000, String("Rate limit exceeded; retry in ") + retryMs + " ms");
+            return;
+        }
+    }
+    
+    // A call may ask for its own verbosity
+    int level = verbosityFromName(request["params"]["verbosity"] | "");
+    callVerbosity = level >= 0 ? level : sessionVerbosity[clientId];
+    
+    // The tool writes its result straight into the response arena
+    callingClient = clientId;
+    uint32_t before = hidController->sequence();
+    unsigned long start = micros();
+    JsonObject result = response.createNestedObject("result");
+    const char* error = "";
+    if (!toolInvokers[tool](*this, request["params"]["args"], result, error)) {
+        setError(response, -32602, error);
+        return;
+    }
+    unsigned long elapsed = micros() - start;
+    metrics.record(tool, MCP_PHASE_EXECUTE, elapsed);
+    
+    uint32_t after = hidController->sequence();
+    if (after != before) noteHIDOwner(clientId);
+    bool queued = after != before && !hidController->completed(after);
+    if (queued && request.containsKey("id")) {
+        acceptJob(clientId, tool, after, response);
+    }
+    
+    if (callVerbosity == MCP_VERBOSITY_MINIMAL) {
+        // Results of data queries stay whole; they are what was asked for
+        if (after != before || !(result["success"] | true)) compactResult(result, queued);
+    } else if (callVerbosity == MCP_VERBOSITY_DEBUG) {
+        JsonObject debug = result.createNestedObject("debug");
+        debug["exec_us"] = elapsed;
+        debug["hid_sequence"] = after;
+        debug["request_bytes"] = arenas[clientId].request.memoryUsage();
+    }
 }
 
-DynamicJsonDocument MCPServer::executeKeyboardType(const JsonVariantConst& args) {
-    DynamicJsonDocument result(512);
-    String text = args["text"];
+// Read-only polls of the benchmark and script count as status calls
+bool MCPServer::toolUsesHID(uint8_t tool, JsonVariantConst args) {
+    if (tool == MCP_TOOL_HIDBenchmark) return strcmp(args["action"] | "result", "result") != 0;
+    if (tool == MCP_TOOL_RunScript) return strcmp(args["action"] | "run", "status") != 0;
+    return tool != MCP_TOOL_SystemStatus && tool != MCP_TOOL_JobStatus &&
+           tool != MCP_TOOL_Metrics && tool != MCP_TOOL_HIDLease;
+}
+
+void MCPServer::noteHIDOwner(uint8_t clientId) {
+    hidOwner = clientId;
+    hidOwnerSequence = hidController->sequence();
+}
+
+// The rules a tool call meets, for one step of a script or benchmark:
+// a lease shuts the client out, work of another client that is queued or
+// waiting goes first, and the step spends cost tokens
+HIDTurn MCPServer::takeHIDTurn(uint8_t clientId, uint16_t cost, uint32_t& retryMs) {
+    uint32_t now = millis();
+    if (!arbiter.mayUse(clientId, now)) {
+        metrics.count(MCP_COUNTER_LEASE_DENIED);
+        return HID_TURN_DENIED;
+    }
+    bool othersBusy = hidOwner != clientId && !hidController->completed(hidOwnerSequence);
+    if (othersBusy || arbiter.othersWaiting(clientId)) return HID_TURN_WAIT;
     
-    bool success = hidController->typeText(text);
-    result["success"] = success;
-    result["message"] = success ? "Text typed successfully" : "Failed to type text";
-    result["typed_text"] = text;
+    HIDAccess access = arbiter.admit(clientId, cost, now, retryMs);
+    if (access == HID_ACCESS_LEASED) return HID_TURN_DENIED;
+    return access == HID_ACCESS_OK ? HID_TURN_GO : HID_TURN_WAIT;
+}
+
+HIDTurn MCPServer::hidTurnGate(void* context, uint8_t clientId, uint16_t cost, uint32_t& retryMs) {
+    return static_cast<MCPServer*>(context)->takeHIDTurn(clientId, cost, retryMs);
+}
+
+void MCPServer::hidTurnNotice(void* context, uint8_t clientId) {
+    static_cast<MCPServer*>(context)->noteHIDOwner(clientId);
+}
+
+// Holds back a call whose HID work would queue behind another client's,
+// or behind a call already waiting, so that clients take turns. True when
+// the call was parked or refused and needs no further handling.
+bool MCPServer::parkCall(uint8_t clientId, const JsonDocument& request, uint32_t credit) {
+    int tool = findTool(request["params"]["name"] | "");
+    if (tool < 0 || !toolUsesHID(tool, request["params"]["args"]) || !hidController) return false;
+    // A call the lease shuts out is refused by handleCallTool straight away
+    if (!arbiter.mayUse(clientId, millis())) return false;
+    
+    // Calls of one client run in order, so only one of them can wait
+    if (arbiter.isWaiting(clientId)) {
+        creditBytes[clientId] -= credit;
+        setBusy(beginResponse(clientId, request["id"]), clientId, "Busy: an earlier call is waiting for its HID turn");
+        sendMCPResponse(clientId);
+        return true;
+    }
+    
+    bool othersBusy = hidOwner != clientId && !hidController->completed(hidOwnerSequence);
+    if (!othersBusy && !arbiter.othersWaiting(clientId)) return false;
+    
+    // Too big to hold, and running it now would jump the queue: refuse it
+    // as Busy so the client retries once the HID work ahead has completed
+    size_t length = measureJson(request);
+    if (length >= MCP_PARKED_CALL_SIZE) {
+        creditBytes[clientId] -= credit;
+        setBusy(beginResponse(clientId, request["id"]), clientId, "Busy: call too large to wait for its HID turn");
+        sendMCPResponse(clientId);
+        return true;
+    }
+    
+    serializeJson(request, parked[clientId].text, MCP_PARKED_CALL_SIZE);
+    parked[clientId].length = length;
+    parked[clientId].credit = credit;
+    arbiter.setWaiting(clientId, true);
+    metrics.count(MCP_COUNTER_PARKED);
+    return true;
+}
+
+// Runs the next parked call, round robin across clients, once the HID
+// queue has drained
+void MCPServer::dispatchParked() {
+    if (!hidController || hidController->isBusy()) return;
+    int clientId = arbiter.nextWaiting();
+    if (clientId < 0) return;
+    
+    arbiter.setWaiting(clientId, false);
+    ParkedCall& call = parked[clientId];
+    JsonDocument& request = arenas[clientId].request;
+    // The text is ours, so it is parsed in place like a WebSocket frame
+    DeserializationError error = deserializeJson(request, call.text, call.length);
+    call.length = 0;
+    metricMethod = MCP_METHOD_OTHER;
+    if (error) {
+        creditBytes[clientId] -= call.credit;
+        sendMCPError(clientId, JsonVariantConst(), "Parked call could not be restored");
+        return;
+    }
+    uint32_t jobsBefore = nextJobId;
+    handleCallTool(clientId, beginResponse(clientId, request["id"]), request.as<JsonObjectConst>());
+    sendMCPResponse(clientId);
+    settleCredit(clientId, jobsBefore, call.credit);
+}
+
+// Charges a message carrying HID tools/call requests its frame length.
+// One larger than the whole credit is let through when nothing else is in
+// flight, so it can never be refused for good. False once the Busy error
+// has been sent.
+bool MCPServer::takeCredit(uint8_t clientId, const JsonDocument& request, bool batch, size_t length,
+                           uint32_t& credit) {
+    bool usesHID = false;
+    if (batch) {
+        for (JsonVariantConst call : request.as<JsonArrayConst>()) {
+            int tool = findTool(call["params"]["name"] | "");
+            if (strcmp(call["method"] | "", "tools/call") == 0 && tool >= 0 &&
+                toolUsesHID(tool, call["params"]["args"])) {
+                usesHID = true;
+            }
+        }
+    } else {
+        int tool = findTool(request["params"]["name"] | "");
+        usesHID = tool >= 0 && toolUsesHID(tool, request["params"]["args"]);
+    }
+    credit = 0;
+    if (!usesHID) return true;
     
-    return result;
+    if (creditBytes[clientId] > 0 && creditBytes[clientId] + length > MCP_CREDIT_BYTES) {
+        JsonVariantConst id = batch ? request[0]["id"] : request["id"];
+        setBusy(beginResponse(clientId, id), clientId, "Busy: no byte credits left");
+        sendMCPResponse(clientId);
+        return false;
+    }
+    creditBytes[clientId] += length;
+    credit = length;
+    return true;
+}
+
+// Hands a message's credit to the newest job it queued, so it comes back
+// when that job completes (jobs complete in order), or returns it now
+void MCPServer::settleCredit(uint8_t clientId, uint32_t jobsBefore, uint32_t credit) {
+    if (credit == 0) return;
+    ClientJobs& queue = jobQueues[clientId];
+    if (nextJobId != jobsBefore && queue.pending > 0) {
+        queue.jobs[(queue.head + MCP_JOB_QUEUE_SIZE - 1) % MCP_JOB_QUEUE_SIZE].credit += credit;
+    } else {
+        creditBytes[clientId] -= credit;
+    }
+}
+
+// Busy is its own error code so clients can tell it from a failed call:
+// wait for a completion notification, which returns credits, and retry
+void MCPServer::setBusy(JsonObject response, uint8_t clientId, const char* reason) {
+    metrics.count(MCP_COUNTER_BUSY);
+    setError(response, -32002, reason);
+    describeCredits(clientId, response["error"].createNestedObject("data").createNestedObject("credits"));
+}
+
+// Credits still available to the client
+void MCPServer::describeCredits(uint8_t clientId, JsonObject out) {
+    uint32_t used = creditBytes[clientId];
+    out["bytes"] = used < MCP_CREDIT_BYTES ? MCP_CREDIT_BYTES - used : 0;
+    out["jobs"] = MCP_JOB_QUEUE_SIZE - jobQueues[clientId].pending;
+}
+
+// Reduces a result to a status code: 0 done, 1 queued (a completion
+// notification follows), 2 failed. A failure keeps its message.
+void MCPServer::compactResult(JsonObject result, bool queued) {
+    bool success = result["success"] | true;
+    // Members are unlinked, not freed, so message stays valid
+    const char* message = result["message"] | "";
+    result.clear();
+    result["status"] = !success ? 2 : queued ? 1 : 0;
+    if (!success) result["message"] = message;
 }
 
-DynamicJsonDocument MCPServer::executeKeyboardKey(const JsonVariantConst& args) {
-    DynamicJsonDocument result(512);
-    String key = args["key"];
-    String modifiers = args["modifiers"] | "";
+void MCPServer::acceptJob(uint8_t clientId, uint8_t tool, uint32_t sequence, JsonObject response) {
+    // Ids too long to keep are answered without a job, as before
+    JsonVariantConst id = response.getMember("id");
+    if (measureJson(id) >= MCP_JOB_ID_SIZE) return;
+    
+    ClientJobs& queue = jobQueues[clientId];
+    MCPJob& job = queue.jobs[queue.head];
+    job.id = nextJobId++;
+    job.sequence = sequence;
+    job.acceptedMs = millis();
+    job.finishedMs = 0;
+    job.credit = 0;
+    job.tool = tool;
+    job.done = false;
+    serializeJson(id, job.requestId, MCP_JOB_ID_SIZE);
+    
+    // The slot reused here is the oldest entry, which is done unless the
+    // queue is full, and handleCallTool refuses calls then
+    queue.head = (queue.head + 1) % MCP_JOB_QUEUE_SIZE;
+    if (queue.count < MCP_JOB_QUEUE_SIZE) queue.count++;
+    queue.pending++;
+    
+    JsonObject result = response["result"];
+    result["job"] = job.id;
+    result["state"] = "queued";
+    result["queue_depth"] = queue.pending;
+}
+
+// Completes jobs whose HID work has been sent, oldest first per client
+void MCPServer::pollJobs() {
+    if (!hidController) return;
+    
+    for (uint8_t clientId = 0; clientId < MAX_CLIENTS; clientId++) {
+        ClientJobs& queue = jobQueues[clientId];
+        while (queue.pending > 0) {
+            MCPJob& job = queue.jobs[(queue.head + MCP_JOB_QUEUE_SIZE - queue.pending) % MCP_JOB_QUEUE_SIZE];
+            if (!hidController->completed(job.sequence)) break;
+            job.done = true;
+            job.finishedMs = millis();
+            queue.pending--;
+            creditBytes[clientId] -= job.credit;
+            sendJobCompleted(clientId, job);
+        }
+    }
+}
+
+void MCPServer::sendJobCompleted(uint8_t clientId, const MCPJob& job) {
+    JsonDocument& message = arenas[clientId].response;
+    message.clear();
+    message["jsonrpc"] = "2.0";
+    message["method"] = "notifications/tools/completed";
+    JsonObject params = message.createNestedObject("params");
+    describeJob(job, params);
+    describeCredits(clientId, params.createNestedObject("credits"));
+    metricMethod = MCP_METHOD_NOTIFICATION;
+    sendMCPResponse(clientId);
+}
+
+void MCPServer::resetJobs(uint8_t clientId) {
+    jobQueues[clientId].head = 0;
+    jobQueues[clientId].count = 0;
+    jobQueues[clientId].pending = 0;
+    creditBytes[clientId] = 0;
+}
+
+void MCPServer::describeJob(const MCPJob& job, JsonObject out) {
+    out["job"] = job.id;
+    out["id"] = serialized((const char*)job.requestId);
+    out["tool"] = toolName(job.tool);
+    out["state"] = job.done ? "done" : "queued";
+    out["elapsed_ms"] = (job.done ? job.finishedMs : millis()) - job.acceptedMs;
+}
+
+void MCPServer::executeKeyboardType(const KeyboardTypeArgs& args, JsonObject result) {
+    const char* layoutName = args.layout;
+    
+    uint8_t layout = KEYBOARD_LAYOUT;
+    if (layoutName[0]) {
+        int id = keyboardLayoutFromName(layoutName);
+        if (id < 0) {
+            result["success"] = false;
+            result["message"] = String("Unknown keyboard layout: ") + layoutName;
+            return;
+        }
+        layout = id;
+    }
+    
+    bool success = hidController->typeText(args.text, strlen(args.text), layout, HID_TYPE_DELAY_MS);
+    result["success"] = success;
+    result["message"] = success ? "Text queued for typing" : "Failed to queue text (HID queue full)";
+    result["length"] = strlen(args.text);
+    result["layout"] = keyboardLayoutName(layout);
+    // The text lives in the request arena, so this stores a pointer, but it
+    // still doubles the bytes sent back
+    if (callVerbosity == MCP_VERBOSITY_DEBUG) result["typed_text"] = args.text;
+}
+
+void MCPServer::executeKeyboardKey(const KeyboardKeyArgs& args, JsonObject result) {
+    String key = args.key;
+    String modifiers = args.modifiers;
 
     bool success = hidController->sendKeyStroke(key, modifiers);
     result["success"] = success;
     result["message"] = success ? "Key pressed successfully" : "Failed to press key";
     result["key"] = key;
     result["modifiers"] = modifiers;
-
-    return result;
 }
 
-DynamicJsonDocument MCPServer::executeKeyboardShortcut(const JsonVariantConst& args) {
-    DynamicJsonDocument result(512);
-    String shortcut = args["shortcut"];
+void MCPServer::executeKeyboardShortcut(const KeyboardShortcutArgs& args, JsonObject result) {
+    String shortcut = args.shortcut;
 
     if (!shortcut.length()) {
         result["success"] = false;
         result["message"] = "Missing shortcut";
-        return result;
+        return;
     }
 
     String normalizedShortcut = shortcut;
@@ -351,15 +1064,12 @@ DynamicJsonDocument MCPServer::executeKeyboardShortcut(const JsonVariantConst& a
     result["shortcut"] = shortcut;
     result["key"] = key;
     result["modifiers"] = modifiers;
-
-    return result;
 }
 
-DynamicJsonDocument MCPServer::executeMouseMove(const JsonVariantConst& args) {
-    DynamicJsonDocument result(512);
-    int16_t x = args["x"];
-    int16_t y = args["y"];
-    bool relative = args["relative"] | true;
+void MCPServer::executeMouseMove(const MouseMoveArgs& args, JsonObject result) {
+    int16_t x = args.x;
+    int16_t y = args.y;
+    bool relative = args.relative;
     
     bool success = hidController->moveMouse(x, y, relative);
     result["success"] = success;
@@ -367,14 +1077,11 @@ DynamicJsonDocument MCPServer::executeMouseMove(const JsonVariantConst& args) {
     result["x"] = x;
     result["y"] = y;
     result["relative"] = relative;
-    
-    return result;
 }
 
-DynamicJsonDocument MCPServer::executeMouseClick(const JsonVariantConst& args) {
-    DynamicJsonDocument result(512);
-    String button = args["button"] | "left";
-    uint16_t duration = args["duration"] | 50;
+void MCPServer::executeMouseClick(const MouseClickArgs& args, JsonObject result) {
+    String button = args.button;
+    uint16_t duration = args.duration;
     
     uint8_t buttonCode = MOUSE_LEFT;
     if (button == "right") buttonCode = MOUSE_RIGHT;
@@ -385,25 +1092,100 @@ DynamicJsonDocument MCPServer::executeMouseClick(const JsonVariantConst& args) {
     result["message"] = success ? "Mouse clicked successfully" : "Failed to click mouse";
     result["button"] = button;
     result["duration"] = duration;
-    
-    return result;
 }
 
-DynamicJsonDocument MCPServer::executeMouseScroll(const JsonVariantConst& args) {
-    DynamicJsonDocument result(512);
-    int8_t scroll = args["scroll"];
+void MCPServer::executeMouseScroll(const MouseScrollArgs& args, JsonObject result) {
+    int8_t scroll = args.scroll;
     
     bool success = hidController->scrollMouse(scroll);
     result["success"] = success;
     result["message"] = success ? "Mouse scrolled successfully" : "Failed to scroll mouse";
     result["scroll"] = scroll;
+}
+
+void MCPServer::executeMousePath(const MousePathArgs& args, JsonObject result) {
+    JsonArrayConst pointsArg = args.points;
+    String curve = args.curve;
+    bool relative = args.relative;
+    uint16_t duration = args.duration;
+    String button = args.button;
     
-    return result;
+    if (pointsArg.size() == 0 || pointsArg.size() > MOUSE_PATH_MAX_POINTS) {
+        result["success"] = false;
+        result["message"] = "points must hold 1 to " + String(MOUSE_PATH_MAX_POINTS) + " waypoints";
+        return;
+    }
+    if (curve != "line" && curve != "bezier") {
+        result["success"] = false;
+        result["message"] = "Unknown curve: " + curve;
+        return;
+    }
+    
+    HIDPathPoint points[MOUSE_PATH_MAX_POINTS];
+    uint16_t count = 0;
+    for (JsonVariantConst point : pointsArg) {
+        points[count].x = point["x"] | 0;
+        points[count].y = point["y"] | 0;
+        count++;
+    }
+    
+    uint8_t buttonCode = 0;
+    if (button == "left") buttonCode = MOUSE_LEFT;
+    else if (button == "right") buttonCode = MOUSE_RIGHT;
+    else if (button == "middle") buttonCode = MOUSE_MIDDLE;
+    
+    bool success = hidController->moveMousePath(points, count, relative, curve == "bezier", duration, buttonCode);
+    result["success"] = success;
+    result["message"] = success ? "Mouse path queued" : "Failed to queue mouse path";
+    result["points"] = count;
+    result["curve"] = curve;
+    result["duration"] = duration;
 }
 
-DynamicJsonDocument MCPServer::executeSystemStatus(const JsonVariantConst& args) {
-    DynamicJsonDocument result(1024);
+void MCPServer::executeMouseCalibrate(const MouseCalibrateArgs& args, JsonObject result) {
+    String action = args.action;
+    PointerCalibration& calibration = hidController->pointerCalibration();
+    uint8_t probe = args.probe >= 0 ? args.probe : calibration.nextProbe();
+    bool success = true;
+    
+    if (action == "start") {
+        calibration.start();
+        result["message"] = "Calibration started; place the cursor near the left edge and run each probe";
+    } else if (action == "probe") {
+        success = probe < POINTER_CALIBRATION_POINTS && hidController->probePointer(probe);
+        result["message"] = success ? "Probe queued; record the horizontal distance the cursor moved"
+                                    : "Invalid probe or HID queue full";
+        result["counts_per_report"] = probe < POINTER_CALIBRATION_POINTS ? PointerCalibration::PROBE_COUNTS[probe] : 0;
+        result["reports"] = calibration.probeReports(probe);
+    } else if (action == "record") {
+        success = calibration.record(probe, args.pixels);
+        result["message"] = success ? "Probe recorded" : "Invalid probe or pixel distance";
+    } else if (action == "commit") {
+        success = calibration.commit();
+        result["message"] = success ? "Calibration saved; relative moves are now compensated"
+                                    : "Record every probe before committing";
+    } else if (action == "reset") {
+        calibration.reset();
+        result["message"] = "Calibration cleared";
+    } else if (action != "status") {
+        success = false;
+        result["message"] = "Unknown action: " + action;
+    }
     
+    result["success"] = success;
+    result["probe"] = probe;
+    result["next_probe"] = calibration.nextProbe();
+    result["probe_count"] = POINTER_CALIBRATION_POINTS;
+    result["calibrated"] = calibration.isValid();
+    if (calibration.isValid()) {
+        JsonArray curve = result.createNestedArray("pixels_per_report");
+        for (uint8_t i = 0; i < POINTER_CALIBRATION_POINTS; i++) {
+            curve.add(calibration.pixelsPerReport(PointerCalibration::PROBE_COUNTS[i]));
+        }
+    }
+}
+
+void MCPServer::executeSystemStatus(const SystemStatusArgs& args, JsonObject result) {
     result["success"] = true;
     result["server_name"] = MCP_SERVER_NAME;
     result["server_version"] = MCP_SERVER_VERSION;
@@ -413,7 +1195,254 @@ DynamicJsonDocument MCPServer::executeSystemStatus(const JsonVariantConst& args)
     result["wifi_ip"] = WiFi.localIP().toString();
     result["wifi_ssid"] = WiFi.SSID();
     result["free_heap"] = ESP.getFreeHeap();
+    result["max_alloc_heap"] = ESP.getMaxAllocHeap();
+    result["uptime_ms"] = millis();
+    
+    // JSON arena high-water marks across client slots
+    size_t requestPeak = 0;
+    size_t responsePeak = 0;
+    uint32_t overflows = 0;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (arenas[i].requestPeak > requestPeak) requestPeak = arenas[i].requestPeak;
+        if (arenas[i].responsePeak > responsePeak) responsePeak = arenas[i].responsePeak;
+        overflows += arenas[i].overflows;
+    }
+    JsonObject arena = result.createNestedObject("json_arena");
+    arena["request_size"] = MCP_REQUEST_ARENA_SIZE;
+    arena["request_peak"] = requestPeak;
+    arena["response_size"] = MCP_RESPONSE_ARENA_SIZE;
+    arena["response_peak"] = responsePeak;
+    arena["overflows"] = overflows;
+    
+    JsonObject wire = result.createNestedObject("wire");
+    reportWireStats(jsonWire, wire.createNestedObject("json"));
+    reportWireStats(binaryWire, wire.createNestedObject("binary"));
+    
+    auth.results(result.createNestedObject("auth"));
+    if (eventLoop) eventLoop->results(result.createNestedObject("event_loop"));
+}
+
+void MCPServer::executeHIDLease(const HIDLeaseArgs& args, JsonObject result) {
+    static const char* const LEASE_NAMES[] = { "none", "shared", "exclusive" };
+    String action = args.action;
+    String mode = args.mode;
+    uint32_t now = millis();
+    
+    bool success = true;
+    if (action == "acquire") {
+        if (mode != "exclusive" && mode != "shared") {
+            result["success"] = false;
+            result["message"] = "Unknown mode: " + mode;
+            return;
+        }
+        if (args.ttl_ms <= 0 || args.ttl_ms > HID_LEASE_MAX_MS) {
+            result["success"] = false;
+            result["message"] = "ttl_ms out of range";
+            return;
+        }
+        const char* error = "";
+        success = arbiter.acquire(callingClient, mode == "shared" ? HID_LEASE_SHARED : HID_LEASE_EXCLUSIVE,
+                                  args.ttl_ms, now, error);
+        result["message"] = success ? "Lease held" : error;
+    } else if (action == "release") {
+        arbiter.release(callingClient);
+        result["message"] = "Lease released";
+    } else if (action != "status") {
+        result["success"] = false;
+        result["message"] = "Unknown action: " + action;
+        return;
+    }
+    
+    result["success"] = success;
+    result["holders"] = arbiter.holders(now);
+    result["lease"] = LEASE_NAMES[arbiter.lease(callingClient)];
+    result["expires_in_ms"] = arbiter.leaseRemaining(callingClient, now);
+    result["hid_available"] = arbiter.mayUse(callingClient, now);
+}
+
+void MCPServer::executeMetrics(const MetricsArgs& args, JsonObject result) {
+    int method = -1;
+    if (args.method[0]) {
+        method = MCPMetrics::findMethod(args.method);
+        if (method < 0) {
+            result["success"] = false;
+            result["message"] = String("Unknown method: ") + args.method;
+            return;
+        }
+    }
+    
+    sampleMetrics();
+    result["success"] = true;
     result["uptime_ms"] = millis();
+    metrics.report(result, method);
+    if (args.reset) metrics.reset();
+}
+
+void MCPServer::executeHIDBenchmark(const HIDBenchmarkArgs& args, JsonObject result) {
+    String action = args.action;
+    
+    if (!hidBenchmark) {
+        result["success"] = false;
+        result["message"] = "Benchmark not available";
+        return;
+    }
+    
+    bool success = true;
+    if (action == "start") {
+        String mode = args.mode;
+        uint16_t rate = args.rate;
+        uint16_t duration = args.duration;
+        if (mode != "keyboard" && mode != "mouse") {
+            result["success"] = false;
+            result["message"] = "Unknown mode: " + mode;
+            return;
+        }
+        success = hidBenchmark->start(callingClient, mode == "mouse" ? HID_BENCHMARK_MOUSE : HID_BENCHMARK_KEYBOARD,
+                                      rate, duration);
+        result["message"] = success ? "Benchmark started" : "HID busy or benchmark already running";
+    } else if (action == "stop") {
+        hidBenchmark->stop();
+        result["message"] = "Benchmark stopped";
+    } else if (action != "result") {
+        result["success"] = false;
+        result["message"] = "Unknown action: " + action;
+        return;
+    }
     
-    return result;
+    result["success"] = success;
+    hidBenchmark->results(result);
+}
+
+void MCPServer::executeRunScript(const RunScriptArgs& args, JsonObject result) {
+    String action = args.action;
+    
+    if (!hidScript) {
+        result["success"] = false;
+        result["message"] = "Scripting not available";
+        return;
+    }
+    
+    bool success = true;
+    if (action == "run") {
+        HIDScriptError error;
+        success = hidScript->run(callingClient, args.script, strlen(args.script), error);
+        if (success) {
+            result["message"] = "Script started";
+        } else {
+            result["message"] = error.message;
+            if (error.line) result["line"] = error.line;
+        }
+    } else if (action == "stop") {
+        hidScript->stop();
+        result["message"] = "Script stopped";
+    } else if (action != "status") {
+        result["success"] = false;
+        result["message"] = "Unknown action: " + action;
+        return;
+    }
+    
+    result["success"] = success;
+    hidScript->results(result);
+}
+
+void MCPServer::executeJobStatus(const JobStatusArgs& args, JsonObject result) {
+    const ClientJobs& queue = jobQueues[callingClient];
+    result["queue_depth"] = queue.pending;
+    result["queue_size"] = MCP_JOB_QUEUE_SIZE;
+    describeCredits(callingClient, result.createNestedObject("credits"));
+    
+    // Oldest first
+    bool found = args.job == 0;
+    JsonArray jobs = result.createNestedArray("jobs");
+    for (uint8_t age = queue.count; age > 0; age--) {
+        const MCPJob& job = queue.jobs[(queue.head + MCP_JOB_QUEUE_SIZE - age) % MCP_JOB_QUEUE_SIZE];
+        if (args.job != 0 && job.id != (uint32_t)args.job) continue;
+        describeJob(job, jobs.createNestedObject());
+        found = true;
+    }
+    
+    result["success"] = found;
+    if (!found) {
+        result["message"] = "Unknown job: " + String(args.job);
+    }
+}
+
+void MCPServer::executeSequence(const SequenceArgs& args, JsonObject result) {
+    String action = args.action;
+    
+    if (!hidSequences) {
+        result["success"] = false;
+        result["message"] = "Sequence storage not available";
+        return;
+    }
+    
+    const char* error = "";
+    bool success = true;
+    if (action == "define") {
+        uint8_t layout = KEYBOARD_LAYOUT;
+        if (args.layout[0]) {
+            int id = keyboardLayoutFromName(args.layout);
+            if (id < 0) {
+                result["success"] = false;
+                result["message"] = String("Unknown keyboard layout: ") + args.layout;
+                return;
+            }
+            layout = id;
+        }
+        
+        uint32_t contentHash = 0;
+        success = hidSequences->define(args.name, args.text, strlen(args.text), layout, contentHash, error);
+        if (success) {
+            char hash[9];
+            sprintf(hash, "%08x", (unsigned)contentHash);
+            result["name"] = args.name;
+            result["hash"] = hash;
+            result["layout"] = keyboardLayoutName(layout);
+            for (uint8_t i = 0; i < hidSequences->count(); i++) {
+                if (hidSequences->info(i).contentHash == contentHash) {
+                    result["reports"] = hidSequences->info(i).reports;
+                }
+            }
+            result["message"] = "Sequence stored";
+        }
+    } else if (action == "replay") {
+        uint32_t contentHash = 0;
+        if (!args.name[0]) {
+            char* end = nullptr;
+            contentHash = strtoul(args.hash, &end, 16);
+            if (!args.hash[0] || *end) {
+                result["success"] = false;
+                result["message"] = "Give a name or hash";
+                return;
+            }
+        }
+        success = hidSequences->replay(args.name, contentHash, args.delay, error);
+        if (success) result["message"] = "Sequence queued";
+    } else if (action == "delete") {
+        success = hidSequences->remove(args.name);
+        if (success) result["message"] = "Sequence deleted";
+        else error = "Unknown sequence";
+    } else if (action == "list") {
+        JsonArray list = result.createNestedArray("sequences");
+        for (uint8_t i = 0; i < hidSequences->count(); i++) {
+            const HIDSequenceInfo& info = hidSequences->info(i);
+            char hash[9];
+            sprintf(hash, "%08x", (unsigned)info.contentHash);
+            JsonObject entry = list.createNestedObject();
+            entry["name"] = info.name;
+            entry["hash"] = hash;
+            entry["reports"] = info.reports;
+            entry["layout"] = keyboardLayoutName(info.layout);
+        }
+        result["capacity"] = HID_SEQUENCE_MAX_ENTRIES;
+        result["cache_hits"] = hidSequences->cacheHits();
+        result["cache_misses"] = hidSequences->cacheMisses();
+    } else {
+        result["success"] = false;
+        result["message"] = "Unknown action: " + action;
+        return;
+    }
+    
+    result["success"] = success;
+    if (!success) result["message"] = error;
 }
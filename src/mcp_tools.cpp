@@ -0,0 +1,135 @@
+#include "mcp_tools.h"
+
+// Open-addressed name table, at most half full so probes stay short
+#define TOOL_SLOTS 32
+#define TOOL_SLOT_EMPTY 0xff
+
+static_assert(MCP_TOOL_COUNT * 2 <= TOOL_SLOTS, "grow TOOL_SLOTS");
+
+#define MCP_TOOL_NAME(id, name, description, ARGS) name,
+static constexpr const char* TOOL_NAMES[MCP_TOOL_COUNT] = { MCP_TOOLS(MCP_TOOL_NAME) };
+#undef MCP_TOOL_NAME
+
+static constexpr size_t constexprLength(const char* text) {
+    size_t length = 0;
+    while (text[length]) length++;
+    return length;
+}
+
+struct ToolTable {
+    uint8_t slots[TOOL_SLOTS];
+};
+
+static constexpr ToolTable buildToolTable() {
+    ToolTable table = {};
+    for (size_t i = 0; i < TOOL_SLOTS; i++) table.slots[i] = TOOL_SLOT_EMPTY;
+    for (uint8_t tool = 0; tool < MCP_TOOL_COUNT; tool++) {
+        uint32_t slot = fnv1a(TOOL_NAMES[tool], constexprLength(TOOL_NAMES[tool])) % TOOL_SLOTS;
+        while (table.slots[slot] != TOOL_SLOT_EMPTY) slot = (slot + 1) % TOOL_SLOTS;
+        table.slots[slot] = tool;
+    }
+    return table;
+}
+
+static constexpr ToolTable TOOL_TABLE = buildToolTable();
+
+int findTool(const char* name) {
+    uint32_t slot = fnv1a(name, strlen(name)) % TOOL_SLOTS;
+    while (TOOL_TABLE.slots[slot] != TOOL_SLOT_EMPTY) {
+        uint8_t tool = TOOL_TABLE.slots[slot];
+        if (strcmp(TOOL_NAMES[tool], name) == 0) return tool;
+        slot = (slot + 1) % TOOL_SLOTS;
+    }
+    return -1;
+}
+
+const char* toolName(uint8_t tool) {
+    return tool < MCP_TOOL_COUNT ? TOOL_NAMES[tool] : "";
+}
+
+// Typed conversions; false when the JSON value has the wrong type
+static bool decodeArg(JsonVariantConst value, int32_t& out) {
+    if (!value.is<int32_t>()) return false;
+    out = value.as<int32_t>();
+    return true;
+}
+
+static bool decodeArg(JsonVariantConst value, float& out) {
+    if (!value.is<float>()) return false;
+    out = value.as<float>();
+    return true;
+}
+
+static bool decodeArg(JsonVariantConst value, bool& out) {
+    if (!value.is<bool>()) return false;
+    out = value.as<bool>();
+    return true;
+}
+
+static bool decodeArg(JsonVariantConst value, const char*& out) {
+    if (!value.is<const char*>()) return false;
+    out = value.as<const char*>();
+    return true;
+}
+
+// A missing waypoint coordinate is 0, as mouse_path reads it
+static bool pointCoordinateValid(JsonVariantConst value) {
+    if (value.isNull()) return true;
+    return value.is<int32_t>() && value.as<int32_t>() >= MCP_POINT_MIN && value.as<int32_t>() <= MCP_POINT_MAX;
+}
+
+// mouse_path waypoints: {x, y} objects whose coordinates fit a report
+static bool decodeArg(JsonVariantConst value, JsonArrayConst& out) {
+    if (!value.is<JsonArrayConst>()) return false;
+    out = value.as<JsonArrayConst>();
+    for (JsonVariantConst point : out) {
+        if (!point.is<JsonObjectConst>()) return false;
+        if (!pointCoordinateValid(point["x"]) || !pointCoordinateValid(point["y"])) return false;
+    }
+    return true;
+}
+
+// Only integers carry a range; MCP_ANY bounds are the whole int32 range
+static bool inRange(int32_t value, int32_t min, int32_t max) {
+    return value >= min && value <= max;
+}
+
+template <typename T>
+static bool inRange(const T&, int32_t, int32_t) {
+    return true;
+}
+
+#define MCP_ARG_DEFAULT(name, type, presence, def, range, desc) out.name = def;
+#define MCP_ARG_SEEN(name, type, presence, def, range, desc) bool seen_##name = false;
+#define MCP_ARG_MATCH(name, type, presence, def, range, desc) \
+    else if (strcmp(key, #name) == 0) { \
+        if (!decodeArg(member.value(), out.name) || \
+            !inRange(out.name, MCP_RANGE_MIN_##range, MCP_RANGE_MAX_##range)) { \
+            error = "Invalid argument: " #name " must be " MCP_JSON_TYPE_##type MCP_RANGE_TEXT_##range; \
+            return false; \
+        } \
+        seen_##name = true; \
+    }
+#define MCP_ARG_REQUIRE(name, type, presence, def, range, desc) \
+    if (MCP_ARG_IS_##presence && !seen_##name) { \
+        error = "Missing argument: " #name; \
+        return false; \
+    }
+
+// Unknown arguments are ignored, as JSON Schema allows by default
+#define MCP_TOOL_DECODE(id, name, description, ARGS) \
+    bool decodeToolArgs(JsonObjectConst args, id##Args& out, const char*& error) { \
+        ARGS(MCP_ARG_DEFAULT) \
+        ARGS(MCP_ARG_SEEN) \
+        for (JsonPairConst member : args) { \
+            const char* key = member.key().c_str(); \
+            (void)key; \
+            if (false) {} \
+            ARGS(MCP_ARG_MATCH) \
+        } \
+        ARGS(MCP_ARG_REQUIRE) \
+        (void)out; \
+        (void)error; \
+        return true; \
+    }
+MCP_TOOLS(MCP_TOOL_DECODE)
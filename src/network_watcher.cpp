@@ -0,0 +1,71 @@
+#include "network_watcher.h"
+#include <lwip/sockets.h>
+
+int WatchedWebSocketsServer::clientSocket(uint8_t num) {
+    WSclient_t& client = _clients[num];
+    return client.tcp && client.tcp->connected() ? client.tcp->fd() : -1;
+}
+
+bool WatchedWebSocketsServer::clientBuffered(uint8_t num) {
+    WSclient_t& client = _clients[num];
+    return client.tcp && client.tcp->available() > 0;
+}
+
+NetworkWatcher::NetworkWatcher(WatchedWebSocketsServer* ws, EventLoop* eventLoop)
+    : server(ws), loop(eventLoop), task(nullptr) {
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) sockets[i].store(-1);
+}
+
+bool NetworkWatcher::begin() {
+    if (xTaskCreatePinnedToCore(taskMain, "netwatch", NETWORK_WATCH_STACK_SIZE, this, NETWORK_WATCH_PRIORITY,
+                                &task, ARDUINO_RUNNING_CORE) != pdPASS) {
+        DEBUG_PRINTLN("Network watcher task could not be created");
+        return false;
+    }
+    rearm();
+    return true;
+}
+
+bool NetworkWatcher::rearm() {
+    bool buffered = false;
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+        sockets[i].store(server->clientSocket(i), std::memory_order_relaxed);
+        if (server->clientBuffered(i)) buffered = true;
+    }
+    // The notification orders the stores before the watcher's loads
+    if (task) xTaskNotifyGive(task);
+    return buffered;
+}
+
+void NetworkWatcher::taskMain(void* context) {
+    NetworkWatcher* watcher = static_cast<NetworkWatcher*>(context);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        watcher->watch();
+    }
+}
+
+void NetworkWatcher::watch() {
+    fd_set readable;
+    FD_ZERO(&readable);
+    int highest = -1;
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+        int fd = sockets[i].load(std::memory_order_relaxed);
+        if (fd < 0) continue;
+        FD_SET(fd, &readable);
+        if (fd > highest) highest = fd;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = NETWORK_POLL_MS / 1000;
+    timeout.tv_usec = (NETWORK_POLL_MS % 1000) * 1000;
+    if (highest < 0) {
+        vTaskDelay(pdMS_TO_TICKS(NETWORK_POLL_MS));
+        loop->notify(EVENT_NETWORK_POLL);
+        return;
+    }
+    // An error, such as a socket closed meanwhile, also wakes the loop so
+    // the WebSocket server notices and drops the client
+    int ready = select(highest + 1, &readable, nullptr, nullptr, &timeout);
+    loop->notify(ready == 0 ? EVENT_NETWORK_POLL : EVENT_NETWORK);
+}
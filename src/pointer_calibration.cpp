@@ -0,0 +1,143 @@
+#include "pointer_calibration.h"
+#include "config.h"
+#include <EEPROM.h>
+
+// Stored after the WiFi credentials (0-133, see wifi_manager.cpp)
+#define CALIBRATION_ADDR 256
+#define CALIBRATION_MAGIC 0xCA1B
+
+// Each probe moves about this many counts in total, so even a strongly
+// accelerated probe stays on screen
+#define PROBE_TOTAL_COUNTS 128
+
+struct StoredCalibration {
+    uint16_t magic;
+    uint16_t checksum;
+    float curve[POINTER_CALIBRATION_POINTS];
+};
+
+const uint8_t PointerCalibration::PROBE_COUNTS[POINTER_CALIBRATION_POINTS] = {
+    1, 2, 4, 8, 16, 32, 64, 127
+};
+
+static uint16_t curveChecksum(const float* curve) {
+    const uint8_t* bytes = (const uint8_t*)curve;
+    uint16_t checksum = 0;
+    for (size_t i = 0; i < POINTER_CALIBRATION_POINTS * sizeof(float); i++) {
+        checksum = (checksum << 1 | checksum >> 15) + bytes[i];
+    }
+    return checksum;
+}
+
+PointerCalibration::PointerCalibration() : recorded(0), valid(false) {
+    memset(curve, 0, sizeof(curve));
+    memset(measured, 0, sizeof(measured));
+}
+
+void PointerCalibration::begin() {
+    EEPROM.begin(EEPROM_SIZE);
+    valid = load();
+    DEBUG_PRINTF("Pointer calibration %s\n", valid ? "loaded" : "not found");
+}
+
+void PointerCalibration::start() {
+    memset(measured, 0, sizeof(measured));
+    recorded = 0;
+}
+
+uint8_t PointerCalibration::probeReports(uint8_t index) const {
+    if (index >= POINTER_CALIBRATION_POINTS) return 0;
+    return PROBE_TOTAL_COUNTS / PROBE_COUNTS[index];
+}
+
+uint8_t PointerCalibration::nextProbe() const {
+    for (uint8_t i = 0; i < POINTER_CALIBRATION_POINTS; i++) {
+        if (!(recorded & (1 << i))) return i;
+    }
+    return POINTER_CALIBRATION_POINTS;
+}
+
+bool PointerCalibration::record(uint8_t index, float pixels) {
+    if (index >= POINTER_CALIBRATION_POINTS || pixels <= 0) return false;
+
+    measured[index] = pixels / probeReports(index);
+    recorded |= 1 << index;
+    return true;
+}
+
+bool PointerCalibration::isComplete() const {
+    return nextProbe() == POINTER_CALIBRATION_POINTS;
+}
+
+bool PointerCalibration::commit() {
+    if (!isComplete()) return false;
+
+    // Acceleration never makes a bigger report travel less; clamp noisy
+    // measurements so the curve can be inverted
+    for (uint8_t i = 0; i < POINTER_CALIBRATION_POINTS; i++) {
+        curve[i] = measured[i];
+        if (i > 0 && curve[i] < curve[i - 1]) curve[i] = curve[i - 1];
+    }
+    valid = true;
+    return save();
+}
+
+void PointerCalibration::reset() {
+    valid = false;
+    recorded = 0;
+    memset(curve, 0, sizeof(curve));
+    EEPROM.writeUShort(CALIBRATION_ADDR, 0);
+    EEPROM.commit();
+}
+
+float PointerCalibration::pixelsPerReport(uint8_t counts) const {
+    if (counts <= PROBE_COUNTS[0]) return curve[0] * counts / PROBE_COUNTS[0];
+
+    for (uint8_t i = 1; i < POINTER_CALIBRATION_POINTS; i++) {
+        if (counts <= PROBE_COUNTS[i]) {
+            float t = (float)(counts - PROBE_COUNTS[i - 1]) / (PROBE_COUNTS[i] - PROBE_COUNTS[i - 1]);
+            return curve[i - 1] + t * (curve[i] - curve[i - 1]);
+        }
+    }
+    return curve[POINTER_CALIBRATION_POINTS - 1];
+}
+
+uint8_t PointerCalibration::countsForPixels(float pixels) const {
+    const uint8_t last = POINTER_CALIBRATION_POINTS - 1;
+    if (pixels >= curve[last]) return PROBE_COUNTS[last];
+    if (pixels < curve[0]) return pixels * 2 >= curve[0] ? 1 : 0;
+
+    for (uint8_t i = 1; i <= last; i++) {
+        if (pixels < curve[i]) {
+            float t = (pixels - curve[i - 1]) / (curve[i] - curve[i - 1]);
+            return PROBE_COUNTS[i - 1] + (uint8_t)(t * (PROBE_COUNTS[i] - PROBE_COUNTS[i - 1]) + 0.5f);
+        }
+    }
+    return PROBE_COUNTS[last];
+}
+
+bool PointerCalibration::load() {
+    StoredCalibration stored;
+    EEPROM.get(CALIBRATION_ADDR, stored);
+    if (stored.magic != CALIBRATION_MAGIC || stored.checksum != curveChecksum(stored.curve)) {
+        return false;
+    }
+    if (!(stored.curve[0] > 0)) return false;
+
+    memcpy(curve, stored.curve, sizeof(curve));
+    return true;
+}
+
+bool PointerCalibration::save() {
+    StoredCalibration stored;
+    stored.magic = CALIBRATION_MAGIC;
+    memcpy(stored.curve, curve, sizeof(curve));
+    stored.checksum = curveChecksum(stored.curve);
+    EEPROM.put(CALIBRATION_ADDR, stored);
+
+    if (!EEPROM.commit()) {
+        DEBUG_PRINTLN("Pointer calibration commit failed!");
+        return false;
+    }
+    return true;
+}
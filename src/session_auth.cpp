@@ -0,0 +1,138 @@
+#include "session_auth.h"
+#include <mbedtls/md.h>
+#include <esp_random.h>
+
+static_assert(!ENABLE_AUTHENTICATION || sizeof(API_KEY) > 1,
+              "ENABLE_AUTHENTICATION needs an API_KEY");
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static void toHex(const uint8_t* bytes, size_t length, char* out) {
+    for (size_t i = 0; i < length; i++) {
+        out[i * 2] = HEX_DIGITS[bytes[i] >> 4];
+        out[i * 2 + 1] = HEX_DIGITS[bytes[i] & 0xf];
+    }
+    out[length * 2] = '\0';
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Differences are OR-ed together so the time taken does not depend on
+// where the first mismatch is
+static bool equalConstantTime(const uint8_t* a, const uint8_t* b, size_t length) {
+    uint8_t difference = 0;
+    for (size_t i = 0; i < length; i++) difference |= a[i] ^ b[i];
+    return difference == 0;
+}
+
+SessionAuth::SessionAuth(const char* apiKey)
+    : key(apiKey), handshakes(0), failures(0), checks(0), checkCycles(0), hmacUs(0) {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) reset(i);
+}
+
+void SessionAuth::reset(uint8_t clientId) {
+    Slot& slot = slots[clientId];
+    slot.challenged = false;
+    slot.authenticated = false;
+    slot.challengeMs = 0;
+    memset(slot.challenge, 0, sizeof(slot.challenge));
+    memset(slot.token, 0, sizeof(slot.token));
+}
+
+void SessionAuth::hmac(const uint8_t* data, size_t length, uint8_t out[32]) {
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                    (const uint8_t*)key, strlen(key), data, length, out);
+}
+
+void SessionAuth::challenge(uint8_t clientId, char* hex) {
+    Slot& slot = slots[clientId];
+    esp_fill_random(slot.challenge, sizeof(slot.challenge));
+    slot.challenged = true;
+    slot.authenticated = false;
+    slot.challengeMs = millis();
+    toHex(slot.challenge, sizeof(slot.challenge), hex);
+}
+
+bool SessionAuth::verify(uint8_t clientId, const char* responseHex, const char*& token) {
+    Slot& slot = slots[clientId];
+    bool fresh = slot.challenged && millis() - slot.challengeMs < AUTH_CHALLENGE_TTL_MS;
+    slot.challenged = false;
+
+    uint8_t response[32];
+    bool wellFormed = strlen(responseHex) == sizeof(response) * 2;
+    for (size_t i = 0; wellFormed && i < sizeof(response); i++) {
+        int high = hexValue(responseHex[i * 2]);
+        int low = hexValue(responseHex[i * 2 + 1]);
+        wellFormed = high >= 0 && low >= 0;
+        response[i] = (high << 4) | low;
+    }
+
+    unsigned long start = micros();
+    uint8_t expected[32];
+    hmac(slot.challenge, sizeof(slot.challenge), expected);
+    bool valid = fresh && wellFormed && equalConstantTime(expected, response, sizeof(expected));
+
+    if (valid) {
+        // The token is bound to the slot: HMAC over challenge and slot number
+        uint8_t material[AUTH_CHALLENGE_SIZE + 1];
+        memcpy(material, slot.challenge, AUTH_CHALLENGE_SIZE);
+        material[AUTH_CHALLENGE_SIZE] = clientId;
+        uint8_t digest[32];
+        hmac(material, sizeof(material), digest);
+        toHex(digest, AUTH_TOKEN_SIZE, slot.token);
+        slot.authenticated = true;
+        token = slot.token;
+        handshakes++;
+    } else {
+        failures++;
+    }
+    hmacUs = micros() - start;
+    memset(slot.challenge, 0, sizeof(slot.challenge));
+    return valid;
+}
+
+bool SessionAuth::check(uint8_t clientId, const char* token) {
+    uint32_t start = ESP.getCycleCount();
+    const Slot& slot = slots[clientId];
+    bool valid = slot.authenticated && strlen(token) == AUTH_TOKEN_SIZE * 2 &&
+                 equalConstantTime((const uint8_t*)slot.token, (const uint8_t*)token, AUTH_TOKEN_SIZE * 2);
+    checkCycles += ESP.getCycleCount() - start;
+    checks++;
+    if (!valid) failures++;
+    return valid;
+}
+
+bool SessionAuth::checkMetricsBearer(const char* authorization) {
+    static const char PREFIX[] = "Bearer ";
+    static const char PURPOSE[] = "metrics";
+    uint8_t digest[32];
+    hmac((const uint8_t*)PURPOSE, sizeof(PURPOSE) - 1, digest);
+    char expected[sizeof(digest) * 2 + 1];
+    toHex(digest, sizeof(digest), expected);
+
+    bool valid = strncmp(authorization, PREFIX, sizeof(PREFIX) - 1) == 0 &&
+                 strlen(authorization) == sizeof(PREFIX) - 1 + sizeof(digest) * 2 &&
+                 equalConstantTime((const uint8_t*)expected, (const uint8_t*)authorization + sizeof(PREFIX) - 1,
+                                   sizeof(digest) * 2);
+    if (!valid) failures++;
+    return valid;
+}
+
+void SessionAuth::results(JsonObject out) const {
+    out["enabled"] = ENABLE_AUTHENTICATION;
+    out["handshakes"] = handshakes;
+    out["failures"] = failures;
+    out["checks"] = checks;
+    out["handshake_hmac_us"] = hmacUs;
+    if (checks) {
+        // Per-message cost of authorising a message that carries a token
+        uint32_t cyclesPerCheck = checkCycles / checks;
+        out["check_cycles"] = cyclesPerCheck;
+        out["check_ns"] = cyclesPerCheck * 1000 / ESP.getCpuFreqMHz();
+    }
+}
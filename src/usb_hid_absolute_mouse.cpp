@@ -0,0 +1,71 @@
+#include "usb_hid_absolute_mouse.h"
+
+static const uint8_t reportDescriptor[] = {
+    0x05, 0x01,                          // Usage Page (Generic Desktop)
+    0x09, 0x02,                          // Usage (Mouse)
+    0xA1, 0x01,                          // Collection (Application)
+    0x85, HID_REPORT_ID_ABSOLUTE_MOUSE,  //   Report ID
+    0x09, 0x01,                          //   Usage (Pointer)
+    0xA1, 0x00,                          //   Collection (Physical)
+    0x05, 0x09,                          //     Usage Page (Button)
+    0x19, 0x01,                          //     Usage Minimum (1)
+    0x29, 0x03,                          //     Usage Maximum (3)
+    0x15, 0x00,                          //     Logical Minimum (0)
+    0x25, 0x01,                          //     Logical Maximum (1)
+    0x95, 0x03,                          //     Report Count (3)
+    0x75, 0x01,                          //     Report Size (1)
+    0x81, 0x02,                          //     Input (Data, Var, Abs)
+    0x95, 0x01,                          //     Report Count (1)
+    0x75, 0x05,                          //     Report Size (5)
+    0x81, 0x03,                          //     Input (Const) padding
+    0x05, 0x01,                          //     Usage Page (Generic Desktop)
+    0x09, 0x30,                          //     Usage (X)
+    0x09, 0x31,                          //     Usage (Y)
+    0x16, 0x00, 0x00,                    //     Logical Minimum (0)
+    0x26, 0xFF, 0x7F,                    //     Logical Maximum (32767)
+    0x75, 0x10,                          //     Report Size (16)
+    0x95, 0x02,                          //     Report Count (2)
+    0x81, 0x02,                          //     Input (Data, Var, Abs)
+    0x09, 0x38,                          //     Usage (Wheel)
+    0x15, 0x81,                          //     Logical Minimum (-127)
+    0x25, 0x7F,                          //     Logical Maximum (127)
+    0x75, 0x08,                          //     Report Size (8)
+    0x95, 0x01,                          //     Report Count (1)
+    0x81, 0x06,                          //     Input (Data, Var, Rel)
+    0xC0,                                //   End Collection
+    0xC0                                 // End Collection
+};
+
+struct __attribute__((packed)) AbsoluteMouseReport {
+    uint8_t buttons;
+    uint16_t x;
+    uint16_t y;
+    int8_t wheel;
+};
+
+USBHIDAbsoluteMouse::USBHIDAbsoluteMouse() : hid() {
+    static bool initialized = false;
+    if (!initialized) {
+        initialized = true;
+        hid.addDevice(this, sizeof(reportDescriptor));
+    }
+}
+
+void USBHIDAbsoluteMouse::begin() {
+    hid.begin();
+}
+
+uint16_t USBHIDAbsoluteMouse::_onGetDescriptor(uint8_t* buffer) {
+    memcpy(buffer, reportDescriptor, sizeof(reportDescriptor));
+    return sizeof(reportDescriptor);
+}
+
+bool USBHIDAbsoluteMouse::move(uint16_t x, uint16_t y, int8_t wheel) {
+    // Buttons stay on the relative mouse; this interface only positions
+    AbsoluteMouseReport report;
+    report.buttons = 0;
+    report.x = x > HID_ABSOLUTE_MAX ? HID_ABSOLUTE_MAX : x;
+    report.y = y > HID_ABSOLUTE_MAX ? HID_ABSOLUTE_MAX : y;
+    report.wheel = wheel;
+    return hid.SendReport(HID_REPORT_ID_ABSOLUTE_MOUSE, &report, sizeof(report));
+}
@@ -4,7 +4,6 @@
 #include <ArduinoJson.h>
 #include <ESPmDNS.h>
 
-#define EEPROM_SIZE 512
 #define SSID_ADDR 0
 #define PASS_ADDR 64
 #define MAGIC_ADDR 128
@@ -0,0 +1,108 @@
+// lookupKeyName against the String == chain it replaced in
+// HIDController::sendKeyStroke. Both are fed the names the chain knew, as
+// the String the request arrived in; the chain also pays for the F-key
+// substring and toInt() it did.
+//
+// Host timings only rank the two; on the ESP32 both run from flash and the
+// gap is wider, since every String compare there is an out-of-line call.
+
+#include "key_names.h"
+#include <Arduino.h>
+#include <chrono>
+#include <stdio.h>
+
+#define ROUNDS 200000
+
+// Arduino USBHIDKeyboard codes the chain returned
+#define KEY_RETURN 0xB0
+#define KEY_ESC 0xB1
+#define KEY_BACKSPACE 0xB2
+#define KEY_TAB 0xB3
+#define KEY_DELETE 0xD4
+#define KEY_UP_ARROW 0xDA
+#define KEY_DOWN_ARROW 0xD9
+#define KEY_LEFT_ARROW 0xD8
+#define KEY_RIGHT_ARROW 0xD7
+#define KEY_F1 0xC2
+
+// The chain as it stood before key_names.cpp
+static uint8_t legacyLookup(const String& keyName) {
+    uint8_t key = 0;
+    if (keyName == "Enter" || keyName == "Return") {
+        key = KEY_RETURN;
+    } else if (keyName == "Escape" || keyName == "Esc") {
+        key = KEY_ESC;
+    } else if (keyName == "Tab") {
+        key = KEY_TAB;
+    } else if (keyName == "Space") {
+        key = ' ';
+    } else if (keyName == "Backspace") {
+        key = KEY_BACKSPACE;
+    } else if (keyName == "Delete" || keyName == "Del") {
+        key = KEY_DELETE;
+    } else if (keyName == "Up") {
+        key = KEY_UP_ARROW;
+    } else if (keyName == "Down") {
+        key = KEY_DOWN_ARROW;
+    } else if (keyName == "Left") {
+        key = KEY_LEFT_ARROW;
+    } else if (keyName == "Right") {
+        key = KEY_RIGHT_ARROW;
+    } else if (keyName.startsWith("F") && keyName.length() <= 3) {
+        int fNum = keyName.substring(1).toInt();
+        if (fNum >= 1 && fNum <= 12) {
+            key = KEY_F1 + (fNum - 1);
+        }
+    } else if (keyName.length() == 1) {
+        key = keyName.charAt(0);
+    }
+    return key;
+}
+
+static const char* const NAMES[] = {
+    "Enter", "Return", "Escape", "Esc", "Tab", "Space", "Backspace", "Delete", "Del",
+    "Up", "Down", "Left", "Right", "F1", "F5", "F12", "a", "z", "7", "Right"
+};
+#define NAME_COUNT (sizeof(NAMES) / sizeof(NAMES[0]))
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPerLookup(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)ROUNDS * NAME_COUNT);
+}
+
+int main() {
+    String names[NAME_COUNT];
+    for (size_t i = 0; i < NAME_COUNT; i++) names[i] = NAMES[i];
+
+    // Everything the chain resolved, the table resolves too
+    int missing = 0;
+    for (size_t i = 0; i < NAME_COUNT; i++) {
+        KeyCode code;
+        if (legacyLookup(names[i]) == 0 || !lookupKeyName(names[i].c_str(), names[i].length(), code)) {
+            fprintf(stderr, "not resolved: %s\n", NAMES[i]);
+            missing++;
+        }
+    }
+
+    volatile uint32_t sink = 0;
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < NAME_COUNT; i++) sink = sink + legacyLookup(names[i]);
+    }
+    Clock::time_point chainEnd = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < NAME_COUNT; i++) {
+            KeyCode code;
+            lookupKeyName(names[i].c_str(), names[i].length(), code);
+            sink = sink + code.code;
+        }
+    }
+    Clock::time_point hashEnd = Clock::now();
+
+    double chain = nsPerLookup(start, chainEnd);
+    double hash = nsPerLookup(chainEnd, hashEnd);
+    printf("key names: String chain %.1f ns/lookup, perfect hash %.1f ns/lookup (%.1fx), %zu names\n",
+           chain, hash, chain / hash, NAME_COUNT);
+    return missing ? 1 : 0;
+}
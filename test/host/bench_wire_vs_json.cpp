@@ -0,0 +1,114 @@
+// Cost of one relative mouse move over each transport: a binary frame
+// record decoded by HIDWireDecoder, against the tools/call text frame going
+// through what MCPServer does before executeMouseMove runs (in-place parse
+// with the envelope filter, tool lookup, typed argument decoding).
+//
+// Needs ArduinoJson; the Makefile takes it from the PlatformIO libdeps
+// (ARDUINOJSON=...), so run `pio run` once first. Host timings rank the two
+// paths; system_status `wire` measures both on the device.
+
+#include "hid_wire_protocol.h"
+#include "mcp_tools.h"
+#include <ArduinoJson.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#define EVENTS 200000
+#define EVENTS_PER_FRAME 32
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPerEvent(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count() / EVENTS;
+}
+
+static int8_t moveX(uint32_t i) {
+    return (int8_t)(i * 7 % 61 - 30);
+}
+
+static int8_t moveY(uint32_t i) {
+    return (int8_t)(i * 13 % 41 - 20);
+}
+
+int main() {
+    // Binary: frames of EVENTS_PER_FRAME move records, as a client streams them
+    static uint8_t frame[1 + EVENTS_PER_FRAME * 5];
+    frame[0] = HID_WIRE_VERSION;
+    for (uint32_t i = 0; i < EVENTS_PER_FRAME; i++) {
+        uint8_t* record = frame + 1 + i * 5;
+        record[0] = HID_WIRE_MOVE;
+        record[1] = (uint8_t)moveX(i);
+        record[2] = moveX(i) < 0 ? 0xff : 0;
+        record[3] = (uint8_t)moveY(i);
+        record[4] = moveY(i) < 0 ? 0xff : 0;
+    }
+
+    int64_t binarySum = 0;
+    Clock::time_point start = Clock::now();
+    for (uint32_t done = 0; done < EVENTS; done += EVENTS_PER_FRAME) {
+        HIDWireDecoder decoder(frame, sizeof(frame));
+        HIDWireEvent event;
+        while (decoder.next(event)) binarySum += event.move.x + event.move.y;
+    }
+    Clock::time_point binaryEnd = Clock::now();
+
+    // JSON: one tools/call per move, as the bridge sends them
+    static char messages[EVENTS_PER_FRAME][160];
+    size_t lengths[EVENTS_PER_FRAME];
+    size_t jsonBytes = 0;
+    for (uint32_t i = 0; i < EVENTS_PER_FRAME; i++) {
+        lengths[i] = snprintf(messages[i], sizeof(messages[i]),
+                              "{\"jsonrpc\":\"2.0\",\"id\":%u,\"method\":\"tools/call\","
+                              "\"params\":{\"name\":\"mouse_move\",\"args\":{\"x\":%d,\"y\":%d}}}",
+                              1000 + i, moveX(i), moveY(i));
+        jsonBytes += lengths[i];
+    }
+
+    StaticJsonDocument<96> filter;
+    filter["jsonrpc"] = true;
+    filter["id"] = true;
+    filter["method"] = true;
+    filter["params"] = true;
+    filter["session"] = true;
+    static StaticJsonDocument<MCP_REQUEST_ARENA_SIZE> request;
+    static char payload[160];
+
+    int64_t jsonSum = 0;
+    uint32_t failures = 0;
+    Clock::time_point jsonStart = Clock::now();
+    for (uint32_t done = 0; done < EVENTS; done++) {
+        uint32_t i = done % EVENTS_PER_FRAME;
+        // The WebSocket payload is parsed in place, so each one is fresh
+        memcpy(payload, messages[i], lengths[i]);
+        DeserializationError error = deserializeJson(request, payload, lengths[i],
+                                                     DeserializationOption::Filter(filter));
+        JsonObjectConst root = request.as<JsonObjectConst>();
+        JsonObjectConst params = root["params"].as<JsonObjectConst>();
+        MouseMoveArgs args;
+        const char* message = nullptr;
+        if (error || strcmp(root["method"] | "", "tools/call") != 0 ||
+            findTool(params["name"] | "") != MCP_TOOL_MouseMove ||
+            !decodeToolArgs(params["args"].as<JsonObjectConst>(), args, message)) {
+            failures++;
+            continue;
+        }
+        jsonSum += args.x + args.y;
+    }
+    Clock::time_point jsonEnd = Clock::now();
+
+    double binaryNs = nsPerEvent(start, binaryEnd);
+    double jsonNs = nsPerEvent(jsonStart, jsonEnd);
+    printf("mouse move, binary: %.1f bytes/event, %.1f ns/event decode\n",
+           (double)sizeof(frame) / EVENTS_PER_FRAME, binaryNs);
+    printf("mouse move, JSON:   %.1f bytes/event, %.1f ns/event parse and decode (%.1fx)\n",
+           (double)jsonBytes / EVENTS_PER_FRAME, jsonNs, jsonNs / binaryNs);
+
+    // Both paths saw the same moves
+    if (failures || binarySum != jsonSum) {
+        fprintf(stderr, "paths disagree: %u JSON failures, sums %lld and %lld\n", failures,
+                (long long)binarySum, (long long)jsonSum);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for the host tests: a failed check is reported and the
+// test carries on, so one run shows every failure
+static int hostTestFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long actualValue = (long long)(actual); \
+        long long expectedValue = (long long)(expected); \
+        if (actualValue != expectedValue) { \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, \
+                    #actual, #expected, actualValue, expectedValue); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+static inline int hostTestResult(const char* name) {
+    printf("%s: %s\n", name, hostTestFailures ? "FAILED" : "ok");
+    return hostTestFailures ? 1 : 0;
+}
+
+#endif // HOST_TEST_H
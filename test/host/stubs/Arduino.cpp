@@ -0,0 +1,24 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+
+std::atomic<unsigned long> hostMillis(0);
+std::atomic<unsigned long> hostDelayCalls(0);
+
+HardwareSerial Serial;
+EspClass ESP;
+EEPROMClass EEPROM;
+
+unsigned long millis() {
+    return hostMillis.load();
+}
+
+unsigned long micros() {
+    return hostMillis.load() * 1000;
+}
+
+// Blocking is what the tests look for, so delay() is counted, and it
+// moves the clock as a real one would
+void delay(unsigned long ms) {
+    hostDelayCalls++;
+    hostMillis += ms;
+}
@@ -0,0 +1,112 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core the HID sources use.
+// Time is simulated: millis() only moves when a test advances hostMillis or
+// the code under test calls delay(), which the tests count.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+extern std::atomic<unsigned long> hostMillis;
+extern std::atomic<unsigned long> hostDelayCalls;
+
+class String {
+private:
+    std::string text;
+
+public:
+    String() {}
+    String(const char* value) : text(value ? value : "") {}
+    String(const std::string& value) : text(value) {}
+    String(char value) : text(1, value) {}
+    String(int value) : text(std::to_string(value)) {}
+    String(unsigned value) : text(std::to_string(value)) {}
+    String(long value) : text(std::to_string(value)) {}
+    String(unsigned long value) : text(std::to_string(value)) {}
+
+    const char* c_str() const { return text.c_str(); }
+    unsigned int length() const { return text.size(); }
+    char charAt(unsigned int index) const { return index < text.size() ? text[index] : 0; }
+    bool reserve(unsigned int size) { text.reserve(size); return true; }
+
+    bool operator==(const String& other) const { return text == other.text; }
+    bool operator==(const char* other) const { return text == (other ? other : ""); }
+    bool operator!=(const String& other) const { return text != other.text; }
+    bool operator!=(const char* other) const { return !(*this == other); }
+    String operator+(const String& other) const { return String(text + other.text); }
+    String& operator+=(const String& other) { text += other.text; return *this; }
+    String& operator+=(const char* other) { text += other; return *this; }
+    String& operator+=(char other) { text += other; return *this; }
+    bool concat(const char* other, unsigned int length) { text.append(other, length); return true; }
+
+    bool startsWith(const String& prefix) const { return text.compare(0, prefix.text.size(), prefix.text) == 0; }
+    int indexOf(const char* needle, unsigned int from = 0) const {
+        size_t at = text.find(needle, from);
+        return at == std::string::npos ? -1 : (int)at;
+    }
+    int indexOf(char needle, unsigned int from = 0) const {
+        size_t at = text.find(needle, from);
+        return at == std::string::npos ? -1 : (int)at;
+    }
+    String substring(unsigned int from) const { return from < text.size() ? String(text.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        return from < to && from < text.size() ? String(text.substr(from, to - from)) : String();
+    }
+    long toInt() const { return atol(text.c_str()); }
+    void toLowerCase() { for (char& c : text) c = tolower((unsigned char)c); }
+    void trim() {
+        size_t start = text.find_first_not_of(" \t\r\n");
+        size_t end = text.find_last_not_of(" \t\r\n");
+        text = start == std::string::npos ? "" : text.substr(start, end - start + 1);
+    }
+};
+
+inline String operator+(const char* left, const String& right) { return String(left) + right; }
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t print(const char* text) {
+        size_t n = 0;
+        while (*text) n += write((uint8_t)*text++);
+        return n;
+    }
+};
+
+// Debug output is dropped
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    template <typename... T> size_t printf(const char*, T...) { return 0; }
+    template <typename T> size_t print(const T&) { return 0; }
+    template <typename T> size_t println(const T&) { return 0; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getCycleCount() { return micros() * 240; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMaxAllocHeap() { return 100000; }
+};
+
+extern EspClass ESP;
+
+#endif // ARDUINO_H
@@ -0,0 +1,25 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <Arduino.h>
+
+// RAM-backed EEPROM, erased to 0xff like a fresh flash sector
+class EEPROMClass {
+private:
+    uint8_t data[4096];
+
+public:
+    EEPROMClass() { memset(data, 0xff, sizeof(data)); }
+    bool begin(size_t) { return true; }
+    bool commit() { return true; }
+    uint8_t read(int address) { return data[address]; }
+    void write(int address, uint8_t value) { data[address] = value; }
+    uint16_t readUShort(int address) { uint16_t value; memcpy(&value, data + address, sizeof(value)); return value; }
+    size_t writeUShort(int address, uint16_t value) { memcpy(data + address, &value, sizeof(value)); return sizeof(value); }
+    template <typename T> T& get(int address, T& value) { memcpy(&value, data + address, sizeof(T)); return value; }
+    template <typename T> const T& put(int address, const T& value) { memcpy(data + address, &value, sizeof(T)); return value; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_H
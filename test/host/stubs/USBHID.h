@@ -0,0 +1,20 @@
+#ifndef USBHID_H
+#define USBHID_H
+
+#include <Arduino.h>
+
+class USBHIDDevice {
+public:
+    virtual ~USBHIDDevice() {}
+    virtual uint16_t _onGetDescriptor(uint8_t* buffer) = 0;
+};
+
+class USBHID {
+public:
+    void begin() {}
+    bool ready() { return true; }
+    bool addDevice(USBHIDDevice*, uint16_t) { return true; }
+    bool SendReport(uint8_t, const void*, size_t, uint32_t = 100) { return true; }
+};
+
+#endif // USBHID_H
@@ -0,0 +1,15 @@
+#ifndef USBHIDCONSUMERCONTROL_H
+#define USBHIDCONSUMERCONTROL_H
+
+#include "USBHID.h"
+
+class USBHIDConsumerControl {
+public:
+    uint16_t pressed = 0;
+
+    void begin() {}
+    void press(uint16_t usage) { pressed = usage; }
+    void release() { pressed = 0; }
+};
+
+#endif // USBHIDCONSUMERCONTROL_H
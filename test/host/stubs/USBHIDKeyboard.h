@@ -0,0 +1,30 @@
+#ifndef USBHIDKEYBOARD_H
+#define USBHIDKEYBOARD_H
+
+#include "USBHID.h"
+#include <vector>
+
+typedef struct {
+    uint8_t modifiers;
+    uint8_t reserved;
+    uint8_t keys[6];
+} KeyReport;
+
+// Records every report with the time it was sent
+class USBHIDKeyboard {
+public:
+    std::vector<KeyReport> reports;
+    std::vector<unsigned long> sentAt;
+
+    void begin() {}
+    void sendReport(KeyReport* report) {
+        reports.push_back(*report);
+        sentAt.push_back(millis());
+    }
+    void releaseAll() {
+        KeyReport report = {};
+        sendReport(&report);
+    }
+};
+
+#endif // USBHIDKEYBOARD_H
@@ -0,0 +1,34 @@
+#ifndef USBHIDMOUSE_H
+#define USBHIDMOUSE_H
+
+#include "USBHID.h"
+
+#define MOUSE_LEFT 0x01
+#define MOUSE_RIGHT 0x02
+#define MOUSE_MIDDLE 0x04
+
+// Tracks where the relative moves add up to and which buttons are down
+class USBHIDMouse {
+public:
+    long x = 0;
+    long y = 0;
+    long wheel = 0;
+    uint32_t moves = 0;
+    uint32_t clicks = 0;
+    uint8_t buttons = 0;
+
+    void begin() {}
+    void move(int8_t dx, int8_t dy, int8_t scroll = 0, int8_t = 0) {
+        x += dx;
+        y += dy;
+        wheel += scroll;
+        moves++;
+    }
+    void press(uint8_t button) { buttons |= button; }
+    void release(uint8_t button) {
+        if (buttons & button) clicks++;
+        buttons &= ~button;
+    }
+};
+
+#endif // USBHIDMOUSE_H
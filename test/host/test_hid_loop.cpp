@@ -0,0 +1,97 @@
+// HID tools must not block the main loop: a long keyboard_type is queued
+// and drained a report at a time while the network keeps being serviced.
+//
+// The loop below mirrors main.cpp with a simulated clock. Only delay()
+// could move the clock inside a call, so a network gap longer than one
+// pass means something blocked.
+
+#include "host_test.h"
+#include "hid_controller.h"
+#include "hid_report_compiler.h"
+
+#define TEXT_LENGTH 2048
+#define MAX_RUN_MS 60000
+
+struct NetworkStub {
+    unsigned long passes = 0;
+    unsigned long lastServiceMs = 0;
+    unsigned long longestGapMs = 0;
+
+    // Stands in for webSocket.loop() and wifiManager.loop()
+    void loop() {
+        unsigned long now = millis();
+        if (passes > 0 && now - lastServiceMs > longestGapMs) longestGapMs = now - lastServiceMs;
+        lastServiceMs = now;
+        passes++;
+    }
+};
+
+static bool sameReport(const KeyReport& sent, const HIDKeyboardReport& compiled) {
+    return memcmp(&sent, &compiled, sizeof(KeyReport)) == 0;
+}
+
+int main() {
+    USBHIDKeyboard keyboard;
+    USBHIDMouse mouse;
+    HIDController hid(&keyboard, &mouse);
+    CHECK(hid.begin());
+
+    static char text[TEXT_LENGTH + 1];
+    const char* prose = "The quick brown fox jumps over the lazy dog, 0123456789 times! ";
+    for (size_t i = 0; i < TEXT_LENGTH; i++) text[i] = prose[i % strlen(prose)];
+
+    static HIDKeyboardReport expected[TEXT_LENGTH * HIDReportCompiler::MAX_REPORTS_PER_CHAR];
+    size_t expectedCount = HIDReportCompiler::compile(text, TEXT_LENGTH, KEYBOARD_LAYOUT, expected,
+                                                      sizeof(expected) / sizeof(expected[0]));
+    CHECK(expectedCount > TEXT_LENGTH);
+
+    // Queueing takes no time and sends nothing
+    unsigned long queuedAt = millis();
+    CHECK(hid.typeText(text, TEXT_LENGTH, KEYBOARD_LAYOUT, HID_TYPE_DELAY_MS));
+    CHECK(hid.sendKeyStroke("Enter", "ctrl"));
+    CHECK(hid.clickMouse(MOUSE_LEFT, 200));
+    uint32_t last = hid.sequence();
+    CHECK_EQ(millis(), queuedAt);
+    CHECK_EQ(hostDelayCalls.load(), 0);
+    CHECK_EQ(keyboard.reports.size(), 0);
+    CHECK(hid.isBusy());
+
+    NetworkStub network;
+    while (!hid.completed(last) && millis() < MAX_RUN_MS) {
+        network.loop();
+        hid.loop();
+        hostMillis++;
+    }
+
+    CHECK(hid.completed(last));
+    CHECK_EQ(hostDelayCalls.load(), 0);
+    CHECK_EQ(network.longestGapMs, 1);
+    // Typing at one report per HID_TYPE_DELAY_MS took long enough to matter
+    CHECK(millis() >= expectedCount * HID_TYPE_DELAY_MS);
+    CHECK(network.passes >= millis());
+
+    // The text went out exactly as compiled, paced by HID_TYPE_DELAY_MS
+    CHECK(keyboard.reports.size() >= expectedCount + 2);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < expectedCount && i < keyboard.reports.size(); i++) {
+        if (!sameReport(keyboard.reports[i], expected[i])) mismatches++;
+        if (i > 0) CHECK(keyboard.sentAt[i] - keyboard.sentAt[i - 1] >= HID_TYPE_DELAY_MS);
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // ctrl+Enter after it, held down for HID_KEY_HOLD_MS
+    KeyReport& press = keyboard.reports[expectedCount];
+    CHECK_EQ(press.modifiers, HID_MOD_LEFT_CTRL);
+    CHECK_EQ(press.keys[0], 0x28);
+    CHECK(keyboard.sentAt[expectedCount + 1] - keyboard.sentAt[expectedCount] >= HID_KEY_HOLD_MS);
+    CHECK_EQ(keyboard.reports.back().modifiers, 0);
+    CHECK_EQ(keyboard.reports.back().keys[0], 0);
+
+    // and the click, released without blocking for its 200 ms
+    CHECK_EQ(mouse.clicks, 1);
+    CHECK_EQ(mouse.buttons, 0);
+
+    printf("typed %d bytes in %zu reports over %lu ms; network serviced %lu times, longest gap %lu ms\n",
+           TEXT_LENGTH, expectedCount, millis(), network.passes, network.longestGapMs);
+    return hostTestResult("test_hid_loop");
+}
@@ -0,0 +1,151 @@
+// HIDReportCompiler::compile: keys roll over into one report until a key
+// repeats, the modifiers change or all six slots are taken; dead keys are
+// pressed and released on their own.
+
+#include "host_test.h"
+#include "hid_report_compiler.h"
+#include <initializer_list>
+#include <string.h>
+
+#define S HID_MOD_LEFT_SHIFT
+#define AG HID_MOD_RIGHT_ALT
+#define KEY(c) (uint8_t)(0x04 + ((c) - 'a'))
+#define RELEASED {0, 0, {0}}
+
+static const uint8_t KEY_EQUAL = 0x2e;
+static const uint8_t KEY_LBRACKET = 0x2f;
+static const uint8_t KEY_GRAVE = 0x35;
+
+static void printReport(const char* label, const HIDKeyboardReport& report) {
+    fprintf(stderr, "    %s %02x [%02x %02x %02x %02x %02x %02x]\n", label, report.modifiers, report.keys[0],
+            report.keys[1], report.keys[2], report.keys[3], report.keys[4], report.keys[5]);
+}
+
+static void checkCompile(const char* text, uint8_t layout, std::initializer_list<HIDKeyboardReport> expected) {
+    HIDKeyboardReport reports[64];
+    size_t count = HIDReportCompiler::compile(text, strlen(text), layout, reports, 64);
+
+    bool same = count == expected.size();
+    for (size_t i = 0; same && i < count; i++) {
+        same = memcmp(&reports[i], expected.begin() + i, sizeof(HIDKeyboardReport)) == 0;
+    }
+    if (same) return;
+
+    fprintf(stderr, "compile(\"%s\", layout %u): %zu reports, expected %zu\n", text, layout, count, expected.size());
+    for (size_t i = 0; i < count; i++) printReport("got ", reports[i]);
+    for (const HIDKeyboardReport& report : expected) printReport("want", report);
+    hostTestFailures++;
+}
+
+int main() {
+    // Distinct keys roll over into the same report, released once at the end
+    checkCompile("abc", KEYBOARD_LAYOUT_US, {
+        {0, 0, {KEY('a')}},
+        {0, 0, {KEY('a'), KEY('b')}},
+        {0, 0, {KEY('a'), KEY('b'), KEY('c')}},
+        RELEASED,
+    });
+
+    // Layouts pick the key: z is y on QWERTZ and w on AZERTY; a is q there
+    checkCompile("z", KEYBOARD_LAYOUT_US, {{0, 0, {KEY('z')}}, RELEASED});
+    checkCompile("z", KEYBOARD_LAYOUT_DE, {{0, 0, {KEY('y')}}, RELEASED});
+    checkCompile("za", KEYBOARD_LAYOUT_FR, {{0, 0, {KEY('w')}}, {0, 0, {KEY('w'), KEY('q')}}, RELEASED});
+    checkCompile("@", KEYBOARD_LAYOUT_US, {{S, 0, {0x1f}}, RELEASED});
+    checkCompile("@", KEYBOARD_LAYOUT_DE, {{AG, 0, {KEY('q')}}, RELEASED});
+    checkCompile("\xc3\xbc", KEYBOARD_LAYOUT_DE, {{0, 0, {KEY_LBRACKET}}, RELEASED});
+
+    // Shift stays down across a run of capitals and symbols
+    checkCompile("AB!", KEYBOARD_LAYOUT_US, {
+        {S, 0, {KEY('a')}},
+        {S, 0, {KEY('a'), KEY('b')}},
+        {S, 0, {KEY('a'), KEY('b'), 0x1e}},
+        RELEASED,
+    });
+    // and a change of modifiers releases the held keys first
+    checkCompile("aBc", KEYBOARD_LAYOUT_US, {
+        {0, 0, {KEY('a')}},
+        RELEASED,
+        {S, 0, {KEY('b')}},
+        {S, 0, {0}},
+        {0, 0, {KEY('c')}},
+        RELEASED,
+    });
+
+    // A repeated key has to come up before it can go down again
+    checkCompile("aa", KEYBOARD_LAYOUT_US, {
+        {0, 0, {KEY('a')}},
+        RELEASED,
+        {0, 0, {KEY('a')}},
+        RELEASED,
+    });
+    checkCompile("aba", KEYBOARD_LAYOUT_US, {
+        {0, 0, {KEY('a')}},
+        {0, 0, {KEY('a'), KEY('b')}},
+        RELEASED,
+        {0, 0, {KEY('a')}},
+        RELEASED,
+    });
+
+    // Six keys fill the boot report; the seventh starts a new one
+    checkCompile("abcdefg", KEYBOARD_LAYOUT_US, {
+        {0, 0, {KEY('a')}},
+        {0, 0, {KEY('a'), KEY('b')}},
+        {0, 0, {KEY('a'), KEY('b'), KEY('c')}},
+        {0, 0, {KEY('a'), KEY('b'), KEY('c'), KEY('d')}},
+        {0, 0, {KEY('a'), KEY('b'), KEY('c'), KEY('d'), KEY('e')}},
+        {0, 0, {KEY('a'), KEY('b'), KEY('c'), KEY('d'), KEY('e'), KEY('f')}},
+        RELEASED,
+        {0, 0, {KEY('g')}},
+        RELEASED,
+    });
+
+    // Dead keys: é on QWERTZ is acute (the = key), released, then e
+    checkCompile("\xc3\xa9", KEYBOARD_LAYOUT_DE, {
+        {0, 0, {KEY_EQUAL}},
+        RELEASED,
+        {0, 0, {KEY('e')}},
+        RELEASED,
+    });
+    // held keys come up before the dead key goes down
+    checkCompile("a\xc3\xa2", KEYBOARD_LAYOUT_DE, {
+        {0, 0, {KEY('a')}},
+        RELEASED,
+        {0, 0, {KEY_GRAVE}},
+        RELEASED,
+        {0, 0, {KEY('a')}},
+        RELEASED,
+    });
+    // a shifted dead key (grave on QWERTZ) keeps shift off the base letter
+    checkCompile("\xc3\xa8", KEYBOARD_LAYOUT_DE, {
+        {S, 0, {KEY_EQUAL}},
+        {S, 0, {0}},
+        {0, 0, {KEY('e')}},
+        RELEASED,
+    });
+
+    // Characters the layout cannot type are skipped
+    checkCompile("a\xe4\xb8\xad" "b", KEYBOARD_LAYOUT_US, {
+        {0, 0, {KEY('a')}},
+        {0, 0, {KEY('a'), KEY('b')}},
+        RELEASED,
+    });
+    checkCompile("", KEYBOARD_LAYOUT_US, {});
+
+    // Too small an output buffer yields nothing rather than a partial text
+    HIDKeyboardReport reports[3];
+    CHECK_EQ(HIDReportCompiler::compile("abcdefg", 7, KEYBOARD_LAYOUT_US, reports, 3), 0);
+    CHECK_EQ(HIDReportCompiler::compile("abc", 3, KEYBOARD_LAYOUT_US, reports, 3), 0);
+    CHECK_EQ(HIDReportCompiler::compile("ab", 2, KEYBOARD_LAYOUT_US, reports, 3), 3);
+
+    // Every compiled text ends with everything released
+    const char* prose = "Hello, World! \xc3\x9c" "ber fa\xc3\xa7" "ade; ~200 caf\xc3\xa9s.\n";
+    for (uint8_t layout = 0; layout < KEYBOARD_LAYOUT_COUNT; layout++) {
+        HIDKeyboardReport out[256];
+        size_t count = HIDReportCompiler::compile(prose, strlen(prose), layout, out, 256);
+        CHECK(count > 0);
+        HIDKeyboardReport released = RELEASED;
+        if (count > 0) CHECK(memcmp(&out[count - 1], &released, sizeof(released)) == 0);
+    }
+
+    return hostTestResult("test_report_compiler");
+}
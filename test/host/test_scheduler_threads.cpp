@@ -0,0 +1,146 @@
+// HIDScheduler fed from one thread and drained from another, as with
+// HID_DUAL_CORE: the network loop queues text, keys, moves and paths and
+// sometimes clears, while the HID task runs loop() and moves the clock.
+// Then HIDBenchmark runs the same way, its report observer on the HID
+// task while the loop starts runs, times frames and reads results.
+// Build with `make tsan` to have ThreadSanitizer check the hand-off.
+
+#include "host_test.h"
+#include "hid_scheduler.h"
+#include "hid_controller.h"
+#include "hid_benchmark.h"
+#include <atomic>
+#include <thread>
+
+#define OPERATIONS 200000
+#define BENCHMARK_RUNS 20
+#define BENCHMARK_RUN_MS 50
+#define FRAMES_PER_RUN 200
+
+static USBHIDKeyboard keyboard;
+static USBHIDMouse mouse;
+static HIDScheduler scheduler(&keyboard, &mouse, nullptr, nullptr);
+static std::atomic<bool> stop(false);
+
+static USBHIDKeyboard benchKeyboard;
+static USBHIDMouse benchMouse;
+static HIDController hid(&benchKeyboard, &benchMouse);
+static HIDBenchmark benchmark(&hid);
+
+static void hidTaskMain() {
+    while (!stop.load()) {
+        hostMillis++;
+        scheduler.loop();
+        std::this_thread::yield();
+    }
+}
+
+static void benchTaskMain() {
+    while (!stop.load()) {
+        hostMillis++;
+        hid.loop();
+        std::this_thread::yield();
+    }
+}
+
+static void runBenchmarks() {
+    CHECK(hid.begin());
+    benchmark.begin();
+    stop = false;
+    std::thread hidTask(benchTaskMain);
+
+    uint32_t runs = 0;
+    uint32_t samples = 0;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        for (int wait = 0; wait < 1000000 && hid.isBusy(); wait++) std::this_thread::yield();
+        HIDBenchmarkMode mode = run % 2 ? HID_BENCHMARK_MOUSE : HID_BENCHMARK_KEYBOARD;
+        benchmark.frameStarted(micros());
+        bool started = benchmark.start(0, mode, 0, BENCHMARK_RUN_MS);
+        benchmark.frameFinished();
+        CHECK(started);
+        if (!started) continue;
+        runs++;
+
+        // Frames that queue work of their own, and polls, while it runs;
+        // the frames stop in time for the queue to drain
+        for (int pass = 0; benchmark.isRunning(); pass++) {
+            benchmark.frameStarted(micros());
+            if (pass < FRAMES_PER_RUN) {
+                hid.pressMouse(MOUSE_LEFT);
+                hid.releaseMouse(MOUSE_LEFT);
+            }
+            benchmark.frameFinished();
+            benchmark.loop();
+            JsonObject progress;
+            benchmark.results(progress);
+            std::this_thread::yield();
+        }
+
+        JsonObject out;
+        benchmark.results(out);
+        CHECK(out.get("reports") > 0);
+        CHECK(out.get("interval_us.mean") >= 0);
+        CHECK(out.get("frame_to_report_us.min") <= out.get("frame_to_report_us.max"));
+        samples += out.get("frame_to_report_us.samples");
+    }
+
+    stop = true;
+    hidTask.join();
+    CHECK_EQ(runs, BENCHMARK_RUNS);
+    CHECK(samples > 0);
+    printf("benchmark threads: %u runs, %u frames timed, %u reports sent\n", runs, samples, hid.reportsSent());
+}
+
+int main() {
+    std::thread hidTask(hidTaskMain);
+
+    uint32_t queued = 0;
+    uint32_t refused = 0;
+    uint32_t clears = 0;
+    HIDPathPoint path[3] = {{10, 0}, {300, 40}, {-20, 5}};
+    for (int i = 0; i < OPERATIONS; i++) {
+        bool ok = true;
+        switch (i % 7) {
+            case 0: ok = scheduler.enqueueText("h\xc3\xa9llo w\xc3\xb6rld", 13, KEYBOARD_LAYOUT_DE, 0); break;
+            case 1: ok = scheduler.enqueueMouseMove(3, -2, 0); break;
+            case 2: ok = scheduler.enqueueMouseMove(120, 5, 1); break;
+            case 3: ok = scheduler.enqueueKey(HID_EVENT_KEY_PRESS, 0x04, HID_MOD_LEFT_SHIFT); break;
+            case 4: ok = scheduler.enqueueKey(HID_EVENT_KEY_RELEASE, 0x04, HID_MOD_LEFT_SHIFT); break;
+            case 5: ok = scheduler.enqueueMousePath(path, 3, 0, 0); break;
+            default:
+                if (i % 1001 == 6) {
+                    scheduler.clear();
+                    clears++;
+                }
+                break;
+        }
+        if (ok) {
+            queued++;
+        } else {
+            refused++;
+            std::this_thread::yield();
+        }
+    }
+
+    uint32_t last = scheduler.sequence();
+    for (int wait = 0; wait < 1000000 && !scheduler.finished(last); wait++) std::this_thread::yield();
+    stop = true;
+    hidTask.join();
+
+    // Everything queued was sent or cleared, and every ring is free again
+    CHECK(scheduler.finished(last));
+    CHECK(scheduler.isIdle());
+    CHECK_EQ(scheduler.pendingEvents(), 0);
+    CHECK_EQ(scheduler.freeEvents(), HID_EVENT_QUEUE_SIZE);
+    CHECK_EQ(scheduler.freeText(), HID_TEXT_BUFFER_SIZE);
+    CHECK_EQ(scheduler.freePathPoints(), HID_PATH_BUFFER_SIZE);
+    CHECK(queued > 0);
+    CHECK(keyboard.reports.size() > 0);
+    CHECK(mouse.moves > 0);
+
+    printf("scheduler threads: %u queued, %u refused while full, %u clears, %u reports sent\n",
+           queued, refused, clears, scheduler.reportsSent());
+
+    runBenchmarks();
+    return hostTestResult("test_scheduler_threads");
+}
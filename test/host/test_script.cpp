@@ -0,0 +1,138 @@
+// HIDScript: compile() reports the line and reason of the first error,
+// REPEAT after REPEAT repeats both, variable arithmetic stays within 32
+// bits, saturating instead of overflowing, and a script held up by the
+// HID queue asks for no timer.
+
+#include "host_test.h"
+#include "hid_script.h"
+#include <initializer_list>
+#include <string.h>
+
+#define MAX_RUN_MS 60000
+
+// Opcodes and operand tags as the bytecode lays them out
+#define OP_CLICK 6
+#define OP_REPEAT 11
+#define LITERAL 0
+
+static void checkError(const char* source, uint16_t line, const char* message) {
+    uint8_t code[HID_SCRIPT_MAX_BYTECODE];
+    HIDScriptError error;
+    size_t length = HIDScript::compile(source, strlen(source), code, sizeof(code), error);
+    if (length == 0 && error.line == line && error.message && strcmp(error.message, message) == 0) return;
+
+    fprintf(stderr, "compile(\"%s\"): %zu bytes, line %u \"%s\", expected line %u \"%s\"\n", source, length,
+            error.line, error.message ? error.message : "", line, message);
+    hostTestFailures++;
+}
+
+static void checkBytecode(const char* source, std::initializer_list<uint8_t> expected) {
+    uint8_t code[HID_SCRIPT_MAX_BYTECODE];
+    HIDScriptError error;
+    size_t length = HIDScript::compile(source, strlen(source), code, sizeof(code), error);
+    if (length == expected.size() && memcmp(code, expected.begin(), length) == 0) return;
+
+    fprintf(stderr, "compile(\"%s\"): %zu bytes, expected %zu%s%s\n", source, length, expected.size(),
+            error.message ? ", error " : "", error.message ? error.message : "");
+    for (size_t i = 0; i < length; i++) fprintf(stderr, " %02x", code[i]);
+    fprintf(stderr, "\n");
+    hostTestFailures++;
+}
+
+// Runs source to the end with a simulated clock, as loop() would
+static void runScript(HIDScript& script, HIDController& hid, const char* source) {
+    HIDScriptError error;
+    bool started = script.run(0, source, strlen(source), error);
+    CHECK(started);
+    if (!started) {
+        fprintf(stderr, "    line %u: %s\n", error.line, error.message);
+        return;
+    }
+    unsigned long startMs = millis();
+    while ((script.isRunning() || hid.isBusy()) && millis() - startMs < MAX_RUN_MS) {
+        script.loop();
+        hid.loop();
+        hostMillis++;
+    }
+    CHECK(!script.isRunning());
+}
+
+int main() {
+    // Errors name the line they stopped on, counting blank and REM lines
+    checkError("REM nothing to do\n\n", 2, "Empty script");
+    checkError("REPEAT 2", 1, "REPEAT without a previous command");
+    checkError("MOUSE_CLICK\nREPEAT\n", 2, "Missing number");
+    checkError("MOUSE_CLICK\nREPEAT 1\nREPEAT 1\nREPEAT 1\nREPEAT 1\nREPEAT 1", 6, "REPEAT nested too deep");
+    checkError("STRING ok\r\nDELAY 12x\r\n", 2, "Invalid number");
+    checkError("DELAY 2147483648", 1, "Number out of range");
+    checkError("DELAY -2147483649", 1, "Number out of range");
+    checkError("DELAY 99999999999", 1, "Number out of range");
+    checkError("DELAY 123456789012", 1, "Number out of range");
+    checkError("VAR $a = 1\n$b = 2", 2, "Unknown variable");
+    checkError("VAR $a = 1\nDELAY $b", 2, "Unknown variable");
+    checkError("VAR $a = 1 ^ 2", 1, "Expected + - * / or %");
+    checkError("VAR $a = 1 + 2 3", 1, "Unexpected text after expression");
+    checkError("VAR a = 1", 1, "Expected $name = value");
+    checkError("MOUSE_CLICK\nMOUSE_CLICK side", 2, "Unknown mouse button");
+    checkError("CTRL a b", 1, "More than one non-modifier key in chord");
+    checkError("CTRL nokey", 1, "Unknown command or key");
+
+    // The ends of the int32 range are numbers
+    checkBytecode("DELAY -2147483648", {2, LITERAL, 0x00, 0x00, 0x00, 0x80});
+    checkBytecode("DELAY 2147483647", {2, LITERAL, 0xff, 0xff, 0xff, 0x7f});
+
+    // Both REPEATs point back at the click: the second repeats the click
+    // and the first REPEAT together
+    checkBytecode("MOUSE_CLICK\nREPEAT 2\nREPEAT 3\n", {
+        OP_CLICK, MOUSE_LEFT,
+        OP_REPEAT, LITERAL, 2, 0, 0, 0, 0, 0,
+        OP_REPEAT, LITERAL, 3, 0, 0, 0, 0, 0,
+    });
+
+    USBHIDKeyboard keyboard;
+    USBHIDMouse mouse;
+    HIDController hid(&keyboard, &mouse);
+    CHECK(hid.begin());
+    HIDScript script(&hid);
+
+    // 1 click, 2 more for the inner REPEAT, and all 3 again 3 more times
+    runScript(script, hid, "MOUSE_CLICK\nREPEAT 2\nREPEAT 3\n");
+    CHECK_EQ(mouse.clicks, 12);
+
+    // Expressions read and write variables
+    long x = mouse.x;
+    long y = mouse.y;
+    runScript(script, hid, "VAR $a = 7\nVAR $b = $a * 3\n$b = $b - 1\n$a = $b % 6\nMOUSE_MOVE $b $a");
+    CHECK_EQ(mouse.x - x, 20);
+    CHECK_EQ(mouse.y - y, 2);
+
+    // Results that do not fit saturate, INT32_MIN / -1 included, and
+    // division by zero gives 0
+    x = mouse.x;
+    y = mouse.y;
+    runScript(script, hid,
+              "VAR $m = -2147483648\n$m = $m / -1\n$m = $m - 2147483600\n"
+              "VAR $p = 65536 * 65536\n$p = $p - 2147483547\n"
+              "VAR $n = -2147483648 - 1\n$n = $n + 2147483600\n"
+              "VAR $r = -2147483648 % -1\nVAR $z = 5 / 0\n$z = $z + $r\n"
+              "MOUSE_MOVE $m $z\nMOUSE_MOVE $p $n");
+    CHECK_EQ(mouse.x - x, 47 + 100);
+    CHECK_EQ(mouse.y - y, -48);
+
+    // Behind a long DELAY the script fills the queue and then waits for it
+    // to move, rather than for a timer
+    HIDScriptError error;
+    const char* parked = "DELAY 5000\nMOUSE_CLICK\nREPEAT 1000";
+    CHECK(script.run(0, parked, strlen(parked), error));
+    CHECK_EQ(script.msUntilDue(), 0);
+    for (int pass = 0; pass < 1000 && script.msUntilDue() == 0; pass++) script.loop();
+    CHECK(script.isRunning());
+    CHECK_EQ(script.msUntilDue(), UINT32_MAX);
+    hid.loop();
+    CHECK(hid.msUntilDue() >= 4000);
+    script.stop();
+    CHECK(!script.isRunning());
+    CHECK_EQ(script.msUntilDue(), UINT32_MAX);
+
+    return hostTestResult("test_script");
+}
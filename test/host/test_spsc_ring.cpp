@@ -0,0 +1,102 @@
+// SPSCRing with a producer and a consumer on separate threads, as the HID
+// task and the network loop use it. Items span several words, so an item
+// read before its publication shows up as a torn value; build with
+// `make tsan` to have ThreadSanitizer check the ordering as well.
+
+#include "host_test.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <thread>
+
+#define ITEMS 2000000
+#define BATCH 7
+
+struct Item {
+    uint32_t sequence;
+    uint32_t inverse;
+    uint64_t square;
+};
+
+static Item makeItem(uint32_t sequence) {
+    Item item;
+    item.sequence = sequence;
+    item.inverse = ~sequence;
+    item.square = (uint64_t)sequence * sequence;
+    return item;
+}
+
+static bool intact(const Item& item, uint32_t sequence) {
+    return item.sequence == sequence && item.inverse == ~sequence && item.square == (uint64_t)sequence * sequence;
+}
+
+static SPSCRing<Item, 64> ring;
+static std::atomic<uint32_t> producerErrors(0);
+
+// Alternates single pushes with all-or-nothing batch writes
+static void produce() {
+    uint32_t next = 0;
+    Item batch[BATCH];
+    while (next < ITEMS) {
+        bool queued;
+        if (next % 3 == 0) {
+            uint32_t count = ITEMS - next < BATCH ? ITEMS - next : BATCH;
+            for (uint32_t i = 0; i < count; i++) batch[i] = makeItem(next + i);
+            queued = ring.write(batch, count);
+            if (queued) next += count;
+        } else {
+            queued = ring.push(makeItem(next));
+            if (queued) next++;
+        }
+        // Also the producer's view of free space never exceeds the capacity
+        if (ring.free() > 64) producerErrors++;
+        if (!queued) std::this_thread::yield();
+    }
+}
+
+int main() {
+    std::thread producer(produce);
+
+    // Alternates pop() with peeking at() a few items, editing one in place
+    // as the scheduler does, and dropping them together
+    uint32_t expected = 0;
+    uint32_t damaged = 0;
+    uint32_t peeks = 0;
+    while (expected < ITEMS) {
+        size_t available = ring.size();
+        if (available > 64) damaged++;
+        if (available >= 3 && expected % 2) {
+            for (size_t i = 0; i < 3; i++) {
+                if (!intact(ring.at(i), expected + i)) damaged++;
+            }
+            ring.front().square = 0;
+            ring.drop(3);
+            expected += 3;
+            peeks++;
+        } else {
+            Item item;
+            if (ring.pop(item)) {
+                if (!intact(item, expected)) damaged++;
+                expected++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+    producer.join();
+
+    CHECK_EQ(damaged, 0);
+    CHECK_EQ(producerErrors.load(), 0);
+    CHECK_EQ(expected, ITEMS);
+    CHECK(ring.empty());
+    CHECK_EQ(ring.free(), 64);
+    CHECK(peeks > 0);
+
+    // clear() from the consumer empties what the producer queued
+    for (uint32_t i = 0; i < 10; i++) ring.push(makeItem(i));
+    ring.clear();
+    CHECK(ring.empty());
+    CHECK_EQ(ring.free(), 64);
+
+    printf("spsc ring: %d items through 64 slots, %u batched peeks, %u damaged\n", ITEMS, peeks, damaged);
+    return hostTestResult("test_spsc_ring");
+}
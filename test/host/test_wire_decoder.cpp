@@ -0,0 +1,236 @@
+// HIDWireDecoder against well-formed, truncated, mutated and random frames.
+// Each frame sits in a heap block of exactly its length, so AddressSanitizer
+// stops the test on any read past the end.
+
+#include "host_test.h"
+#include "hid_wire_protocol.h"
+#include <string.h>
+#include <vector>
+
+#define ROUNDTRIP_FRAMES 20000
+#define RANDOM_FRAMES 500000
+#define MAX_RECORDS 24
+
+// xorshift32, so every run fuzzes the same frames
+static uint32_t randomState = 0x2545f491;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static void putU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xff);
+    out.push_back(value >> 8);
+}
+
+// Encodes one random record from the format in hid_wire_protocol.h
+static HIDWireEvent randomRecord(std::vector<uint8_t>& out) {
+    HIDWireEvent event = {};
+    event.opcode = (HIDWireOpcode)(HID_WIRE_KEY_DOWN + nextRandom() % HID_WIRE_REPLAY);
+    out.push_back(event.opcode);
+    switch (event.opcode) {
+        case HID_WIRE_KEY_DOWN:
+        case HID_WIRE_KEY_UP:
+            event.key.usage = nextRandom();
+            event.key.modifiers = nextRandom();
+            out.push_back(event.key.usage);
+            out.push_back(event.key.modifiers);
+            break;
+        case HID_WIRE_TEXT:
+            event.text.length = nextRandom() % 40;
+            event.text.layout = nextRandom() % 2 ? 0xff : nextRandom() % 5;
+            out.push_back(event.text.length);
+            out.push_back(event.text.layout);
+            for (uint8_t i = 0; i < event.text.length; i++) out.push_back('a' + nextRandom() % 26);
+            break;
+        case HID_WIRE_MOVE:
+            event.move.x = nextRandom();
+            event.move.y = nextRandom();
+            putU16(out, event.move.x);
+            putU16(out, event.move.y);
+            break;
+        case HID_WIRE_MOVE_ABSOLUTE:
+            event.position.x = nextRandom();
+            event.position.y = nextRandom();
+            putU16(out, event.position.x);
+            putU16(out, event.position.y);
+            break;
+        case HID_WIRE_BUTTON_DOWN:
+        case HID_WIRE_BUTTON_UP:
+            event.buttons = nextRandom();
+            out.push_back(event.buttons);
+            break;
+        case HID_WIRE_SCROLL:
+            event.scroll = nextRandom();
+            out.push_back(event.scroll);
+            break;
+        case HID_WIRE_DELAY:
+            event.delay = nextRandom();
+            putU16(out, event.delay);
+            break;
+        case HID_WIRE_REPLAY:
+            event.contentHash = nextRandom();
+            putU16(out, event.contentHash & 0xffff);
+            putU16(out, event.contentHash >> 16);
+            break;
+        default:
+            break;
+    }
+    return event;
+}
+
+static bool sameEvent(const HIDWireEvent& a, const HIDWireEvent& b) {
+    if (a.opcode != b.opcode) return false;
+    switch (a.opcode) {
+        case HID_WIRE_KEY_DOWN:
+        case HID_WIRE_KEY_UP:
+            return a.key.usage == b.key.usage && a.key.modifiers == b.key.modifiers;
+        case HID_WIRE_TEXT:
+            return a.text.length == b.text.length && a.text.layout == b.text.layout;
+        case HID_WIRE_MOVE:
+            return a.move.x == b.move.x && a.move.y == b.move.y;
+        case HID_WIRE_MOVE_ABSOLUTE:
+            return a.position.x == b.position.x && a.position.y == b.position.y;
+        case HID_WIRE_BUTTON_DOWN:
+        case HID_WIRE_BUTTON_UP:
+            return a.buttons == b.buttons;
+        case HID_WIRE_SCROLL:
+            return a.scroll == b.scroll;
+        case HID_WIRE_DELAY:
+            return a.delay == b.delay;
+        case HID_WIRE_REPLAY:
+            return a.contentHash == b.contentHash;
+        default:
+            return true;
+    }
+}
+
+// Decodes a copy of bytes in an exactly sized block and checks what holds
+// for any input: decoding ends, stays inside the frame, and ends at the
+// frame's end unless it reports an error. Returns the events decoded.
+static size_t decodeChecked(const uint8_t* bytes, size_t length, HIDWireStatus& status, size_t& offset,
+                            std::vector<HIDWireEvent>* events = nullptr) {
+    uint8_t* frame = new uint8_t[length ? length : 1];
+    if (length) memcpy(frame, bytes, length);
+
+    HIDWireDecoder decoder(frame, length);
+    HIDWireEvent event;
+    size_t count = 0;
+    while (decoder.next(event)) {
+        count++;
+        CHECK(count < length);
+        CHECK(decoder.offset() <= length);
+        if (event.opcode == HID_WIRE_TEXT) {
+            CHECK((const uint8_t*)event.text.data > frame);
+            CHECK((const uint8_t*)event.text.data + event.text.length <= frame + length);
+        }
+        if (events) events->push_back(event);
+        if (count >= length) break;
+    }
+    status = decoder.status();
+    offset = decoder.offset();
+    CHECK(offset <= length);
+    if (status == HID_WIRE_OK) CHECK_EQ(offset, length);
+    // A failed decode stays failed
+    if (status != HID_WIRE_OK) CHECK(!decoder.next(event));
+
+    delete[] frame;
+    return count;
+}
+
+int main() {
+    // Well-formed frames decode to what was encoded
+    for (int round = 0; round < ROUNDTRIP_FRAMES; round++) {
+        std::vector<uint8_t> frame(1, HID_WIRE_VERSION);
+        std::vector<HIDWireEvent> encoded;
+        std::vector<size_t> boundaries;
+        size_t records = nextRandom() % MAX_RECORDS;
+        for (size_t i = 0; i < records; i++) {
+            encoded.push_back(randomRecord(frame));
+            boundaries.push_back(frame.size());
+        }
+
+        HIDWireStatus status;
+        size_t offset;
+        std::vector<HIDWireEvent> decoded;
+        decodeChecked(frame.data(), frame.size(), status, offset, &decoded);
+        CHECK_EQ(status, HID_WIRE_OK);
+        CHECK_EQ(decoded.size(), encoded.size());
+        for (size_t i = 0; i < decoded.size() && i < encoded.size(); i++) {
+            if (!sameEvent(decoded[i], encoded[i])) {
+                fprintf(stderr, "round %d record %zu: opcode %u decoded differently\n", round, i, encoded[i].opcode);
+                hostTestFailures++;
+            }
+        }
+
+        // Cut anywhere: whole records before the cut decode, the rest is
+        // reported truncated at the start of the record that was cut
+        if (records == 0) continue;
+        size_t cut = 1 + nextRandom() % (frame.size() - 1);
+        size_t whole = 0;
+        while (whole < boundaries.size() && boundaries[whole] <= cut) whole++;
+        size_t count = decodeChecked(frame.data(), cut, status, offset);
+        CHECK_EQ(count, whole);
+        size_t recordStart = whole ? boundaries[whole - 1] : 1;
+        if (recordStart == cut) {
+            CHECK_EQ(status, HID_WIRE_OK);
+        } else {
+            CHECK_EQ(status, HID_WIRE_TRUNCATED);
+            CHECK_EQ(offset, recordStart);
+        }
+    }
+
+    // Damaged well-formed frames: a few bytes overwritten at random
+    for (int round = 0; round < ROUNDTRIP_FRAMES; round++) {
+        std::vector<uint8_t> frame(1, HID_WIRE_VERSION);
+        size_t records = 1 + nextRandom() % MAX_RECORDS;
+        for (size_t i = 0; i < records; i++) randomRecord(frame);
+        for (int flips = 1 + nextRandom() % 4; flips > 0; flips--) {
+            frame[nextRandom() % frame.size()] = nextRandom();
+        }
+        HIDWireStatus status;
+        size_t offset;
+        decodeChecked(frame.data(), frame.size(), status, offset);
+    }
+
+    // Random bytes, mostly behind a valid version byte
+    uint8_t bytes[96];
+    uint32_t statuses[HID_WIRE_TRUNCATED + 1] = {};
+    for (int round = 0; round < RANDOM_FRAMES; round++) {
+        size_t length = nextRandom() % sizeof(bytes);
+        for (size_t i = 0; i < length; i++) bytes[i] = nextRandom() % 3 ? nextRandom() % 14 : nextRandom();
+        if (length > 0 && nextRandom() % 8) bytes[0] = HID_WIRE_VERSION;
+        HIDWireStatus status;
+        size_t offset;
+        decodeChecked(bytes, length, status, offset);
+        CHECK(status <= HID_WIRE_TRUNCATED);
+        if (status <= HID_WIRE_TRUNCATED) statuses[status]++;
+    }
+    // The generator reached every outcome
+    for (uint8_t status = HID_WIRE_OK; status <= HID_WIRE_TRUNCATED; status++) CHECK(statuses[status] > 0);
+
+    // Known edge cases
+    HIDWireStatus status;
+    size_t offset;
+    decodeChecked(nullptr, 0, status, offset);
+    CHECK_EQ(status, HID_WIRE_BAD_VERSION);
+    const uint8_t versionOnly[] = {HID_WIRE_VERSION};
+    CHECK_EQ(decodeChecked(versionOnly, sizeof(versionOnly), status, offset), 0);
+    CHECK_EQ(status, HID_WIRE_OK);
+    const uint8_t textOverrun[] = {HID_WIRE_VERSION, HID_WIRE_TEXT, 3, 0xff, 'a', 'b'};
+    CHECK_EQ(decodeChecked(textOverrun, sizeof(textOverrun), status, offset), 0);
+    CHECK_EQ(status, HID_WIRE_TRUNCATED);
+    const uint8_t errorOpcode[] = {HID_WIRE_VERSION, HID_WIRE_RELEASE_ALL, HID_WIRE_ERROR};
+    CHECK_EQ(decodeChecked(errorOpcode, sizeof(errorOpcode), status, offset), 1);
+    CHECK_EQ(status, HID_WIRE_BAD_OPCODE);
+    CHECK_EQ(offset, 2);
+
+    printf("wire decoder: %d round trips, %d mutated and %d random frames "
+           "(ok %u, bad version %u, bad opcode %u, truncated %u)\n",
+           ROUNDTRIP_FRAMES, ROUNDTRIP_FRAMES, RANDOM_FRAMES, statuses[HID_WIRE_OK],
+           statuses[HID_WIRE_BAD_VERSION], statuses[HID_WIRE_BAD_OPCODE], statuses[HID_WIRE_TRUNCATED]);
+    return hostTestResult("test_wire_decoder");
+}
@@ -0,0 +1,93 @@
+#!/usr/bin/env node
+/**
+ * Heap soak test against a running ESP32
+ * Sends a long run of tools/call requests through the bridge and checks that
+ * free_heap and max_alloc_heap from system_status stay flat: requests and
+ * responses live in the per-client JSON arenas, so neither should drift.
+ *
+ * ESP32_HOST, ESP32_PORT and ESP32_API_KEY as for the bridge;
+ * SOAK_CALLS (default 20000), SOAK_SAMPLES (default 20) and
+ * SOAK_TOLERANCE bytes (default 1024) tune the run.
+ * The calls only move the pointer by zero, so the host sees no input.
+ */
+
+const ESP32MCPServer = require('../index.js');
+
+const CALLS = parseInt(process.env.SOAK_CALLS || '20000', 10);
+const SAMPLES = parseInt(process.env.SOAK_SAMPLES || '20', 10);
+const TOLERANCE = parseInt(process.env.SOAK_TOLERANCE || '1024', 10);
+// Calls before the first sample, while WiFi and socket buffers settle
+const WARMUP = Math.min(500, Math.floor(CALLS / 10));
+
+// Each kind of call builds a different response in the arena: data queries,
+// a queued HID job, a rejected argument and the tool listing
+const WORKLOAD = [
+    (server) => server.callTool('system_status', {}),
+    (server) => server.callTool('metrics', {}),
+    (server) => server.callTool('mouse_move', { x: 0, y: 0 }),
+    (server) => server.callTool('job_status', {}),
+    (server) => server.callTool('mouse_move', { x: 'left' }),
+    (server) => server.sendToESP32({ method: 'tools/list' })
+];
+
+async function sampleHeap(server) {
+    const response = await server.callTool('system_status', {});
+    const status = response.result;
+    if (!status || status.free_heap === undefined) {
+        throw new Error(`system_status failed: ${JSON.stringify(response.error || response)}`);
+    }
+    return {
+        freeHeap: status.free_heap,
+        maxAlloc: status.max_alloc_heap,
+        overflows: status.json_arena ? status.json_arena.overflows : 0
+    };
+}
+
+async function main() {
+    const server = new ESP32MCPServer();
+    if (!(await server.ensureConnected())) {
+        throw new Error(`cannot reach ESP32 at ${server.esp32Host}:${server.esp32Port}`);
+    }
+
+    for (let i = 0; i < WARMUP; i++) {
+        await WORKLOAD[i % WORKLOAD.length](server);
+    }
+
+    const samples = [await sampleHeap(server)];
+    const interval = Math.max(1, Math.floor((CALLS - WARMUP) / SAMPLES));
+    let failures = 0;
+    const start = Date.now();
+    for (let i = 0; i < CALLS - WARMUP; i++) {
+        const response = await WORKLOAD[i % WORKLOAD.length](server);
+        if (!response || (response.error && response.error.code !== -32602)) failures++;
+        if ((i + 1) % interval === 0) {
+            const sample = await sampleHeap(server);
+            samples.push(sample);
+            console.log(`${WARMUP + i + 1} calls: free_heap ${sample.freeHeap}, max_alloc_heap ${sample.maxAlloc}`);
+        }
+    }
+    const seconds = (Date.now() - start) / 1000;
+    server.cleanup();
+
+    // Compare the lowest reading of each half, so one sample taken while a
+    // socket buffer was briefly held does not decide the result
+    const half = Math.floor(samples.length / 2);
+    const low = (list, key) => Math.min(...list.map((sample) => sample[key]));
+    const first = samples.slice(0, half || 1);
+    const second = samples.slice(half);
+    const heapDrift = low(first, 'freeHeap') - low(second, 'freeHeap');
+    const allocDrift = low(first, 'maxAlloc') - low(second, 'maxAlloc');
+    const overflows = samples[samples.length - 1].overflows - samples[0].overflows;
+
+    console.log(`${CALLS} calls in ${seconds.toFixed(1)} s, ${failures} failed, ${overflows} arena overflows`);
+    console.log(`free_heap drift ${heapDrift} bytes, max_alloc_heap drift ${allocDrift} bytes (tolerance ${TOLERANCE})`);
+
+    const ok = failures === 0 && overflows === 0 && heapDrift <= TOLERANCE && allocDrift <= TOLERANCE;
+    console.log(ok ? 'soak_heap: ok' : 'soak_heap: FAILED');
+    process.exit(ok ? 0 : 1);
+}
+
+main().catch((error) => {
+    console.error(`❌ ${error.message}`);
+    process.exit(1);
+});